@@ -0,0 +1,384 @@
+/* Headless benchmark of the CPU gravity code, no window or Vulkan device involved.
+Sweeps body counts for every solver mode, grid sizes and body counts for the exact and Barnes-Hut vector field,
+measures the drift of every integrator, and prints the results as JSON so runs can be compared between commits and machines.
+
+	gravityBenchmark [--quick] [--max-bodies N] [--max-pairwise N] [--max-grid N] [--field-bodies N] [--max-field-bodies N]
+		[--field-opening-angle theta] [--drift-bodies N] [--drift-steps N] [--drift-softening length] [--min-time seconds]
+		[--threads N] [--output file]
+*/
+#include "body_store.hpp"
+#include "gravity_kernels.hpp"
+#include "gravity_physics_system.hpp"
+#include "vec2_field_system.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace vraus_VulkanEngine {
+
+	using Clock = std::chrono::steady_clock;
+
+	struct BenchmarkOptions {
+		size_t maxBodies = 1 << 20;
+		size_t maxPairwiseBodies = 1 << 15; // O(N^2) solvers get too slow past this
+		size_t maxGrid = 512;
+		size_t fieldBodies = 64;
+		size_t maxFieldBodies = 1 << 14; // Body sweep of the field, on the 256x256 grid or the largest one allowed
+		float fieldOpeningAngle = .5f;
+		size_t driftBodies = 256;
+		unsigned int driftSteps = 600; // 10 seconds of simulation at 60Hz
+		// Close encounters of barely softened bodies dominate the drift of every integrator and hide their differences.
+		// The drift cases use about half the mean spacing of the default 256 bodies, as N-body codes do.
+		float driftSoftening = .05f;
+		double minTime = .5; // Each case is repeated until it ran at least this long
+		unsigned int threads = 0; // 0 uses every hardware thread for the multithreaded cases
+		std::string output;
+	};
+
+	struct SolverMode {
+		const char* name;
+		GravitySolver solver;
+		ForceKernel kernel;
+	};
+
+	struct IntegratorMode {
+		const char* name;
+		Integrator integrator;
+		bool adaptiveSubsteps;
+	};
+
+	// Peak resident set size of the process so far, in bytes. Only reported once per run: it never goes down, so after the
+	// largest case every case would repeat that case's figure.
+	size_t peakResidentBytes() {
+#ifdef _WIN32
+		PROCESS_MEMORY_COUNTERS counters{};
+		if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+		return counters.PeakWorkingSetSize;
+#else
+		rusage usage{};
+		if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+		return static_cast<size_t>(usage.ru_maxrss);
+#else
+		return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+	}
+
+	// Bodies spread over a disk in slow rotation, the same seed gives the same bodies on every machine
+	BodyStore createBodies(size_t count) {
+		std::mt19937 random{ 1234 };
+		std::uniform_real_distribution<float> unit{ 0.f, 1.f };
+
+		BodyStore bodies{};
+		bodies.reserve(count);
+		for (size_t i = 0; i < count; i++) {
+			float radius = .9f * std::sqrt(unit(random));
+			float angle = 6.2831853f * unit(random);
+			glm::vec2 position{ radius * std::cos(angle), radius * std::sin(angle) };
+			glm::vec2 velocity{ -.1f * position.y, .1f * position.x };
+			bodies.add(position, velocity, 1.f / count);
+		}
+		return bodies;
+	}
+
+	FieldStore createField(size_t gridCount) {
+		FieldStore field{};
+		field.reserve(gridCount * gridCount);
+		for (size_t i = 0; i < gridCount; i++) {
+			for (size_t j = 0; j < gridCount; j++) {
+				field.add({ -1.f + (i + .5f) * 2.f / gridCount, -1.f + (j + .5f) * 2.f / gridCount });
+			}
+		}
+		return field;
+	}
+
+	std::vector<size_t> bodyCounts(size_t maxBodies) {
+		std::vector<size_t> counts{};
+		for (size_t count = 2; count < maxBodies; count *= 4) {
+			counts.push_back(count);
+		}
+		counts.push_back(maxBodies);
+		return counts;
+	}
+
+	std::vector<size_t> gridCounts(size_t maxGrid) {
+		std::vector<size_t> counts{};
+		for (size_t count : { 40, 64, 128, 256, 512 }) {
+			if (count <= maxGrid) counts.push_back(count);
+		}
+		return counts;
+	}
+
+	class JsonWriter {
+	public:
+		void beginCase() { out << (firstCase ? "\n\t\t{ " : ",\n\t\t{ "); firstCase = false; firstField = true; }
+		void endCase() { out << " }"; }
+
+		void field(const char* name, const std::string& value) { key(name); out << '"' << value << '"'; }
+		void field(const char* name, double value) { key(name); out << value; }
+		void field(const char* name, size_t value) { key(name); out << value; }
+		void field(const char* name, unsigned int value) { key(name); out << value; }
+
+		std::ostringstream out;
+
+	private:
+		void key(const char* name) { out << (firstField ? "\"" : ", \"") << name << "\": "; firstField = false; }
+
+		bool firstCase = true;
+		bool firstField = true;
+	};
+
+	void benchmarkSolver(const BenchmarkOptions& options, const SolverMode& mode, unsigned int threads, size_t count, JsonWriter& json) {
+		GravityPhysicsSystem physicsSystem{ .81f };
+		physicsSystem.solver = mode.solver;
+		physicsSystem.forceKernel = mode.kernel;
+		physicsSystem.setThreadCount(threads);
+		BodyStore bodies = createBodies(count);
+
+		// One untimed step so allocations and the tree storage are out of the way
+		const float dt = 1.f / 600;
+		physicsSystem.update(bodies, dt);
+
+		unsigned int steps = 0;
+		size_t evaluations = 0;
+		auto start = Clock::now();
+		std::chrono::duration<double> elapsed{};
+		do {
+			physicsSystem.update(bodies, dt);
+			evaluations += physicsSystem.getLastForceEvaluations();
+			steps++;
+			elapsed = Clock::now() - start;
+		} while (elapsed.count() < options.minTime);
+
+		// Per unordered pair, N(N-1)/2 per evaluation, which is what the reference kernel visits. The SIMD kernels
+		// compute each pair from both sides, so their figure includes that doubled work.
+		// Barnes-Hut does not visit every pair, its figure is the cost per pair of the equivalent exact step.
+		const double pairs = .5 * static_cast<double>(count) * (count - 1) * evaluations;
+		json.beginCase();
+		json.field("benchmark", std::string{ "gravity" });
+		json.field("solver", std::string{ mode.name });
+		json.field("kernel", std::string{ mode.solver == GravitySolver::BarnesHut ? "quadtree" : forceKernelName(resolveForceKernel(mode.kernel)) });
+		json.field("threads", threads);
+		json.field("bodies", count);
+		json.field("steps", steps);
+		json.field("seconds", elapsed.count());
+		json.field("steps_per_second", steps / elapsed.count());
+		json.field("ns_per_pair", elapsed.count() * 1e9 / pairs);
+		json.field("ns_per_body", elapsed.count() * 1e9 / (static_cast<double>(count) * evaluations));
+		json.endCase();
+	}
+
+	// Accuracy rather than speed: how far each integrator drifts from the conserved quantities of the initial bodies
+	void benchmarkIntegrator(const BenchmarkOptions& options, const IntegratorMode& mode, JsonWriter& json) {
+		GravityPhysicsSystem physicsSystem{ .81f };
+		physicsSystem.integrator = mode.integrator;
+		physicsSystem.adaptiveSubsteps = mode.adaptiveSubsteps;
+		physicsSystem.setSoftening(options.driftSoftening);
+		physicsSystem.setDriftTracking(true);
+		BodyStore bodies = createBodies(options.driftBodies);
+
+		const float dt = 1.f / 60;
+		size_t evaluations = 0;
+		double maxEnergyDrift = 0.0;
+		for (unsigned int i = 0; i < options.driftSteps; i++) {
+			physicsSystem.update(bodies, dt);
+			evaluations += physicsSystem.getLastForceEvaluations();
+			maxEnergyDrift = std::max(maxEnergyDrift, physicsSystem.getDrift().relativeEnergyDrift);
+		}
+
+		const GravityPhysicsSystem::DriftReport& drift = physicsSystem.getDrift();
+		json.beginCase();
+		json.field("benchmark", std::string{ "drift" });
+		json.field("integrator", std::string{ mode.name });
+		json.field("bodies", bodies.size());
+		json.field("steps", options.driftSteps);
+		json.field("softening", static_cast<double>(options.driftSoftening));
+		json.field("force_evaluations_per_step", static_cast<double>(evaluations) / options.driftSteps);
+		json.field("relative_energy_drift", drift.relativeEnergyDrift);
+		json.field("max_relative_energy_drift", maxEnergyDrift);
+		json.field("relative_momentum_drift", drift.relativeMomentumDrift);
+		json.field("angular_momentum_drift", drift.angularMomentumDrift);
+		json.endCase();
+	}
+
+	// openingAngle 0 is the exact sum, otherwise the error against it is measured on the final state
+	void benchmarkField(const BenchmarkOptions& options, size_t gridCount, size_t bodyCount, float openingAngle, JsonWriter& json) {
+		GravityPhysicsSystem physicsSystem{ .81f };
+		Vec2FieldSystem fieldSystem{};
+		fieldSystem.openingAngle = openingAngle;
+		BodyStore bodies = createBodies(bodyCount);
+		FieldStore field = createField(gridCount);
+
+		// Bodies move between updates like they do in the app, only the field updates are timed
+		const float dt = 1.f / 60;
+		fieldSystem.update(physicsSystem, bodies, field);
+
+		unsigned int updates = 0;
+		std::chrono::duration<double> elapsed{};
+		do {
+			physicsSystem.update(bodies, dt);
+			auto start = Clock::now();
+			fieldSystem.update(physicsSystem, bodies, field);
+			elapsed += Clock::now() - start;
+			updates++;
+		} while (elapsed.count() < options.minTime);
+
+		const double pairs = static_cast<double>(field.size()) * bodies.size() * updates;
+		json.beginCase();
+		json.field("benchmark", std::string{ "field" });
+		json.field("mode", std::string{ openingAngle > 0.f ? "barnes_hut" : "exact" });
+		json.field("opening_angle", static_cast<double>(openingAngle));
+		json.field("grid", gridCount);
+		json.field("points", field.size());
+		json.field("bodies", bodies.size());
+		json.field("steps", updates);
+		json.field("seconds", elapsed.count());
+		json.field("steps_per_second", updates / elapsed.count());
+		// Per point and body of the grid, for Barnes-Hut the cost per pair of the equivalent exact update
+		json.field("ns_per_pair", elapsed.count() * 1e9 / pairs);
+		if (openingAngle > 0.f) {
+			const GravityPhysicsSystem::ForceErrorReport error = fieldSystem.compareWithExact(physicsSystem, bodies, field);
+			json.field("max_relative_error", static_cast<double>(error.maxRelativeError));
+			json.field("mean_relative_error", static_cast<double>(error.meanRelativeError));
+			json.field("rms_relative_error", static_cast<double>(error.rmsRelativeError));
+		}
+		json.endCase();
+	}
+
+	BenchmarkOptions parseOptions(int argc, char** argv) {
+		BenchmarkOptions options{};
+		for (int i = 1; i < argc; i++) {
+			std::string argument = argv[i];
+			auto value = [&]() -> std::string {
+				if (i + 1 >= argc) throw std::runtime_error("missing value after " + argument);
+				return argv[++i];
+			};
+
+			if (argument == "--quick") {
+				options.maxBodies = 1 << 14;
+				options.maxPairwiseBodies = 1 << 12;
+				options.maxGrid = 128;
+				options.maxFieldBodies = 1 << 11;
+				options.minTime = .1;
+			}
+			else if (argument == "--max-bodies") options.maxBodies = std::stoull(value());
+			else if (argument == "--max-pairwise") options.maxPairwiseBodies = std::stoull(value());
+			else if (argument == "--max-grid") options.maxGrid = std::stoull(value());
+			else if (argument == "--field-bodies") options.fieldBodies = std::stoull(value());
+			else if (argument == "--max-field-bodies") options.maxFieldBodies = std::stoull(value());
+			else if (argument == "--field-opening-angle") options.fieldOpeningAngle = std::stof(value());
+			else if (argument == "--drift-bodies") options.driftBodies = std::stoull(value());
+			else if (argument == "--drift-steps") options.driftSteps = static_cast<unsigned int>(std::stoul(value()));
+			else if (argument == "--drift-softening") options.driftSoftening = std::stof(value());
+			else if (argument == "--min-time") options.minTime = std::stod(value());
+			else if (argument == "--threads") options.threads = static_cast<unsigned int>(std::stoul(value()));
+			else if (argument == "--output") options.output = value();
+			else throw std::runtime_error("unknown argument " + argument);
+		}
+		if (options.maxBodies < 2) throw std::runtime_error("--max-bodies must be at least 2");
+		if (options.maxFieldBodies < 2) throw std::runtime_error("--max-field-bodies must be at least 2");
+		if (!(options.fieldOpeningAngle > 0.f)) throw std::runtime_error("--field-opening-angle must be greater than 0");
+		return options;
+	}
+
+	void runBenchmarks(const BenchmarkOptions& options) {
+		const unsigned int hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+		const unsigned int maxThreads = options.threads > 0 ? options.threads : hardwareThreads;
+		std::vector<unsigned int> threadCounts{ 1 };
+		if (maxThreads > 1) threadCounts.push_back(maxThreads);
+
+		const SolverMode modes[] = {
+			{ "pairwise_reference", GravitySolver::Pairwise, ForceKernel::Reference },
+			{ "pairwise", GravitySolver::Pairwise, ForceKernel::Auto },
+			{ "barnes_hut", GravitySolver::BarnesHut, ForceKernel::Auto },
+		};
+
+		JsonWriter json{};
+		for (const SolverMode& mode : modes) {
+			for (unsigned int threads : threadCounts) {
+				for (size_t count : bodyCounts(options.maxBodies)) {
+					if (mode.solver == GravitySolver::Pairwise && count > options.maxPairwiseBodies) break;
+					std::cerr << mode.name << " threads " << threads << " bodies " << count << std::endl;
+					benchmarkSolver(options, mode, threads, count, json);
+				}
+			}
+		}
+		const IntegratorMode integrators[] = {
+			{ "semi_implicit_euler", Integrator::SemiImplicitEuler, false },
+			{ "leapfrog", Integrator::Leapfrog, false },
+			{ "leapfrog_adaptive", Integrator::Leapfrog, true },
+			{ "yoshida4", Integrator::Yoshida4, false },
+		};
+		for (const IntegratorMode& mode : integrators) {
+			std::cerr << "drift " << mode.name << std::endl;
+			benchmarkIntegrator(options, mode, json);
+		}
+		const float fieldOpeningAngles[] = { 0.f, options.fieldOpeningAngle };
+		for (float openingAngle : fieldOpeningAngles) {
+			for (size_t gridCount : gridCounts(options.maxGrid)) {
+				std::cerr << "field theta " << openingAngle << " " << gridCount << "x" << gridCount << std::endl;
+				benchmarkField(options, gridCount, options.fieldBodies, openingAngle, json);
+			}
+		}
+		// Where the cost of the exact field grows with bodies and the quadtree's does not
+		const std::vector<size_t> sweepGrids = gridCounts(std::min<size_t>(256, options.maxGrid));
+		for (float openingAngle : fieldOpeningAngles) {
+			if (sweepGrids.empty()) break;
+			for (size_t count : bodyCounts(options.maxFieldBodies)) {
+				const size_t grid = sweepGrids.back();
+				std::cerr << "field theta " << openingAngle << " " << grid << "x" << grid << " bodies " << count << std::endl;
+				benchmarkField(options, grid, count, openingAngle, json);
+			}
+		}
+
+		std::ostringstream document{};
+		document << "{\n";
+		document << "\t\"hardware_threads\": " << hardwareThreads << ",\n";
+		document << "\t\"best_kernel\": \"" << forceKernelName(resolveForceKernel(ForceKernel::Auto)) << "\",\n";
+		document << "\t\"min_time\": " << options.minTime << ",\n";
+		document << "\t\"results\": [" << json.out.str() << "\n\t],\n";
+		document << "\t\"peak_rss_bytes\": " << peakResidentBytes() << "\n";
+		document << "}\n";
+
+		if (options.output.empty()) {
+			std::cout << document.str();
+		}
+		else {
+			std::ofstream file{ options.output };
+			if (!file) throw std::runtime_error("failed to open " + options.output);
+			file << document.str();
+		}
+	}
+}
+
+int main(int argc, char** argv) {
+	try {
+		vraus_VulkanEngine::runBenchmarks(vraus_VulkanEngine::parseOptions(argc, argv));
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,23 @@
+#version 450
+
+layout (location = 0) in vec2 position;
+layout (location = 1) in vec3 color;
+
+// Written by gravity_step.comp, one body per instance
+layout (std430, set = 0, binding = 0) readonly buffer Positions {
+	vec4 positions[];
+};
+
+// rgb: color, w: scale
+layout (std430, set = 0, binding = 1) readonly buffer Appearances {
+	vec4 appearances[];
+};
+
+layout (location = 0) out vec3 fragColor;
+
+void main() {
+	vec4 body = positions[gl_InstanceIndex];
+	vec4 appearance = appearances[gl_InstanceIndex];
+	gl_Position = vec4(position * appearance.w + body.xy, 0.0, 1.0);
+	fragColor = appearance.rgb;
+}
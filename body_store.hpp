@@ -0,0 +1,87 @@
+#pragma once
+
+// libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <vector>
+
+namespace vraus_VulkanEngine {
+	/* Structure of arrays holding only what the gravity simulation needs.
+	Iterating GameObjects drags the model pointer, color and full transform through the cache for every body,
+	here the force loops only touch tightly packed floats. Rendering still uses GameObjects, the application
+	copies the simulated state back to them once per frame.
+	*/
+	struct BodyStore {
+		std::vector<float> x;
+		std::vector<float> y;
+		std::vector<float> vx;
+		std::vector<float> vy;
+		std::vector<float> mass;
+
+		size_t size() const { return x.size(); }
+
+		void reserve(size_t count) {
+			x.reserve(count);
+			y.reserve(count);
+			vx.reserve(count);
+			vy.reserve(count);
+			mass.reserve(count);
+		}
+
+		void clear() {
+			x.clear();
+			y.clear();
+			vx.clear();
+			vy.clear();
+			mass.clear();
+		}
+
+		// Returns the index of the new body
+		size_t add(glm::vec2 position, glm::vec2 velocity, float bodyMass) {
+			x.push_back(position.x);
+			y.push_back(position.y);
+			vx.push_back(velocity.x);
+			vy.push_back(velocity.y);
+			mass.push_back(bodyMass);
+			return x.size() - 1;
+		}
+
+		glm::vec2 position(size_t i) const { return { x[i], y[i] }; }
+		glm::vec2 velocity(size_t i) const { return { vx[i], vy[i] }; }
+	};
+
+	// Sample points of the vector field, Vec2FieldSystem writes the resulting line rotation and length for each one.
+	struct FieldStore {
+		std::vector<float> x;
+		std::vector<float> y;
+		std::vector<float> rotation;
+		std::vector<float> scale;
+
+		size_t size() const { return x.size(); }
+
+		void reserve(size_t count) {
+			x.reserve(count);
+			y.reserve(count);
+			rotation.reserve(count);
+			scale.reserve(count);
+		}
+
+		void clear() {
+			x.clear();
+			y.clear();
+			rotation.clear();
+			scale.clear();
+		}
+
+		size_t add(glm::vec2 position) {
+			x.push_back(position.x);
+			y.push_back(position.y);
+			rotation.push_back(0.f);
+			scale.push_back(0.f);
+			return x.size() - 1;
+		}
+	};
+}
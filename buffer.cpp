@@ -0,0 +1,94 @@
+#include "buffer.hpp"
+
+#include <cassert>
+#include <cstring>
+
+namespace vraus_VulkanEngine {
+
+	// Smallest multiple of minOffsetAlignment that can hold instanceSize. minOffsetAlignment is always a power of 2.
+	VkDeviceSize Buffer::getAlignment(VkDeviceSize instanceSize, VkDeviceSize minOffsetAlignment) {
+		if (minOffsetAlignment > 0) {
+			return (instanceSize + minOffsetAlignment - 1) & ~(minOffsetAlignment - 1);
+		}
+		return instanceSize;
+	}
+
+	Buffer::Buffer(
+		Device& device,
+		VkDeviceSize instanceSize,
+		uint32_t instanceCount,
+		VkBufferUsageFlags usageFlags,
+		VkMemoryPropertyFlags memoryPropertyFlags,
+		VkDeviceSize minOffsetAlignment)
+		: device{ device },
+		instanceCount{ instanceCount },
+		instanceSize{ instanceSize },
+		usageFlags{ usageFlags },
+		memoryPropertyFlags{ memoryPropertyFlags } {
+		alignmentSize = getAlignment(instanceSize, minOffsetAlignment);
+		bufferSize = alignmentSize * instanceCount;
+		device.createBuffer(bufferSize, usageFlags, memoryPropertyFlags, buffer, memory);
+	}
+
+	Buffer::~Buffer() {
+		unmap();
+		vkDestroyBuffer(device.device(), buffer, nullptr);
+		device.freeMemory(memory);
+	}
+
+	// Host visible blocks are mapped once by the allocator, since other buffers share them. Mapping only hands out the pointer.
+	VkResult Buffer::map(VkDeviceSize size, VkDeviceSize offset) {
+		assert(buffer && memory.memory && "Called map on buffer before create");
+		if (!memory.mapped) return VK_ERROR_MEMORY_MAP_FAILED;
+		assert((size == VK_WHOLE_SIZE || offset + size <= bufferSize) && "Mapped range outside of the buffer");
+		mapped = static_cast<char*>(memory.mapped) + offset;
+		return VK_SUCCESS;
+	}
+
+	void Buffer::unmap() {
+		mapped = nullptr;
+	}
+
+	void Buffer::writeToBuffer(const void* data, VkDeviceSize size, VkDeviceSize offset) {
+		assert(mapped && "Cannot copy to unmapped buffer");
+
+		if (size == VK_WHOLE_SIZE) {
+			memcpy(mapped, data, bufferSize);
+		}
+		else {
+			char* memOffset = static_cast<char*>(mapped);
+			memOffset += offset;
+			memcpy(memOffset, data, size);
+		}
+	}
+
+	VkResult Buffer::flush(VkDeviceSize size, VkDeviceSize offset) {
+		VkMappedMemoryRange mappedRange = {};
+		mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+		mappedRange.memory = memory.memory;
+		mappedRange.offset = memory.offset + offset;
+		mappedRange.size = size == VK_WHOLE_SIZE ? memory.size - offset : size;
+		return vkFlushMappedMemoryRanges(device.device(), 1, &mappedRange);
+	}
+
+	VkResult Buffer::invalidate(VkDeviceSize size, VkDeviceSize offset) {
+		VkMappedMemoryRange mappedRange = {};
+		mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+		mappedRange.memory = memory.memory;
+		mappedRange.offset = memory.offset + offset;
+		mappedRange.size = size == VK_WHOLE_SIZE ? memory.size - offset : size;
+		return vkInvalidateMappedMemoryRanges(device.device(), 1, &mappedRange);
+	}
+
+	VkDescriptorBufferInfo Buffer::descriptorInfo(VkDeviceSize size, VkDeviceSize offset) const {
+		return VkDescriptorBufferInfo{ buffer, offset, size };
+	}
+
+	void Buffer::writeToIndex(const void* data, int index) {
+		writeToBuffer(data, instanceSize, index * alignmentSize);
+	}
+
+	VkDescriptorBufferInfo Buffer::descriptorInfoForIndex(int index) const {
+		return descriptorInfo(alignmentSize, index * alignmentSize);
+	}
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "device.hpp"
+
+namespace vraus_VulkanEngine {
+	/* Wraps a VkBuffer and its memory. The buffer holds instanceCount elements of instanceSize bytes,
+	each element starting on a multiple of minOffsetAlignment (needed when elements are bound with dynamic offsets).
+	*/
+	class Buffer {
+	public:
+		Buffer(
+			Device& device,
+			VkDeviceSize instanceSize,
+			uint32_t instanceCount,
+			VkBufferUsageFlags usageFlags,
+			VkMemoryPropertyFlags memoryPropertyFlags,
+			VkDeviceSize minOffsetAlignment = 1);
+		~Buffer();
+
+		Buffer(const Buffer&) = delete;
+		Buffer& operator=(const Buffer&) = delete;
+
+		// Maps a memory range of this buffer, only valid for HOST_VISIBLE memory
+		VkResult map(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
+		void unmap();
+
+		void writeToBuffer(const void* data, VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
+		// Only required for non HOST_COHERENT memory
+		VkResult flush(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
+		VkResult invalidate(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
+		VkDescriptorBufferInfo descriptorInfo(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0) const;
+
+		void writeToIndex(const void* data, int index);
+		VkDescriptorBufferInfo descriptorInfoForIndex(int index) const;
+
+		VkBuffer getBuffer() const { return buffer; }
+		void* getMappedMemory() const { return mapped; }
+		uint32_t getInstanceCount() const { return instanceCount; }
+		VkDeviceSize getInstanceSize() const { return instanceSize; }
+		VkDeviceSize getAlignmentSize() const { return alignmentSize; }
+		VkBufferUsageFlags getUsageFlags() const { return usageFlags; }
+		VkMemoryPropertyFlags getMemoryPropertyFlags() const { return memoryPropertyFlags; }
+		VkDeviceSize getBufferSize() const { return bufferSize; }
+
+	private:
+		static VkDeviceSize getAlignment(VkDeviceSize instanceSize, VkDeviceSize minOffsetAlignment);
+
+		Device& device;
+		void* mapped = nullptr;
+		VkBuffer buffer = VK_NULL_HANDLE;
+		MemoryAllocation memory{};
+
+		VkDeviceSize bufferSize;
+		uint32_t instanceCount;
+		VkDeviceSize instanceSize;
+		VkDeviceSize alignmentSize;
+		VkBufferUsageFlags usageFlags;
+		VkMemoryPropertyFlags memoryPropertyFlags;
+	};
+}
@@ -1,2 +1,12 @@
-C:\VulkanSDK\1.3.280.0\Bin\glslc.exe simple_shader.vert -o simple_shader.vert.spv
-C:\VulkanSDK\1.3.280.0\Bin\glslc.exe simple_shader.frag -o simple_shader.frag.spv
\ No newline at end of file
+@echo off
+rem Compiles every shader next to its source. Uses the glslc of the Vulkan SDK when VULKAN_SDK is set (the SDK installer sets it),
+rem the one on the PATH otherwise. compile.sh does the same on Linux and macOS.
+setlocal
+cd /d "%~dp0"
+set "GLSLC=glslc"
+if defined VULKAN_SDK set "GLSLC=%VULKAN_SDK%\Bin\glslc.exe"
+set FAILED=0
+for %%f in (*.vert *.frag *.comp) do (
+	"%GLSLC%" %%f -o %%f.spv || set FAILED=1
+)
+exit /b %FAILED%
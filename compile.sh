@@ -0,0 +1,14 @@
+#!/bin/sh
+# Compiles every shader next to its source, as compile.bat does on Windows. Uses the glslc of the Vulkan SDK when
+# VULKAN_SDK is set, the one on the PATH otherwise (the glslc or shaderc package of most distributions).
+cd "$(dirname "$0")" || exit 1
+GLSLC=glslc
+if [ -n "$VULKAN_SDK" ]; then
+	GLSLC="$VULKAN_SDK/bin/glslc"
+fi
+failed=0
+for shader in *.vert *.frag *.comp; do
+	[ -e "$shader" ] || continue # Pattern without a match
+	"$GLSLC" "$shader" -o "$shader.spv" || failed=1
+done
+exit $failed
@@ -0,0 +1,59 @@
+#include "compute_pipeline.hpp"
+
+#include <stdexcept>
+#include <cassert>
+
+namespace vraus_VulkanEngine {
+	ComputePipeline::ComputePipeline(
+		Device& device,
+		const std::string& compFilepath,
+		VkPipelineLayout pipelineLayout
+	) : device{ device } {
+		try {
+			createComputePipeline(compFilepath, pipelineLayout);
+		}
+		catch (...) {
+			// No destructor for a constructor that throws, the acquired module is released here
+			if (compShaderModule != VK_NULL_HANDLE) device.shaderRegistry().release(compShaderModule);
+			throw;
+		}
+	}
+
+	ComputePipeline::~ComputePipeline()
+	{
+		device.shaderRegistry().release(compShaderModule);
+		vkDestroyPipeline(device.device(), computePipeline, nullptr);
+	}
+
+	void ComputePipeline::bind(VkCommandBuffer commandBuffer)
+	{
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline);
+	}
+
+	void ComputePipeline::createComputePipeline(const std::string& compFilepath, VkPipelineLayout pipelineLayout)
+	{
+		assert(pipelineLayout != VK_NULL_HANDLE && "Cannot create compute pipeline:: no pipelineLayout provided");
+		compShaderModule = device.shaderRegistry().acquire(compFilepath);
+
+		VkPipelineShaderStageCreateInfo shaderStage{};
+		shaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		shaderStage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		shaderStage.module = compShaderModule;
+		shaderStage.pName = "main";
+		shaderStage.flags = 0;
+		shaderStage.pNext = nullptr;
+		shaderStage.pSpecializationInfo = nullptr;
+
+		// A compute pipeline has no fixed function state, only the shader stage and the layout
+		VkComputePipelineCreateInfo pipelineInfo{};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineInfo.stage = shaderStage;
+		pipelineInfo.layout = pipelineLayout;
+		pipelineInfo.basePipelineIndex = -1;
+		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+		if (vkCreateComputePipelines(device.device(), device.pipelineCache(), 1, &pipelineInfo, nullptr, &computePipeline) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create compute pipeline");
+		}
+	}
+}
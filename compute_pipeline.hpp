@@ -0,0 +1,37 @@
+#pragma once
+
+#include "device.hpp"
+
+#include <string>
+#include <vector>
+
+namespace vraus_VulkanEngine {
+	/* Compute counterpart of Pipeline: a single compute shader stage and the layout of the resources it uses.
+	Nothing here depends on a render pass or the swap chain, so it only needs a Device.
+	*/
+	class ComputePipeline {
+	public:
+		ComputePipeline(
+			Device& device,
+			const std::string& compFilepath,
+			VkPipelineLayout pipelineLayout
+		);
+
+		~ComputePipeline();
+
+		ComputePipeline(const ComputePipeline&) = delete;
+		ComputePipeline& operator=(const ComputePipeline&) = delete;
+
+		void bind(VkCommandBuffer commandBuffer);
+
+		// Number of workgroups of localSize invocations needed to cover count invocations
+		static uint32_t groupCount(uint32_t count, uint32_t localSize) { return (count + localSize - 1) / localSize; }
+
+	private:
+		void createComputePipeline(const std::string& compFilepath, VkPipelineLayout pipelineLayout);
+
+		Device& device;
+		VkPipeline computePipeline;
+		VkShaderModule compShaderModule = VK_NULL_HANDLE; // Acquired from the device's ShaderRegistry
+	};
+}
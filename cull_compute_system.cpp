@@ -0,0 +1,384 @@
+#include "cull_compute_system.hpp"
+
+#include "swapChain.hpp"
+#include "simple_render_system.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace vraus_VulkanEngine {
+
+	// cull.comp writes instances as 9 consecutive floats
+	static_assert(sizeof(SimpleRenderSystem::InstanceData) == 9 * sizeof(float), "InstanceData layout doesn't match cull.comp");
+	static_assert(sizeof(CullComputeSystem::CullObject) == 32, "CullObject layout doesn't match cull.comp");
+	static_assert(sizeof(CullComputeSystem::CullTransform) == 32, "CullTransform layout doesn't match cull.comp");
+
+	struct CullPushConstantData {
+		glm::vec4 bounds;
+		uint32_t objectCount;
+	};
+
+	CullComputeSystem::CullComputeSystem(Device& _device) : device{ _device } {
+		createDescriptors();
+		createPipelineLayout();
+		createPipeline();
+
+		frames.resize(SwapChain::MAX_FRAMES_IN_FLIGHT);
+		for (auto& frame : frames) {
+			reserveFrame(frame, 1, 1);
+		}
+	}
+
+	CullComputeSystem::~CullComputeSystem() {
+		vkDestroyPipelineLayout(device.device(), pipelineLayout, nullptr);
+	}
+
+	void CullComputeSystem::createDescriptors()
+	{
+		descriptorPool = DescriptorPool::Builder(device)
+			.setMaxSets(SwapChain::MAX_FRAMES_IN_FLIGHT)
+			.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 6 * SwapChain::MAX_FRAMES_IN_FLIGHT)
+			.build();
+
+		setLayout = DescriptorSetLayout::Builder(device)
+			.addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // objects
+			.addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // instances
+			.addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // commands
+			.addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // counts
+			.addBinding(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // visible objects
+			.addBinding(5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // transforms
+			.build();
+	}
+
+	void CullComputeSystem::createPipelineLayout()
+	{
+		VkPushConstantRange pushConstantRange{};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = sizeof(CullPushConstantData);
+
+		VkDescriptorSetLayout setLayouts[] = { setLayout->getDescriptorSetLayout() };
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = 1;
+		pipelineLayoutInfo.pSetLayouts = setLayouts;
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+		if (vkCreatePipelineLayout(device.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create cull pipeline layout");
+		}
+	}
+
+	void CullComputeSystem::createPipeline()
+	{
+		pipeline = std::make_unique<ComputePipeline>(device, "cull.comp.spv", pipelineLayout);
+	}
+
+	void CullComputeSystem::setObjects(const std::vector<GameObject>& gameObjects)
+	{
+		// Group by model in order of first appearance, each group owns a contiguous range of instance slots
+		std::unordered_map<const Model*, uint32_t> groupIndices{};
+		std::vector<uint32_t> groupCounts{};
+		groupModels.clear();
+		for (auto& obj : gameObjects) {
+			auto inserted = groupIndices.emplace(obj.model.get(), static_cast<uint32_t>(groupModels.size()));
+			if (inserted.second) {
+				groupModels.push_back(obj.model);
+				groupCounts.push_back(0);
+			}
+			groupCounts[inserted.first->second]++;
+		}
+
+		groupBases.assign(groupModels.size(), 0);
+		for (size_t group = 1; group < groupModels.size(); group++) {
+			groupBases[group] = groupBases[group - 1] + groupCounts[group - 1];
+		}
+
+		commandTemplate.resize(groupModels.size());
+		for (size_t group = 0; group < groupModels.size(); group++) {
+			// For non indexed models indexCount, firstIndex and vertexOffset read as vertexCount, firstVertex and firstInstance
+			commandTemplate[group].indexCount = groupModels[group]->getDrawCount();
+			commandTemplate[group].instanceCount = 0;
+			commandTemplate[group].firstIndex = 0;
+			commandTemplate[group].vertexOffset = 0;
+			commandTemplate[group].firstInstance = 0; // Groups are selected by the instance buffer offset instead
+		}
+
+		objects.resize(gameObjects.size());
+		for (size_t i = 0; i < gameObjects.size(); i++) {
+			auto& obj = gameObjects[i];
+			uint32_t group = groupIndices[obj.model.get()];
+
+			CullObject& object = objects[i];
+			object = {};
+			object.color = obj.color;
+			object.group = group;
+			object.instanceBase = groupBases[group];
+		}
+		version++;
+
+		transforms.resize(gameObjects.size());
+		updateTransforms(gameObjects);
+	}
+
+	void CullComputeSystem::updateTransforms(const std::vector<GameObject>& gameObjects)
+	{
+		assert(gameObjects.size() == transforms.size() && "updateTransforms called with other objects than setObjects");
+		for (size_t i = 0; i < gameObjects.size(); i++) {
+			auto& obj = gameObjects[i];
+			glm::mat2 transform = obj.transform2d.mat2();
+
+			CullTransform& objectTransform = transforms[i];
+			objectTransform.transform = { transform[0][0], transform[0][1], transform[1][0], transform[1][1] };
+			objectTransform.offset = obj.transform2d.translation;
+			// Rotation doesn't change the circle, the largest scale bounds the rest. Read every time, models can change their vertices
+			objectTransform.radius = obj.model->getBoundingRadius() * std::max(std::abs(obj.transform2d.scale.x), std::abs(obj.transform2d.scale.y));
+			objectTransform.padding = 0.f;
+		}
+		transformVersion++;
+	}
+
+	VkDeviceSize CullComputeSystem::getGroupInstanceOffset(size_t group) const
+	{
+		return static_cast<VkDeviceSize>(groupBases[group]) * sizeof(SimpleRenderSystem::InstanceData);
+	}
+
+	void CullComputeSystem::reserveFrame(FrameResources& frame, size_t objectCount, size_t groupCount)
+	{
+		// Called once the frame's previous submission is complete, so its buffers can be replaced right away
+		bool changed = false;
+		if (!frame.objects || frame.objects->getInstanceCount() < objectCount) {
+			uint32_t capacity = static_cast<uint32_t>(std::max<size_t>(objectCount, 64));
+			frame.objects = std::make_unique<Buffer>(
+				device,
+				sizeof(CullObject),
+				capacity,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+			frame.objects->map();
+			frame.transforms = std::make_unique<Buffer>(
+				device,
+				sizeof(CullTransform),
+				capacity,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+			frame.transforms->map();
+			frame.instances = std::make_unique<Buffer>(
+				device,
+				sizeof(SimpleRenderSystem::InstanceData),
+				capacity,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			frame.visibleObjects = std::make_unique<Buffer>(
+				device,
+				sizeof(uint32_t),
+				capacity,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			changed = true;
+		}
+		if (!frame.commands || frame.commands->getInstanceCount() < groupCount) {
+			uint32_t capacity = static_cast<uint32_t>(std::max<size_t>(groupCount, 16));
+			const VkBufferUsageFlags usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+				VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+			frame.commands = std::make_unique<Buffer>(
+				device, sizeof(VkDrawIndexedIndirectCommand), capacity, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			frame.counts = std::make_unique<Buffer>(
+				device, sizeof(uint32_t), capacity, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			changed = true;
+		}
+		if (!changed) return;
+
+		auto objectInfo = frame.objects->descriptorInfo();
+		auto instanceInfo = frame.instances->descriptorInfo();
+		auto commandInfo = frame.commands->descriptorInfo();
+		auto countInfo = frame.counts->descriptorInfo();
+		auto visibleInfo = frame.visibleObjects->descriptorInfo();
+		auto transformInfo = frame.transforms->descriptorInfo();
+		DescriptorWriter writer{ *setLayout, *descriptorPool };
+		writer.writeBuffer(0, &objectInfo)
+			.writeBuffer(1, &instanceInfo)
+			.writeBuffer(2, &commandInfo)
+			.writeBuffer(3, &countInfo)
+			.writeBuffer(4, &visibleInfo)
+			.writeBuffer(5, &transformInfo);
+		if (frame.descriptorSet == VK_NULL_HANDLE) {
+			if (!writer.build(frame.descriptorSet)) {
+				throw std::runtime_error("Failed to allocate cull descriptor set");
+			}
+		}
+		else {
+			writer.overwrite(frame.descriptorSet);
+		}
+	}
+
+	void CullComputeSystem::prepareFrame(int frameIndex)
+	{
+		FrameResources& frame = frames[frameIndex];
+		if (frame.uploadedVersion != version) {
+			reserveFrame(frame, objects.size(), groupModels.size());
+			if (!objects.empty()) {
+				frame.objects->writeToBuffer(objects.data(), objects.size() * sizeof(CullObject));
+			}
+			frame.uploadedVersion = version;
+		}
+		// Moving objects only cost this copy per frame
+		if (frame.uploadedTransformVersion != transformVersion) {
+			if (!transforms.empty()) {
+				frame.transforms->writeToBuffer(transforms.data(), transforms.size() * sizeof(CullTransform));
+			}
+			frame.uploadedTransformVersion = transformVersion;
+		}
+	}
+
+	void CullComputeSystem::cull(VkCommandBuffer commandBuffer, int frameIndex)
+	{
+		prepareFrame(frameIndex);
+		if (objects.empty()) return;
+		FrameResources& frame = frames[frameIndex];
+
+		// Reset the counters, vkCmdUpdateBuffer is limited to 64KiB so at most 4096 models
+		const VkDeviceSize commandBytes = commandTemplate.size() * sizeof(VkDrawIndexedIndirectCommand);
+		assert(commandBytes <= 65536 && "Too many models for a single cull pass");
+		vkCmdUpdateBuffer(commandBuffer, frame.commands->getBuffer(), 0, commandBytes, commandTemplate.data());
+		vkCmdFillBuffer(commandBuffer, frame.counts->getBuffer(), 0, commandTemplate.size() * sizeof(uint32_t), 0);
+
+		VkMemoryBarrier resetBarrier{};
+		resetBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		resetBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		resetBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0,
+			1, &resetBarrier,
+			0, nullptr,
+			0, nullptr);
+
+		CullPushConstantData push{};
+		push.bounds = viewBounds;
+		push.objectCount = static_cast<uint32_t>(objects.size());
+
+		pipeline->bind(commandBuffer);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &frame.descriptorSet, 0, nullptr);
+		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullPushConstantData), &push);
+		vkCmdDispatch(commandBuffer, ComputePipeline::groupCount(push.objectCount, LOCAL_SIZE), 1, 1);
+
+		// The draws read the commands and counts as indirect parameters, and the instances as vertex attributes
+		VkMemoryBarrier drawBarrier{};
+		drawBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		drawBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		drawBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+		vkCmdPipelineBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+			0,
+			1, &drawBarrier,
+			0, nullptr,
+			0, nullptr);
+	}
+
+	std::vector<uint32_t> CullComputeSystem::cullOnCpu() const
+	{
+		// Same comparisons as cull.comp, on the same floats, so both sides agree exactly
+		std::vector<uint32_t> visible{};
+		for (uint32_t i = 0; i < objects.size(); i++) {
+			const CullTransform& object = transforms[i];
+			if (object.offset.x + object.radius < viewBounds.x || object.offset.x - object.radius > viewBounds.z ||
+				object.offset.y + object.radius < viewBounds.y || object.offset.y - object.radius > viewBounds.w) {
+				continue;
+			}
+			visible.push_back(i);
+		}
+		return visible;
+	}
+
+	CullComputeSystem::ValidationReport CullComputeSystem::validate()
+	{
+		ValidationReport report{};
+		report.objects = static_cast<uint32_t>(objects.size());
+
+		VkCommandBuffer commandBuffer = device.beginSingleTimeCommands();
+		cull(commandBuffer, 0);
+		device.endSingleTimeCommands(commandBuffer);
+
+		std::vector<uint32_t> expected = cullOnCpu();
+		report.cpuVisible = static_cast<uint32_t>(expected.size());
+		if (objects.empty()) return report;
+
+		// Every group's slots hold the objects it drew, in whatever order the atomics handed them out
+		auto commands = readBack<VkDrawIndexedIndirectCommand>(*frames[0].commands, groupModels.size());
+		auto slots = readBack<uint32_t>(*frames[0].visibleObjects, objects.size());
+		std::vector<uint32_t> drawn{};
+		for (size_t group = 0; group < groupModels.size(); group++) {
+			for (uint32_t i = 0; i < commands[group].instanceCount; i++) {
+				uint32_t object = slots[groupBases[group] + i];
+				// An object drawn under the wrong model counts as drawn wrongly
+				if (object < objects.size() && objects[object].group == group) {
+					drawn.push_back(object);
+				}
+				else {
+					report.extra++;
+				}
+			}
+		}
+		report.gpuVisible = static_cast<uint32_t>(drawn.size()) + report.extra;
+		std::sort(drawn.begin(), drawn.end());
+
+		std::vector<uint32_t> difference{};
+		std::set_difference(expected.begin(), expected.end(), drawn.begin(), drawn.end(), std::back_inserter(difference));
+		report.missing = static_cast<uint32_t>(difference.size());
+		difference.clear();
+		std::set_difference(drawn.begin(), drawn.end(), expected.begin(), expected.end(), std::back_inserter(difference));
+		report.extra += static_cast<uint32_t>(difference.size());
+		return report;
+	}
+
+	template <typename T>
+	std::vector<T> CullComputeSystem::readBack(Buffer& source, size_t count)
+	{
+		const VkDeviceSize size = sizeof(T) * count;
+		Buffer stagingBuffer{
+			device,
+			sizeof(T),
+			static_cast<uint32_t>(count),
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT };
+
+		VkCommandBuffer commandBuffer = device.beginSingleTimeCommands();
+
+		// Covers the dispatch of the previous submission on the same queue
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		vkCmdPipelineBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			0,
+			1, &barrier,
+			0, nullptr,
+			0, nullptr);
+
+		VkBufferCopy copyRegion{};
+		copyRegion.size = size;
+		vkCmdCopyBuffer(commandBuffer, source.getBuffer(), stagingBuffer.getBuffer(), 1, &copyRegion);
+
+		device.endSingleTimeCommands(commandBuffer);
+
+		std::vector<T> values(count);
+		stagingBuffer.map();
+		memcpy(values.data(), stagingBuffer.getMappedMemory(), static_cast<size_t>(size));
+		stagingBuffer.unmap();
+		return values;
+	}
+}
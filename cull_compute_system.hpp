@@ -0,0 +1,122 @@
+#pragma once
+
+#include "device.hpp"
+#include "buffer.hpp"
+#include "descriptors.hpp"
+#include "compute_pipeline.hpp"
+#include "model.hpp"
+#include "game_object.hpp"
+
+#include <memory>
+#include <vector>
+
+namespace vraus_VulkanEngine {
+	/* GPU frustum culling of GameObjects. A compute pass tests every object's bounding circle against the view bounds and
+	compacts the survivors into an instance buffer, one range per Model, while counting them into an indirect draw command
+	per Model. SimpleRenderSystem::renderIndirect then draws each Model with a single indirect draw, so once the objects
+	are uploaded the CPU cost of a frame only depends on the number of different models.
+	What an object is (model, color) is only uploaded when objects are added or removed, moving objects only stream
+	their transforms. Buffers are duplicated per frame in flight.
+	*/
+	class CullComputeSystem {
+	public:
+		static constexpr uint32_t LOCAL_SIZE = 64; // Must match cull.comp
+
+		// Must match CullObject in cull.comp, written by setObjects
+		struct CullObject {
+			glm::vec3 color;
+			uint32_t group;
+			uint32_t instanceBase;
+			uint32_t padding[3];
+		};
+
+		// Must match CullTransform in cull.comp, written by setObjects and updateTransforms
+		struct CullTransform {
+			glm::vec4 transform; // mat2 columns
+			glm::vec2 offset;
+			float radius;
+			float padding;
+		};
+
+		// Set of objects drawn by the GPU compared to the CPU reference
+		struct ValidationReport {
+			uint32_t objects = 0;
+			uint32_t cpuVisible = 0;
+			uint32_t gpuVisible = 0;
+			uint32_t missing = 0; // Visible on the CPU, not drawn by the GPU
+			uint32_t extra = 0; // Drawn by the GPU, culled on the CPU
+
+			bool matches() const { return missing == 0 && extra == 0 && cpuVisible == gpuVisible; }
+		};
+
+		CullComputeSystem(Device& device);
+		~CullComputeSystem();
+
+		CullComputeSystem(const CullComputeSystem&) = delete;
+		CullComputeSystem& operator=(const CullComputeSystem&) = delete;
+
+		// minX, minY, maxX, maxY of what is on screen. No camera yet, so the whole clip space.
+		glm::vec4 viewBounds{ -1.f, -1.f, 1.f, 1.f };
+
+		// Takes a copy of the objects and groups them by model. Only needed when objects are added or removed,
+		// or change model or color. Each frame's buffer is refreshed the next time that frame culls.
+		void setObjects(const std::vector<GameObject>& gameObjects);
+		// Refreshes the transforms and bounding radii only, gameObjects must be the ones given to setObjects, in the same order
+		void updateTransforms(const std::vector<GameObject>& gameObjects);
+
+		// Records the cull pass. Must be recorded outside of a render pass, before renderIndirect for the same frame.
+		void cull(VkCommandBuffer commandBuffer, int frameIndex);
+
+		// CPU version of the cull, indices of the visible objects in increasing order
+		std::vector<uint32_t> cullOnCpu() const;
+		// Runs the cull pass on its own and compares what the GPU would draw against cullOnCpu().
+		// Blocks, uses the resources of frame 0 so must not be called while a frame is in flight. Works without a swap chain.
+		ValidationReport validate();
+
+		size_t getGroupCount() const { return groupModels.size(); }
+		Model& getGroupModel(size_t group) const { return *groupModels[group]; }
+		// Byte offset of the group's range in the instance buffer
+		VkDeviceSize getGroupInstanceOffset(size_t group) const;
+		VkBuffer getInstanceBuffer(int frameIndex) const { return frames[frameIndex].instances->getBuffer(); }
+		VkBuffer getCommandBuffer(int frameIndex) const { return frames[frameIndex].commands->getBuffer(); }
+		VkBuffer getCountBuffer(int frameIndex) const { return frames[frameIndex].counts->getBuffer(); }
+
+	private:
+		struct FrameResources {
+			std::unique_ptr<Buffer> objects; // Host visible, refreshed when outdated
+			std::unique_ptr<Buffer> transforms; // Same
+			std::unique_ptr<Buffer> instances;
+			std::unique_ptr<Buffer> commands;
+			std::unique_ptr<Buffer> counts;
+			std::unique_ptr<Buffer> visibleObjects;
+			VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+			uint64_t uploadedVersion = 0;
+			uint64_t uploadedTransformVersion = 0;
+		};
+
+		void createDescriptors();
+		void createPipelineLayout();
+		void createPipeline();
+		void prepareFrame(int frameIndex);
+		void reserveFrame(FrameResources& frame, size_t objectCount, size_t groupCount);
+		template <typename T>
+		std::vector<T> readBack(Buffer& source, size_t count);
+
+		Device& device;
+
+		std::unique_ptr<DescriptorPool> descriptorPool;
+		std::unique_ptr<DescriptorSetLayout> setLayout;
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+		std::unique_ptr<ComputePipeline> pipeline;
+
+		std::vector<CullObject> objects;
+		std::vector<CullTransform> transforms;
+		std::vector<std::shared_ptr<Model>> groupModels;
+		std::vector<uint32_t> groupBases;
+		std::vector<VkDrawIndexedIndirectCommand> commandTemplate; // instanceCount 0, written at the start of every pass
+		uint64_t version = 1; // Incremented by every setObjects
+		uint64_t transformVersion = 1; // Incremented by every setObjects and updateTransforms
+
+		std::vector<FrameResources> frames;
+	};
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "device.hpp"
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace vraus_VulkanEngine {
+	/* Describes which resources (buffers, images) a shader expects and at which binding.
+	Built with DescriptorSetLayout::Builder so a system only lists the bindings it actually uses.
+	*/
+	class DescriptorSetLayout {
+	public:
+		class Builder {
+		public:
+			Builder(Device& device) : device{ device } {}
+
+			Builder& addBinding(
+				uint32_t binding,
+				VkDescriptorType descriptorType,
+				VkShaderStageFlags stageFlags,
+				uint32_t count = 1);
+			std::unique_ptr<DescriptorSetLayout> build() const;
+
+		private:
+			Device& device;
+			std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings{};
+		};
+
+		DescriptorSetLayout(Device& device, std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings);
+		~DescriptorSetLayout();
+
+		DescriptorSetLayout(const DescriptorSetLayout&) = delete;
+		DescriptorSetLayout& operator=(const DescriptorSetLayout&) = delete;
+
+		VkDescriptorSetLayout getDescriptorSetLayout() const { return descriptorSetLayout; }
+
+	private:
+		Device& device;
+		VkDescriptorSetLayout descriptorSetLayout;
+		std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings;
+
+		friend class DescriptorWriter;
+	};
+
+	// Descriptor sets are allocated from a pool sized up front for every descriptor type it will hand out
+	class DescriptorPool {
+	public:
+		class Builder {
+		public:
+			Builder(Device& device) : device{ device } {}
+
+			Builder& addPoolSize(VkDescriptorType descriptorType, uint32_t count);
+			Builder& setPoolFlags(VkDescriptorPoolCreateFlags flags);
+			Builder& setMaxSets(uint32_t count);
+			std::unique_ptr<DescriptorPool> build() const;
+
+		private:
+			Device& device;
+			std::vector<VkDescriptorPoolSize> poolSizes{};
+			uint32_t maxSets = 1000;
+			VkDescriptorPoolCreateFlags poolFlags = 0;
+		};
+
+		DescriptorPool(
+			Device& device,
+			uint32_t maxSets,
+			VkDescriptorPoolCreateFlags poolFlags,
+			const std::vector<VkDescriptorPoolSize>& poolSizes);
+		~DescriptorPool();
+
+		DescriptorPool(const DescriptorPool&) = delete;
+		DescriptorPool& operator=(const DescriptorPool&) = delete;
+
+		bool allocateDescriptor(const VkDescriptorSetLayout descriptorSetLayout, VkDescriptorSet& descriptor) const;
+		// Requires VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT
+		void freeDescriptors(std::vector<VkDescriptorSet>& descriptors) const;
+		void resetPool();
+
+	private:
+		Device& device;
+		VkDescriptorPool descriptorPool;
+
+		friend class DescriptorWriter;
+	};
+
+	// Collects the resources of a set, checked against its layout, then allocates (build) or updates (overwrite) it
+	class DescriptorWriter {
+	public:
+		DescriptorWriter(DescriptorSetLayout& setLayout, DescriptorPool& pool);
+
+		DescriptorWriter& writeBuffer(uint32_t binding, const VkDescriptorBufferInfo* bufferInfo);
+		DescriptorWriter& writeImage(uint32_t binding, const VkDescriptorImageInfo* imageInfo);
+
+		bool build(VkDescriptorSet& set);
+		void overwrite(VkDescriptorSet& set);
+
+	private:
+		DescriptorSetLayout& setLayout;
+		DescriptorPool& pool;
+		std::vector<VkWriteDescriptorSet> writes;
+	};
+}
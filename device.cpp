@@ -2,6 +2,8 @@
 
 // std headers
 #include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
 #include <set>
 #include <unordered_set>
@@ -47,17 +49,70 @@ namespace vraus_VulkanEngine {
         }
     }
 
+    // Written in front of the driver's cache data. The driver header only identifies the device, driverVersion is
+    // checked here too, and dataHash catches files cut short by a crash.
+    struct PipelineCacheFileHeader {
+        uint32_t magic;
+        uint32_t fileVersion;
+        uint32_t vendorID;
+        uint32_t deviceID;
+        uint32_t driverVersion;
+        uint32_t reserved;
+        uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+        uint64_t dataSize;
+        uint64_t dataHash;
+    };
+
+    static constexpr uint32_t PIPELINE_CACHE_MAGIC = 0x43505856; // "VXPC"
+    static constexpr uint32_t PIPELINE_CACHE_FILE_VERSION = 1;
+
+    // Header the driver puts at the start of vkGetPipelineCacheData, laid out by the Vulkan spec
+    struct PipelineCacheHeaderVersionOne {
+        uint32_t headerSize;
+        uint32_t headerVersion;
+        uint32_t vendorID;
+        uint32_t deviceID;
+        uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+    };
+
+    static uint64_t fnv1a64(const char* data, size_t size) {
+        uint64_t hash = 14695981039346656037ull;
+        for (size_t i = 0; i < size; i++) {
+            hash ^= static_cast<uint8_t>(data[i]);
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
     // class member functions
-    Device::Device(Window& window) : window{ window } {
+    Device::Device(Window& window) : window{ &window } {
         createInstance();
         setupDebugMessenger();
         createSurface();
         pickPhysicalDevice();
         createLogicalDevice();
         createCommandPool();
+        createAllocator();
+        createPipelineCache();
+        shaderRegistry_ = std::make_unique<ShaderRegistry>(device_);
+    }
+
+    Device::Device() : window{ nullptr } {
+        createInstance();
+        setupDebugMessenger();
+        pickPhysicalDevice();
+        createLogicalDevice();
+        createCommandPool();
+        createAllocator();
+        createPipelineCache();
+        shaderRegistry_ = std::make_unique<ShaderRegistry>(device_);
     }
 
     Device::~Device() {
+        savePipelineCache();
+        vkDestroyPipelineCache(device_, pipelineCache_, nullptr);
+        shaderRegistry_.reset();
+        allocator.reset();
         vkDestroyCommandPool(device_, commandPool, nullptr);
         vkDestroyDevice(device_, nullptr);
 
@@ -65,7 +120,10 @@ namespace vraus_VulkanEngine {
             DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
         }
 
-        vkDestroySurfaceKHR(instance, surface_, nullptr);
+        // Headless devices never enable VK_KHR_surface, the function must not be called at all
+        if (surface_ != VK_NULL_HANDLE) {
+            vkDestroySurfaceKHR(instance, surface_, nullptr);
+        }
         vkDestroyInstance(instance, nullptr);
     }
 
@@ -140,6 +198,9 @@ namespace vraus_VulkanEngine {
 
         std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
         std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily, indices.presentFamily };
+        if (indices.transferFamilyHasValue) {
+            uniqueQueueFamilies.insert(indices.transferFamily);
+        }
 
         float queuePriority = 1.0f;
         for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -160,9 +221,13 @@ namespace vraus_VulkanEngine {
         createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
         createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
+        std::vector<const char*> optionalExtensions = getSupportedOptionalExtensions(physicalDevice);
+        std::vector<const char*> enabledExtensions = getRequiredDeviceExtensions();
+        enabledExtensions.insert(enabledExtensions.end(), optionalExtensions.begin(), optionalExtensions.end());
+
         createInfo.pEnabledFeatures = &deviceFeatures;
-        createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-        createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+        createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+        createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
         // might not really be necessary anymore because device specific validation layers
         // have been deprecated
@@ -180,6 +245,153 @@ namespace vraus_VulkanEngine {
 
         vkGetDeviceQueue(device_, indices.graphicsFamily, 0, &graphicsQueue_);
         vkGetDeviceQueue(device_, indices.presentFamily, 0, &presentQueue_);
+        graphicsFamily_ = indices.graphicsFamily;
+        transferFamily_ = indices.transferFamilyHasValue ? indices.transferFamily : indices.graphicsFamily;
+        vkGetDeviceQueue(device_, transferFamily_, 0, &transferQueue_);
+
+        loadOptionalFunctions(optionalExtensions);
+    }
+
+    std::vector<const char*> Device::getSupportedOptionalExtensions(VkPhysicalDevice device) {
+        uint32_t extensionCount;
+        vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+        std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+        vkEnumerateDeviceExtensionProperties(
+            device,
+            nullptr,
+            &extensionCount,
+            availableExtensions.data());
+
+        std::vector<const char*> supported;
+        for (const char* optional : optionalDeviceExtensions) {
+            for (const auto& extension : availableExtensions) {
+                if (strcmp(optional, extension.extensionName) == 0) {
+                    supported.push_back(optional);
+                    break;
+                }
+            }
+        }
+        return supported;
+    }
+
+    void Device::loadOptionalFunctions(const std::vector<const char*>& enabledOptionalExtensions) {
+        for (const char* extension : enabledOptionalExtensions) {
+            if (strcmp(extension, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME) == 0) {
+                cmdDrawIndirectCount = reinterpret_cast<PFN_vkCmdDrawIndirectCountKHR>(
+                    vkGetDeviceProcAddr(device_, "vkCmdDrawIndirectCountKHR"));
+                cmdDrawIndexedIndirectCount = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(
+                    vkGetDeviceProcAddr(device_, "vkCmdDrawIndexedIndirectCountKHR"));
+            }
+        }
+    }
+
+    void Device::createAllocator() {
+        VkPhysicalDeviceMemoryProperties memProperties;
+        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+        allocator = std::make_unique<MemoryAllocator>(device_, memProperties, properties.limits);
+    }
+
+    void Device::createPipelineCache() {
+        std::vector<char> initialData = readPipelineCacheFile();
+
+        VkPipelineCacheCreateInfo cacheInfo = {};
+        cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+        cacheInfo.initialDataSize = initialData.size();
+        cacheInfo.pInitialData = initialData.empty() ? nullptr : initialData.data();
+
+        if (vkCreatePipelineCache(device_, &cacheInfo, nullptr, &pipelineCache_) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create pipeline cache!");
+        }
+    }
+
+    std::vector<char> Device::readPipelineCacheFile() {
+        std::ifstream file{ pipelineCachePath, std::ios::binary };
+        if (!file.is_open()) return {}; // First launch
+
+        PipelineCacheFileHeader header = {};
+        if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+            header.magic != PIPELINE_CACHE_MAGIC ||
+            header.fileVersion != PIPELINE_CACHE_FILE_VERSION ||
+            header.vendorID != properties.vendorID ||
+            header.deviceID != properties.deviceID ||
+            header.driverVersion != properties.driverVersion ||
+            memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+            std::cout << "pipeline cache: " << pipelineCachePath << " is from another device or driver, ignored" << std::endl;
+            return {};
+        }
+
+        // Check the recorded size against what the file holds before allocating it
+        std::streampos dataStart = file.tellg();
+        file.seekg(0, std::ios::end);
+        std::streamoff remaining = file.tellg() - dataStart;
+        file.seekg(dataStart);
+        if (remaining < 0 || static_cast<uint64_t>(remaining) != header.dataSize) {
+            std::cout << "pipeline cache: " << pipelineCachePath << " is corrupted, ignored" << std::endl;
+            return {};
+        }
+
+        std::vector<char> data(static_cast<size_t>(header.dataSize));
+        if (!file.read(data.data(), data.size()) || fnv1a64(data.data(), data.size()) != header.dataHash) {
+            std::cout << "pipeline cache: " << pipelineCachePath << " is corrupted, ignored" << std::endl;
+            return {};
+        }
+
+        // Some drivers don't validate what they are given, check their own header too
+        PipelineCacheHeaderVersionOne driverHeader = {};
+        if (data.size() < sizeof(driverHeader)) return {};
+        memcpy(&driverHeader, data.data(), sizeof(driverHeader));
+        if (driverHeader.headerSize < sizeof(driverHeader) ||
+            driverHeader.headerSize > data.size() ||
+            driverHeader.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+            driverHeader.vendorID != properties.vendorID ||
+            driverHeader.deviceID != properties.deviceID ||
+            memcmp(driverHeader.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+            return {};
+        }
+        return data;
+    }
+
+    void Device::savePipelineCache() {
+        // Called from the destructor, failing to save only costs compile time on the next launch so nothing throws
+        size_t dataSize = 0;
+        if (vkGetPipelineCacheData(device_, pipelineCache_, &dataSize, nullptr) != VK_SUCCESS || dataSize == 0) return;
+        std::vector<char> data(dataSize);
+        if (vkGetPipelineCacheData(device_, pipelineCache_, &dataSize, data.data()) != VK_SUCCESS) return;
+        data.resize(dataSize);
+
+        PipelineCacheFileHeader header = {};
+        header.magic = PIPELINE_CACHE_MAGIC;
+        header.fileVersion = PIPELINE_CACHE_FILE_VERSION;
+        header.vendorID = properties.vendorID;
+        header.deviceID = properties.deviceID;
+        header.driverVersion = properties.driverVersion;
+        memcpy(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+        header.dataSize = data.size();
+        header.dataHash = fnv1a64(data.data(), data.size());
+
+        // Written next to the cache then renamed over it, a crash midway never leaves a half written cache behind
+        const std::string temporaryPath = pipelineCachePath + ".tmp";
+        {
+            std::ofstream file{ temporaryPath, std::ios::binary | std::ios::trunc };
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            file.write(data.data(), data.size());
+            file.flush();
+            if (!file) {
+                std::cerr << "pipeline cache: failed to write " << temporaryPath << std::endl;
+                file.close();
+                std::error_code removeError;
+                std::filesystem::remove(temporaryPath, removeError);
+                return;
+            }
+        }
+
+        std::error_code renameError;
+        std::filesystem::rename(temporaryPath, pipelineCachePath, renameError); // Replaces the old file
+        if (renameError) {
+            std::cerr << "pipeline cache: failed to replace " << pipelineCachePath << ": " << renameError.message() << std::endl;
+            std::filesystem::remove(temporaryPath, renameError);
+        }
     }
 
     void Device::createCommandPool() {
@@ -196,15 +408,16 @@ namespace vraus_VulkanEngine {
         }
     }
 
-    void Device::createSurface() { window.createWindowSurface(instance, &surface_); }
+    void Device::createSurface() { window->createWindowSurface(instance, &surface_); }
 
     bool Device::isDeviceSuitable(VkPhysicalDevice device) {
         QueueFamilyIndices indices = findQueueFamilies(device);
 
         bool extensionsSupported = checkDeviceExtensionSupport(device);
 
-        bool swapChainAdequate = false;
-        if (extensionsSupported) {
+        // Headless devices never present
+        bool swapChainAdequate = isHeadless();
+        if (extensionsSupported && !isHeadless()) {
             SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
             swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
         }
@@ -264,11 +477,13 @@ namespace vraus_VulkanEngine {
     }
 
     std::vector<const char*> Device::getRequiredExtensions() {
-        uint32_t glfwExtensionCount = 0;
-        const char** glfwExtensions;
-        glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-
-        std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+        std::vector<const char*> extensions;
+        if (!isHeadless()) {
+            uint32_t glfwExtensionCount = 0;
+            const char** glfwExtensions;
+            glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+            extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+        }
 
         if (enableValidationLayers) {
             extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -311,7 +526,8 @@ namespace vraus_VulkanEngine {
             &extensionCount,
             availableExtensions.data());
 
-        std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
+        std::vector<const char*> required = getRequiredDeviceExtensions();
+        std::set<std::string> requiredExtensions(required.begin(), required.end());
 
         for (const auto& extension : availableExtensions) {
             requiredExtensions.erase(extension.extensionName);
@@ -320,6 +536,11 @@ namespace vraus_VulkanEngine {
         return requiredExtensions.empty();
     }
 
+    std::vector<const char*> Device::getRequiredDeviceExtensions() {
+        if (isHeadless()) return {}; // Nothing is presented, the swapchain extension isn't needed
+        return deviceExtensions;
+    }
+
     QueueFamilyIndices Device::findQueueFamilies(VkPhysicalDevice device) {
         QueueFamilyIndices indices;
 
@@ -336,7 +557,12 @@ namespace vraus_VulkanEngine {
                 indices.graphicsFamilyHasValue = true;
             }
             VkBool32 presentSupport = false;
-            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
+            if (isHeadless()) {
+                presentSupport = (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) ? VK_TRUE : VK_FALSE; // Present queue is just the graphics one
+            }
+            else {
+                vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
+            }
             if (queueFamily.queueCount > 0 && presentSupport) {
                 indices.presentFamily = i;
                 indices.presentFamilyHasValue = true;
@@ -348,6 +574,17 @@ namespace vraus_VulkanEngine {
             i++;
         }
 
+        // Queue families with only the transfer bit run on the copy engine, in parallel with graphics work
+        for (uint32_t family = 0; family < queueFamilyCount; family++) {
+            const VkQueueFlags flags = queueFamilies[family].queueFlags;
+            if (queueFamilies[family].queueCount > 0 && (flags & VK_QUEUE_TRANSFER_BIT) &&
+                !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+                indices.transferFamily = family;
+                indices.transferFamilyHasValue = true;
+                break;
+            }
+        }
+
         return indices;
     }
 
@@ -413,7 +650,7 @@ namespace vraus_VulkanEngine {
             VkBufferUsageFlags usage,
             VkMemoryPropertyFlags properties,
             VkBuffer& buffer,
-            VkDeviceMemory& bufferMemory) {
+            MemoryAllocation& bufferMemory) {
         VkBufferCreateInfo bufferInfo{};
         bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
         bufferInfo.size = size;
@@ -427,16 +664,14 @@ namespace vraus_VulkanEngine {
         VkMemoryRequirements memRequirements;
         vkGetBufferMemoryRequirements(device_, buffer, &memRequirements);
 
-        VkMemoryAllocateInfo allocInfo{};
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.allocationSize = memRequirements.size;
-        allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+        bufferMemory = allocator->allocate(
+            memRequirements,
+            findMemoryType(memRequirements.memoryTypeBits, properties),
+            MemoryAllocator::ResourceKind::Linear);
 
-        if (vkAllocateMemory(device_, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-            throw std::runtime_error("failed to allocate vertex buffer memory!");
+        if (vkBindBufferMemory(device_, buffer, bufferMemory.memory, bufferMemory.offset) != VK_SUCCESS) {
+            throw std::runtime_error("failed to bind buffer memory!");
         }
-
-        vkBindBufferMemory(device_, buffer, bufferMemory, 0);
     }
 
     VkCommandBuffer Device::beginSingleTimeCommands() {
@@ -465,8 +700,16 @@ namespace vraus_VulkanEngine {
         submitInfo.commandBufferCount = 1;
         submitInfo.pCommandBuffers = &commandBuffer;
 
-        vkQueueSubmit(graphicsQueue_, 1, &submitInfo, VK_NULL_HANDLE);
-        vkQueueWaitIdle(graphicsQueue_);
+        // Waits for this submission only, vkQueueWaitIdle would also wait for the frames in flight
+        VkFenceCreateInfo fenceInfo{};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        VkFence fence;
+        if (vkCreateFence(device_, &fenceInfo, nullptr, &fence) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create single time command fence!");
+        }
+        vkQueueSubmit(graphicsQueue_, 1, &submitInfo, fence);
+        vkWaitForFences(device_, 1, &fence, VK_TRUE, UINT64_MAX);
+        vkDestroyFence(device_, fence, nullptr);
 
         vkFreeCommandBuffers(device_, commandPool, 1, &commandBuffer);
     }
@@ -514,7 +757,7 @@ namespace vraus_VulkanEngine {
         const VkImageCreateInfo& imageInfo,
         VkMemoryPropertyFlags properties,
         VkImage& image,
-        VkDeviceMemory& imageMemory) {
+        MemoryAllocation& imageMemory) {
         if (vkCreateImage(device_, &imageInfo, nullptr, &image) != VK_SUCCESS) {
             throw std::runtime_error("failed to create image!");
         }
@@ -522,16 +765,12 @@ namespace vraus_VulkanEngine {
         VkMemoryRequirements memRequirements;
         vkGetImageMemoryRequirements(device_, image, &memRequirements);
 
-        VkMemoryAllocateInfo allocInfo{};
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.allocationSize = memRequirements.size;
-        allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-
-        if (vkAllocateMemory(device_, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-            throw std::runtime_error("failed to allocate image memory!");
-        }
+        imageMemory = allocator->allocate(
+            memRequirements,
+            findMemoryType(memRequirements.memoryTypeBits, properties),
+            imageInfo.tiling == VK_IMAGE_TILING_OPTIMAL ? MemoryAllocator::ResourceKind::Optimal : MemoryAllocator::ResourceKind::Linear);
 
-        if (vkBindImageMemory(device_, image, imageMemory, 0) != VK_SUCCESS) {
+        if (vkBindImageMemory(device_, image, imageMemory.memory, imageMemory.offset) != VK_SUCCESS) {
             throw std::runtime_error("failed to bind image memory!");
         }
     }
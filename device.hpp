@@ -1,8 +1,12 @@
 #pragma once
 
 #include "window.hpp"
+#include "memory_allocator.hpp"
+#include "shader_registry.hpp"
 
 // std lib headers
+#include <memory>
+#include <ostream>
 #include <string>
 #include <vector>
 
@@ -17,8 +21,10 @@ namespace vraus_VulkanEngine {
     struct QueueFamilyIndices {
         uint32_t graphicsFamily;
         uint32_t presentFamily;
+        uint32_t transferFamily; // Transfer only family (DMA engine), optional
         bool graphicsFamilyHasValue = false;
         bool presentFamilyHasValue = false;
+        bool transferFamilyHasValue = false;
         bool isComplete() { return graphicsFamilyHasValue && presentFamilyHasValue; }
     };
 
@@ -31,6 +37,8 @@ namespace vraus_VulkanEngine {
 #endif
 
         Device(Window& window);
+        // Headless: no surface and no swapchain extension, every queue family able to draw is accepted
+        Device();
         ~Device();
 
         // Not copyable or movable
@@ -40,10 +48,18 @@ namespace vraus_VulkanEngine {
         Device& operator=(Device&&) = delete;
 
         VkCommandPool getCommandPool() { return commandPool; }
+        // Shared by every pipeline creation, loaded from pipelineCachePath and saved back when the device is destroyed
+        VkPipelineCache pipelineCache() { return pipelineCache_; }
         VkDevice device() { return device_; }
         VkSurfaceKHR surface() { return surface_; }
+        bool isHeadless() const { return window == nullptr; }
         VkQueue graphicsQueue() { return graphicsQueue_; }
         VkQueue presentQueue() { return presentQueue_; }
+        // The dedicated transfer queue when the device has one, the graphics queue otherwise
+        VkQueue transferQueue() { return transferQueue_; }
+        uint32_t transferQueueFamily() const { return transferFamily_; }
+        uint32_t graphicsQueueFamily() const { return graphicsFamily_; }
+        bool hasDedicatedTransferQueue() const { return transferFamily_ != graphicsFamily_; }
 
         SwapChainSupportDetails getSwapChainSupport() { return querySwapChainSupport(physicalDevice); }
         uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
@@ -52,12 +68,13 @@ namespace vraus_VulkanEngine {
             const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
 
         // Buffer Helper Functions
+        // Buffers and images get a range of a shared memory block from the allocator, release it with freeMemory
         void createBuffer(
             VkDeviceSize size,
             VkBufferUsageFlags usage,
             VkMemoryPropertyFlags properties,
             VkBuffer& buffer,
-            VkDeviceMemory& bufferMemory);
+            MemoryAllocation& bufferMemory);
         VkCommandBuffer beginSingleTimeCommands();
         void endSingleTimeCommands(VkCommandBuffer commandBuffer);
         void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
@@ -68,10 +85,19 @@ namespace vraus_VulkanEngine {
             const VkImageCreateInfo& imageInfo,
             VkMemoryPropertyFlags properties,
             VkImage& image,
-            VkDeviceMemory& imageMemory);
+            MemoryAllocation& imageMemory);
+        void freeMemory(MemoryAllocation& allocation) { allocator->free(allocation); }
+        MemoryAllocator::Stats getMemoryStats() const { return allocator->getStats(); }
+        void dumpMemoryStats(std::ostream& out) const { allocator->dumpStats(out); }
+        ShaderRegistry& shaderRegistry() { return *shaderRegistry_; }
 
         VkPhysicalDeviceProperties properties;
 
+        // From VK_KHR_draw_indirect_count, null when the device doesn't support it
+        PFN_vkCmdDrawIndirectCountKHR cmdDrawIndirectCount = nullptr;
+        PFN_vkCmdDrawIndexedIndirectCountKHR cmdDrawIndexedIndirectCount = nullptr;
+        bool supportsDrawIndirectCount() const { return cmdDrawIndirectCount != nullptr && cmdDrawIndexedIndirectCount != nullptr; }
+
     private:
         void createInstance();
         void setupDebugMessenger();
@@ -79,6 +105,9 @@ namespace vraus_VulkanEngine {
         void pickPhysicalDevice();
         void createLogicalDevice();
         void createCommandPool();
+        void createAllocator();
+        void createPipelineCache();
+        void savePipelineCache();
 
         // helper functions
         bool isDeviceSuitable(VkPhysicalDevice device);
@@ -88,21 +117,35 @@ namespace vraus_VulkanEngine {
         void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT& createInfo);
         void hasGflwRequiredInstanceExtensions();
         bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+        std::vector<const char*> getRequiredDeviceExtensions();
+        // Cache data from pipelineCachePath, empty when missing or written by another device or driver
+        std::vector<char> readPipelineCacheFile();
+        std::vector<const char*> getSupportedOptionalExtensions(VkPhysicalDevice device);
+        void loadOptionalFunctions(const std::vector<const char*>& enabledOptionalExtensions);
         SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
 
         VkInstance instance;
         VkDebugUtilsMessengerEXT debugMessenger;
         VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
-        Window& window;
+        Window* window; // Null when headless
         VkCommandPool commandPool;
+        std::unique_ptr<MemoryAllocator> allocator;
+        VkPipelineCache pipelineCache_ = VK_NULL_HANDLE;
+        std::unique_ptr<ShaderRegistry> shaderRegistry_;
 
         VkDevice device_;
-        VkSurfaceKHR surface_;
+        VkSurfaceKHR surface_ = VK_NULL_HANDLE;
         VkQueue graphicsQueue_;
         VkQueue presentQueue_;
+        VkQueue transferQueue_;
+        uint32_t graphicsFamily_;
+        uint32_t transferFamily_;
 
         const std::vector<const char*> validationLayers = { "VK_LAYER_KHRONOS_validation" };
         const std::vector<const char*> deviceExtensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+        // Enabled when available, features relying on them check for them first
+        const std::vector<const char*> optionalDeviceExtensions = { VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME };
+        const std::string pipelineCachePath = "pipeline_cache.bin";
     };
 
 }  // namespace lve
\ No newline at end of file
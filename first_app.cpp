@@ -1,6 +1,16 @@
 #include "first_app.hpp"
 
 #include "simple_render_system.hpp"
+#include "gravity_physics_system.hpp"
+#include "vec2_field_system.hpp"
+#include "vec2_field_compute_system.hpp"
+#include "gravity_compute_system.hpp"
+#include "simulation_thread.hpp"
+#include "cull_compute_system.hpp"
+#include "parallel_command_recorder.hpp"
+#include "pipeline_manager.hpp"
+#include "pipeline_state_cache.hpp"
+#include "shader_watcher.hpp"
 
 // libs
 #define GLM_FORCE_RADIANS
@@ -11,119 +21,109 @@
 #include <cassert>
 #include <stdexcept>
 #include <array>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <thread>
 
 namespace vraus_VulkanEngine {
 
-	class GravityPhysicsSystem {
-	public:
-		GravityPhysicsSystem(float strength) : strengthGravity{ strength } {}
-
-		const float strengthGravity;
-
-		// dt stands for delta time. Specifies the amount of time to advance the simulation
-		// substeps is how many intervals to divide the forward time step in. More substeps result in a
-		// more stable simulation, but takes longer to compute.
-		void update(std::vector<GameObject>& objs, float dt, unsigned int substeps = 1) {
-			const float stepDelta = dt / substeps;
-			for (unsigned int i = 0; i < substeps; i++) {
-				stepSimulation(objs, stepDelta);
-			}
-		}
-
-		glm::vec2 computeForce(const GameObject& fromObj, const GameObject& toObj) const {
-			auto offset = fromObj.transform2d.translation - toObj.transform2d.translation;
-			float distanceSquared = glm::dot(offset, offset);
-
-			// Just to ensure a 0 return if objects are to close to each other.
-			if (glm::abs(distanceSquared) < 1e-10f)
-				return { .0f,.0f };
-
-			float force = strengthGravity * toObj.rigidBody2d.mass * fromObj.rigidBody2d.mass / distanceSquared;
-			return force * offset / glm::sqrt(distanceSquared);
-		}
-
-	private:
-		void stepSimulation(std::vector<GameObject>& physicsObjs, float dt) const {
-			// Loops through all pairs of objects and applies attractive force between them
-			for (auto iterA = physicsObjs.begin(); iterA != physicsObjs.end(); ++iterA) {
-				auto& objA = *iterA;
-				for (auto iterB = iterA; iterB != physicsObjs.end(); ++iterB) {
-					if (iterA == iterB) continue;
-					auto& objB = *iterB;
-
-					auto force = computeForce(objA, objB);
-					objA.rigidBody2d.velocity += dt * -force / objA.rigidBody2d.mass;
-					objB.rigidBody2d.velocity += dt * force / objB.rigidBody2d.mass;
-				}
-			}
-
-			// Update each objects position based on its final velocity
-			for (auto& obj : physicsObjs) {
-				obj.transform2d.translation += dt * obj.rigidBody2d.velocity;
-			}
-		}
-
-
-	};
-
-	class Vec2FieldSystem {
-	public:
-		void update(
-			const GravityPhysicsSystem& physicsSystem,
-			std::vector<GameObject>& physicsObjs,
-			std::vector<GameObject>& vectorField
-		) {
-			// For each field line we calculate the net gravitation force for that point in space.
-			for (auto& vf : vectorField) {
-				glm::vec2 direction{};
-				for (auto& obj : physicsObjs) {
-					direction += physicsSystem.computeForce(obj, vf);
-				}
-
-				// This scales the length of the field line based on the log of the length.
-				vf.transform2d.scale.x = 
-					0.005f + 0.045f * glm::clamp(glm::log(glm::length(direction) + 1) / 3.f, 0.f, 1.f);
-				vf.transform2d.rotation = atan2(direction.y, direction.x);
-
-			}
-		}
-	};
-
-	static std::unique_ptr<Model> createSquareModel(Device& device, glm::vec2 offset) {
-		std::vector<Model::Vertex> vertices = {
+	static std::unique_ptr<Model> createSquareModel(Device& device, UploadService& uploadService, glm::vec2 offset) {
+		std::vector<Model::Vertex> corners = {
 			{{-0.5f, -0.5f}},
+			{{0.5f, -0.5f}},
 			{{0.5f, 0.5f}},
 			{{-0.5f, 0.5f}},
-			{{-0.5f, -0.5f}},
-			{{0.5f, -0.5f}},
-			{{0.5f, 0.5f}}, //
 		};
-		for (auto& v : vertices) {
+		for (auto& v : corners) {
 			v.position += offset;
 		}
-		return std::make_unique<Model>(device, vertices);
+		Model::Builder builder{};
+		builder.addTriangle(corners[0], corners[2], corners[3]);
+		builder.addTriangle(corners[0], corners[1], corners[2]);
+		return std::make_unique<Model>(device, builder, uploadService);
 	}
 
-	static std::unique_ptr<Model> createCircleModel(Device& device, unsigned int numSides) {
+	static std::unique_ptr<Model> createCircleModel(Device& device, UploadService& uploadService, unsigned int numSides) {
 		std::vector<Model::Vertex> uniqueVertices{};
-		// uniqueVertices.reserve(numSides + 1);
-		for (int i = 0; i < numSides; i++) {
+		uniqueVertices.reserve(numSides + 1);
+		for (unsigned int i = 0; i < numSides; i++) {
 			float angle = i * glm::two_pi<float>() / numSides;
 			uniqueVertices.push_back({ {glm::cos(angle), glm::sin(angle)} });
 		}
 		uniqueVertices.push_back({}); // adds center vertex at 0, 0
 
-		std::vector<Model::Vertex> vertices{};
-		// vertices.reserve(numSides * 3);
-		for (int i = 0; i < numSides; i++) {
-			vertices.push_back(uniqueVertices[i]);
-			vertices.push_back(uniqueVertices[(i + 1) % numSides]);
-			vertices.push_back(uniqueVertices[numSides]);
+		// The builder keeps numSides + 1 vertices and indexes them, instead of numSides * 3 copies
+		Model::Builder builder{};
+		for (unsigned int i = 0; i < numSides; i++) {
+			builder.addTriangle(uniqueVertices[i], uniqueVertices[(i + 1) % numSides], uniqueVertices[numSides]);
 		}
-		return std::make_unique<Model>(device, vertices);
+		return std::make_unique<Model>(device, builder, uploadService);
 	}
 
-	FirstApp::FirstApp() {
+	// The simulation runs on BodyStore / FieldStore, these copy state between them and the GameObjects used for rendering.
+	static void loadBodies(const std::vector<GameObject>& physicsObjs, BodyStore& bodies) {
+		bodies.clear();
+		bodies.reserve(physicsObjs.size());
+		for (auto& obj : physicsObjs) {
+			bodies.add(obj.transform2d.translation, obj.rigidBody2d.velocity, obj.rigidBody2d.mass);
+		}
+	}
+
+	static void syncBodies(const BodyStore& bodies, std::vector<GameObject>& physicsObjs) {
+		assert(bodies.size() == physicsObjs.size() && "Body store is out of sync with its game objects");
+		for (size_t i = 0; i < physicsObjs.size(); i++) {
+			physicsObjs[i].transform2d.translation = bodies.position(i);
+			physicsObjs[i].rigidBody2d.velocity = bodies.velocity(i);
+		}
+	}
+
+	static void loadField(const std::vector<GameObject>& vectorField, FieldStore& field) {
+		field.clear();
+		field.reserve(vectorField.size());
+		for (auto& vf : vectorField) {
+			field.add(vf.transform2d.translation);
+		}
+	}
+
+	// Small triangles spread over the view, colors and sizes varied so a mistake in the recorded draws shows
+	static std::vector<GameObject> createRecordBenchmarkObjects(uint32_t count, const std::shared_ptr<Model>& model) {
+		std::mt19937 random{ 42 };
+		std::uniform_real_distribution<float> position{ -1.f, 1.f };
+		std::uniform_real_distribution<float> scale{ .01f, .04f };
+		std::uniform_real_distribution<float> unit{ 0.f, 1.f };
+
+		std::vector<GameObject> objects{};
+		objects.reserve(count);
+		for (uint32_t i = 0; i < count; i++) {
+			auto obj = GameObject::createGameObject();
+			obj.model = model;
+			obj.transform2d.translation = { position(random), position(random) };
+			obj.transform2d.scale = glm::vec2{ scale(random) };
+			obj.transform2d.rotation = unit(random) * glm::two_pi<float>();
+			obj.color = { unit(random), unit(random), unit(random) };
+			objects.push_back(std::move(obj));
+		}
+		return objects;
+	}
+
+	static void syncField(const FieldStore& field, std::vector<GameObject>& vectorField) {
+		assert(field.size() == vectorField.size() && "Field store is out of sync with its game objects");
+		for (size_t i = 0; i < vectorField.size(); i++) {
+			vectorField[i].transform2d.scale.x = field.scale[i];
+			vectorField[i].transform2d.rotation = field.rotation[i];
+		}
+	}
+
+	FirstApp::FirstApp(const Options& options)
+		: window{ std::make_unique<Window>(WIDTH, HEIGHT, "Vulkan App") }, options{ options }, device{ *window }, renderer{ *window, device } {
+		loadGameObjects();
+	}
+
+	FirstApp::FirstApp(const HeadlessConfig& headlessConfig, const Options& options)
+		: headlessConfig{ headlessConfig }, options{ options }, device{}, renderer{ device, VkExtent2D{ WIDTH, HEIGHT } } {
 		loadGameObjects();
 	}
 
@@ -133,9 +133,10 @@ namespace vraus_VulkanEngine {
 		// create some models
 		std::shared_ptr<Model> squareModel = createSquareModel(
 			device,
+			uploadService,
 			{ .5f, .0f }
 		); // offset model by .5f so rotation occurs at edge rather than center of square
-		std::shared_ptr<Model> circleModel = createCircleModel(device, 64);
+		std::shared_ptr<Model> circleModel = createCircleModel(device, uploadService, 64);
 
 		// create physics objects
 		std::vector<GameObject> physicsObjects{};
@@ -174,33 +175,182 @@ namespace vraus_VulkanEngine {
 		}
 
 		GravityPhysicsSystem gravitySystem{ 0.81f };
+		gravitySystem.solver = GravitySolver::Pairwise; // Switch to GravitySolver::BarnesHut for large amounts of bodies
+		gravitySystem.setThreadCount(1); // Only worth raising once there are thousands of bodies
+		// A single 4th order substep (3 force evaluations) drifts far less in energy than 5 semi-implicit Euler substeps
+		gravitySystem.integrator = Integrator::Yoshida4;
 		Vec2FieldSystem vecFieldSystem{};
-		
 
-		SimpleRenderSystem simpleRenderSystem{ device, renderer.getSwapChainRenderPass() };
+		BodyStore bodies{};
+		FieldStore field{};
+		loadBodies(physicsObjects, bodies);
+		loadField(vectorField, field);
+
+		// Pipelines compile on the other cores while the first frames are drawn
+		PipelineManager pipelineManager{ device, std::max(2u, std::thread::hardware_concurrency()) - 1 };
+		PipelineStateCache pipelineStates{ pipelineManager };
+		// Saving a shader source recompiles it and swaps the graphics pipelines using it in, no restart needed.
+		// Compute shaders are recompiled too but only picked up on the next launch.
+		ShaderWatcher shaderWatcher{};
+		if (!isHeadless()) {
+			shaderWatcher.start();
+		}
+		SimpleRenderSystem simpleRenderSystem{ device, renderer.getSwapChainRenderPass(), renderer.getFrameRing(), pipelineStates };
+		// When the field is computed on the CPU (--cpu-field), its lines are culled and drawn with indirect draws.
+		// Lines are never added or removed, only their transforms are refreshed every frame.
+		CullComputeSystem cullSystem{ device };
+		cullSystem.setObjects(vectorField);
+		// By default the field is evaluated and drawn on the GPU, Vec2FieldSystem remains as the CPU reference
+		const bool computeFieldOnGpu = options.computeFieldOnGpu;
+		Vec2FieldComputeSystem vecFieldComputeSystem{ device, field, renderer.getSwapChainRenderPass(), pipelineStates };
+
+		// Bodies can also be simulated on the GPU, they then stay in its buffers and are drawn from there
+		const bool simulateOnGpu = false;
+		GravityComputeSystem gravityComputeSystem{ device, gravitySystem.strengthGravity, renderer.getSwapChainRenderPass(), pipelineStates };
+
+		// Objects drawn one by one can be recorded on every core through secondary command buffers (--parallel-record)
+		ParallelCommandRecorder commandRecorder{ device, std::max(1u, std::thread::hardware_concurrency()) - 1 };
+
+		// --record-benchmark: the recording of these objects is timed, on one thread on even frames and on
+		// every core on odd ones so both run under the same load. The objects stay on the push constant path.
+		std::vector<GameObject> recordObjects = createRecordBenchmarkObjects(options.recordBenchmarkObjectCount, gameObjects[0].model);
+		std::chrono::duration<double> recordTimes[2]{}; // [recorded in parallel]
+		uint32_t recordFrames[2]{};
+
+		// On the CPU, physics runs on its own thread at a fixed 60Hz whatever the frame rate,
+		// bodies then only holds the interpolated state being drawn
+		SimulationThread simulation{ gravitySystem, bodies, 1.f / 60, 1 };
+		if (!simulateOnGpu) {
+			simulation.start();
+		}
+		else {
+			std::vector<GravityComputeSystem::BodyAppearance> appearances{};
+			for (auto& obj : physicsObjects) {
+				appearances.push_back({ obj.color, obj.transform2d.scale.x });
+			}
+			gravityComputeSystem.upload(bodies);
+			gravityComputeSystem.uploadAppearance(appearances);
+		}
 
-		while (!window.shouldClose()) {
-			glfwPollEvents();
+		uint32_t frameCount = 0;
+		const auto startTime = std::chrono::steady_clock::now();
+		while (isHeadless() ? frameCount < headlessConfig.frameCount : !window->shouldClose()) {
+			if (!isHeadless()) {
+				glfwPollEvents();
+			}
 
 			if (auto commandBuffer = renderer.beginFrame()) { // beginFrame function returns null if the swapChain needs to be recreated
 				// update systems
-				gravitySystem.update(physicsObjects, 1.f / 60, 5);
-				vecFieldSystem.update(gravitySystem, physicsObjects, vectorField);
+				int frameIndex = renderer.getFrameIndex();
+				const bool recordInParallel = recordObjects.empty() ? options.recordInParallel : frameCount % 2 == 1;
+				for (const std::string& spirvFilepath : shaderWatcher.takeCompiled()) {
+					pipelineManager.reload(spirvFilepath);
+				}
+				pipelineManager.beginFrame();
+				uploadService.update(commandBuffer); // Models are drawn once their upload finished
+				if (simulateOnGpu) {
+					gravityComputeSystem.update(commandBuffer, 1.f / 60, 5); // The GPU step is semi-implicit Euler only
+					vecFieldComputeSystem.compute(
+						commandBuffer,
+						frameIndex,
+						gravityComputeSystem.strengthGravity,
+						gravityComputeSystem.positionInfo(),
+						gravityComputeSystem.getBodyCount());
+				}
+				else {
+					simulation.acquireLatest();
+					simulation.latest().interpolate(simulation.interpolationFactor(), bodies);
+					syncBodies(bodies, physicsObjects);
+					if (computeFieldOnGpu) {
+						vecFieldComputeSystem.compute(commandBuffer, frameIndex, gravitySystem, bodies);
+					}
+					else {
+						vecFieldSystem.update(gravitySystem, bodies, field);
+						syncField(field, vectorField);
+						simpleRenderSystem.animate(vectorField, 0, vectorField.size()); // As the direct draws do
+						cullSystem.updateTransforms(vectorField);
+						cullSystem.cull(commandBuffer, frameIndex);
+					}
+				}
 
 				// Example of usage and why we put every steps of drawing a frame appart:
 				// Begin offscreen shadow pass
 				// Render shadow casting objects
 				// End offscreen shadow pass
 				
-				renderer.beginSwapChainRenderPass(commandBuffer);
+				renderer.beginSwapChainRenderPass(
+					commandBuffer,
+					recordInParallel ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
+				// Inside a pass of secondary command buffers the primary can't draw, draws that aren't split get a secondary of their own
+				auto recordDraws = [&](const std::function<void(VkCommandBuffer)>& draws) {
+					if (recordInParallel) {
+						commandRecorder.recordSingle(draws);
+					}
+					else {
+						draws(commandBuffer);
+					}
+				};
+				if (recordInParallel) {
+					commandRecorder.beginFrame(frameIndex);
+					commandRecorder.beginRenderPass(
+						renderer.getSwapChainRenderPass(), renderer.getCurrentFrameBuffer(), renderer.getSwapChainExtent());
+				}
+
 				// simpleRenderSystem.renderGameObjects(commandBuffer, gameObjects);
-				simpleRenderSystem.renderGameObjects(commandBuffer, physicsObjects);
-				simpleRenderSystem.renderGameObjects(commandBuffer, vectorField);
+				if (simulateOnGpu) {
+					recordDraws([&](VkCommandBuffer drawCommandBuffer) { gravityComputeSystem.render(drawCommandBuffer, *circleModel); });
+				}
+				else if (recordInParallel) {
+					simpleRenderSystem.renderGameObjects(commandRecorder, frameIndex, physicsObjects);
+				}
+				else {
+					simpleRenderSystem.renderGameObjects(commandBuffer, frameIndex, physicsObjects);
+				}
+				if (!recordObjects.empty()) {
+					const auto recordStart = std::chrono::steady_clock::now();
+					if (recordInParallel) {
+						simpleRenderSystem.renderGameObjects(commandRecorder, frameIndex, recordObjects);
+					}
+					else {
+						simpleRenderSystem.renderGameObjects(commandBuffer, recordObjects);
+					}
+					recordTimes[recordInParallel] += std::chrono::steady_clock::now() - recordStart;
+					recordFrames[recordInParallel]++;
+				}
+				recordDraws([&](VkCommandBuffer drawCommandBuffer) {
+					if (computeFieldOnGpu || simulateOnGpu) {
+						vecFieldComputeSystem.render(drawCommandBuffer, frameIndex, *squareModel);
+					}
+					else {
+						simpleRenderSystem.renderIndirect(drawCommandBuffer, frameIndex, cullSystem);
+					}
+				});
+				if (recordInParallel) {
+					commandRecorder.execute(commandBuffer);
+				}
 				renderer.endSwapChainRenderPass(commandBuffer);
 				renderer.endFrame();
+				frameCount++;
 			}
 		}
+		simulation.stop();
 		vkDeviceWaitIdle(device.device()); // To block the CPU until all GPU operations are completed. We can then safely clean up all resources.
+
+		if (recordFrames[0] > 0 && recordFrames[1] > 0) {
+			const double singleMs = 1000. * recordTimes[0].count() / recordFrames[0];
+			const double parallelMs = 1000. * recordTimes[1].count() / recordFrames[1];
+			std::cout << "recording " << recordObjects.size() << " objects: " << singleMs << " ms per frame on 1 thread, " <<
+				parallelMs << " ms on " << commandRecorder.threadCount() << " threads (x" << singleMs / parallelMs << ")" << std::endl;
+		}
+
+		if (!isHeadless()) return;
+
+		const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+		std::cout << frameCount << " frames in " << elapsed.count() << "s (" << frameCount / elapsed.count() << " fps)" << std::endl;
+		if (!headlessConfig.screenshotPath.empty() && frameCount > 0) {
+			renderer.saveLastFrame(headlessConfig.screenshotPath);
+			std::cout << "last frame saved to " << headlessConfig.screenshotPath << std::endl;
+		}
 	}
 
 	void FirstApp::loadGameObjects()
@@ -5,8 +5,11 @@
 #include "model.hpp"
 #include "game_object.hpp"
 #include "renderer.hpp"
+#include "upload_service.hpp"
 
+#include <cstdint>
 #include <memory>
+#include <string>
 #include <vector>
 
 namespace vraus_VulkanEngine {
@@ -15,7 +18,27 @@ namespace vraus_VulkanEngine {
 		static constexpr int WIDTH = 800;
 		static constexpr int HEIGHT = 600;
 
-		FirstApp();
+		// Runs without a window, drawing frameCount frames offscreen as fast as possible (benchmarks, CI without a display)
+		struct HeadlessConfig {
+			uint32_t frameCount = 1000;
+			std::string screenshotPath{}; // Last frame written there as a PNG, none when empty
+		};
+
+		// Rendering paths, with or without a window
+		struct Options {
+			// The vector field is evaluated and drawn on the GPU. Otherwise Vec2FieldSystem evaluates it on the CPU,
+			// then its lines are culled on the GPU and drawn indirectly.
+			bool computeFieldOnGpu = true;
+			// Objects drawn one by one are recorded on every core through secondary command buffers,
+			// only worth it with many thousands of them
+			bool recordInParallel = false;
+			// Adds this many objects drawn one by one and times their recording, frames alternate between a single
+			// thread and every core whatever recordInParallel says. 0 disables it.
+			uint32_t recordBenchmarkObjectCount = 0;
+		};
+
+		FirstApp(const Options& options);
+		FirstApp(const HeadlessConfig& headlessConfig, const Options& options);
 		~FirstApp();
 
 		FirstApp(const FirstApp&) = delete;
@@ -25,9 +48,14 @@ namespace vraus_VulkanEngine {
 	private:
 		void loadGameObjects();
 
-		Window window{ WIDTH, HEIGHT, "Vulkan App" };
-		Device device{ window };
-		Renderer renderer{window, device};
+		bool isHeadless() const { return window == nullptr; }
+
+		std::unique_ptr<Window> window; // Null when headless
+		HeadlessConfig headlessConfig{};
+		Options options{};
+		Device device;
+		Renderer renderer;
+		UploadService uploadService{ device }; // Declared before anything owning models uploaded through it
 
 		std::vector<GameObject> gameObjects;
 	};
@@ -0,0 +1,95 @@
+#include "frame_ring_buffer.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace vraus_VulkanEngine {
+
+	// alignment must be a power of 2
+	static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	FrameRingBuffer::FrameRingBuffer(Device& device, VkDeviceSize capacity) : device{ device } {
+		grow(capacity);
+		growCount = 0;
+	}
+
+	void FrameRingBuffer::beginFrame(int frameIndex) {
+		assert(frameIndex >= 0 && frameIndex < SwapChain::MAX_FRAMES_IN_FLIGHT && "Frame index out of range");
+		currentFrameIndex = frameIndex;
+
+		// Frames finish in order, so the oldest live bytes are always this frame's
+		liveBytes -= frameBytes[frameIndex];
+		frameBytes[frameIndex] = 0;
+		retiredBuffers[frameIndex].clear();
+	}
+
+	FrameRingBuffer::Allocation FrameRingBuffer::allocate(VkDeviceSize size, VkDeviceSize alignment) {
+		assert(currentFrameIndex >= 0 && "Allocating from the frame ring buffer before the first frame began");
+		assert(alignment > 0 && (alignment & (alignment - 1)) == 0 && "Alignment must be a power of 2");
+
+		// The free space starts at head and runs forward, wrapping around, for capacity - liveBytes bytes.
+		// A range that doesn't fit before the end wastes the end and starts over at 0.
+		VkDeviceSize offset = alignUp(head, alignment);
+		VkDeviceSize consumed = offset + size - head;
+		if (offset + size > capacity) {
+			offset = 0;
+			consumed = capacity - head + size;
+		}
+		if (liveBytes + consumed > capacity) {
+			grow(std::max(capacity * 2, alignUp(size, alignment) * 2));
+			offset = 0;
+			consumed = size;
+		}
+
+		head = offset + size;
+		liveBytes += consumed;
+		frameBytes[currentFrameIndex] += consumed;
+
+		Allocation allocation{};
+		allocation.buffer = buffer->getBuffer();
+		allocation.offset = offset;
+		allocation.size = size;
+		allocation.mapped = static_cast<char*>(buffer->getMappedMemory()) + offset;
+		return allocation;
+	}
+
+	FrameRingBuffer::Allocation FrameRingBuffer::push(const void* data, VkDeviceSize size, VkDeviceSize alignment) {
+		Allocation allocation = allocate(size, alignment);
+		memcpy(allocation.mapped, data, static_cast<size_t>(size));
+		return allocation;
+	}
+
+	FrameRingBuffer::Allocation FrameRingBuffer::allocateUniform(VkDeviceSize size) {
+		return allocate(size, std::max(DEFAULT_ALIGNMENT, device.properties.limits.minUniformBufferOffsetAlignment));
+	}
+
+	FrameRingBuffer::Allocation FrameRingBuffer::allocateStorage(VkDeviceSize size) {
+		return allocate(size, std::max(DEFAULT_ALIGNMENT, device.properties.limits.minStorageBufferOffsetAlignment));
+	}
+
+	void FrameRingBuffer::grow(VkDeviceSize minimumCapacity) {
+		// Every frame in flight may still read the current buffer, it goes with the current frame which is the last to finish
+		if (buffer) {
+			retiredBuffers[currentFrameIndex].push_back(std::move(buffer));
+		}
+
+		capacity = alignUp(minimumCapacity, DEFAULT_ALIGNMENT);
+		buffer = std::make_unique<Buffer>(
+			device,
+			capacity,
+			1,
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT |
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		buffer->map(); // Stays mapped for its whole life
+
+		// Nothing in flight lives in the new buffer
+		head = 0;
+		liveBytes = 0;
+		std::fill(std::begin(frameBytes), std::end(frameBytes), VkDeviceSize{ 0 });
+		growCount++;
+	}
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "device.hpp"
+#include "buffer.hpp"
+#include "swapChain.hpp"
+
+#include <memory>
+#include <vector>
+
+namespace vraus_VulkanEngine {
+	/* Linear ring allocator for data written by the CPU every frame: instance data, uniforms, dynamic vertices.
+	One persistently mapped buffer is shared by every frame in flight. Each allocation takes the next aligned range
+	after the previous one, wrapping around at the end, and the ranges of a frame are all reclaimed at once when the
+	Renderer starts that frame index again, which is after SwapChain waited for the frame's fence.
+	No vkMapMemory or allocation happens per frame. When a frame needs more than what is free the buffer is replaced
+	by one twice as large, the old one is kept until the frames using it are done.
+	*/
+	class FrameRingBuffer {
+	public:
+		struct Allocation {
+			VkBuffer buffer = VK_NULL_HANDLE;
+			VkDeviceSize offset = 0;
+			VkDeviceSize size = 0;
+			void* mapped = nullptr;
+
+			VkDescriptorBufferInfo descriptorInfo() const { return { buffer, offset, size }; }
+		};
+
+		static constexpr VkDeviceSize DEFAULT_CAPACITY = 1024 * 1024;
+		static constexpr VkDeviceSize DEFAULT_ALIGNMENT = 16;
+
+		FrameRingBuffer(Device& device, VkDeviceSize capacity = DEFAULT_CAPACITY);
+
+		FrameRingBuffer(const FrameRingBuffer&) = delete;
+		FrameRingBuffer& operator=(const FrameRingBuffer&) = delete;
+
+		// Called by the Renderer once the frame's fence signaled, frees everything that frame index allocated last time
+		void beginFrame(int frameIndex);
+
+		// Valid until the same frame index begins again. alignment must be a power of 2.
+		Allocation allocate(VkDeviceSize size, VkDeviceSize alignment = DEFAULT_ALIGNMENT);
+		// Allocates and copies data in
+		Allocation push(const void* data, VkDeviceSize size, VkDeviceSize alignment = DEFAULT_ALIGNMENT);
+		// Aligned for dynamic uniform and storage buffer offsets
+		Allocation allocateUniform(VkDeviceSize size);
+		Allocation allocateStorage(VkDeviceSize size);
+
+		VkDeviceSize getCapacity() const { return capacity; }
+		// Bytes held by the frames in flight, padding included
+		VkDeviceSize getLiveBytes() const { return liveBytes; }
+		uint32_t getGrowCount() const { return growCount; }
+
+	private:
+		void grow(VkDeviceSize minimumCapacity);
+
+		Device& device;
+		std::unique_ptr<Buffer> buffer;
+		// Buffers replaced while frames were still reading them, released when their frame index comes back
+		std::vector<std::unique_ptr<Buffer>> retiredBuffers[SwapChain::MAX_FRAMES_IN_FLIGHT];
+
+		VkDeviceSize capacity = 0;
+		VkDeviceSize head = 0; // Where the next allocation starts looking
+		VkDeviceSize liveBytes = 0; // Bytes before head still used by frames in flight, wrapping around
+		VkDeviceSize frameBytes[SwapChain::MAX_FRAMES_IN_FLIGHT]{};
+		int currentFrameIndex = -1;
+		uint32_t growCount = 0;
+	};
+}
@@ -0,0 +1,343 @@
+#include "gravity_compute_system.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+
+namespace vraus_VulkanEngine {
+
+	struct GravityStepPushConstantData {
+		uint32_t bodyCount;
+		float dt;
+		float strength;
+		float softeningSquared;
+	};
+
+	GravityComputeSystem::GravityComputeSystem(Device& _device, float strength)
+		: strengthGravity{ strength }, device{ _device } {
+		createDescriptorSetLayouts();
+		createPipelineLayouts();
+		createPipelines();
+
+		descriptorPool = DescriptorPool::Builder(device)
+			.setMaxSets(4)
+			.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 10)
+			.build();
+	}
+
+	GravityComputeSystem::GravityComputeSystem(
+		Device& _device, float strength, VkRenderPass renderPass, PipelineStateCache& _pipelineStates)
+		: GravityComputeSystem{ _device, strength } {
+		pipelineStates = &_pipelineStates;
+		createRenderPipeline(renderPass);
+	}
+
+	GravityComputeSystem::~GravityComputeSystem() {
+		if (pipelineStates) {
+			pipelineStates->getPipelineManager().waitIdle(); // The render layout must outlive the compilation of our pipeline
+		}
+		vkDestroyPipelineLayout(device.device(), stepPipelineLayout, nullptr);
+		vkDestroyPipelineLayout(device.device(), renderPipelineLayout, nullptr);
+	}
+
+	void GravityComputeSystem::createDescriptorSetLayouts()
+	{
+		stepSetLayout = DescriptorSetLayout::Builder(device)
+			.addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // positions in
+			.addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // positions out
+			.addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // velocities
+			.build();
+
+		renderSetLayout = DescriptorSetLayout::Builder(device)
+			.addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT) // positions
+			.addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT) // appearances
+			.build();
+	}
+
+	void GravityComputeSystem::createPipelineLayouts()
+	{
+		VkPushConstantRange stepPushRange{};
+		stepPushRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		stepPushRange.offset = 0;
+		stepPushRange.size = sizeof(GravityStepPushConstantData);
+
+		VkDescriptorSetLayout stepLayouts[] = { stepSetLayout->getDescriptorSetLayout() };
+		VkPipelineLayoutCreateInfo stepLayoutInfo{};
+		stepLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		stepLayoutInfo.setLayoutCount = 1;
+		stepLayoutInfo.pSetLayouts = stepLayouts;
+		stepLayoutInfo.pushConstantRangeCount = 1;
+		stepLayoutInfo.pPushConstantRanges = &stepPushRange;
+
+		if (vkCreatePipelineLayout(device.device(), &stepLayoutInfo, nullptr, &stepPipelineLayout) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create compute pipeline layout");
+		}
+
+		VkDescriptorSetLayout renderLayouts[] = { renderSetLayout->getDescriptorSetLayout() };
+		VkPipelineLayoutCreateInfo renderLayoutInfo{};
+		renderLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		renderLayoutInfo.setLayoutCount = 1;
+		renderLayoutInfo.pSetLayouts = renderLayouts;
+		renderLayoutInfo.pushConstantRangeCount = 0;
+		renderLayoutInfo.pPushConstantRanges = nullptr;
+
+		if (vkCreatePipelineLayout(device.device(), &renderLayoutInfo, nullptr, &renderPipelineLayout) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create pipeline layout");
+		}
+	}
+
+	void GravityComputeSystem::createPipelines()
+	{
+		stepPipeline = std::make_unique<ComputePipeline>(device, "gravity_step.comp.spv", stepPipelineLayout);
+	}
+
+	void GravityComputeSystem::createRenderPipeline(VkRenderPass renderPass)
+	{
+		// Bodies are instances of a Model, the default vertex layout. Positions come from the storage buffers.
+		auto pipelineState = PipelineStateKey::create("bodies.vert.spv", "bodies.frag.spv");
+		renderPipeline = pipelineStates->request(pipelineState, renderPipelineLayout, renderPass);
+	}
+
+	void GravityComputeSystem::createBuffers(uint32_t count)
+	{
+		const VkBufferUsageFlags usage =
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		for (auto& positionBuffer : positionBuffers) {
+			positionBuffer = std::make_unique<Buffer>(
+				device, sizeof(glm::vec4), count, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		}
+		velocityBuffer = std::make_unique<Buffer>(
+			device, sizeof(glm::vec2), count, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		appearanceBuffer = std::make_unique<Buffer>(
+			device, sizeof(BodyAppearance), count, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	}
+
+	void GravityComputeSystem::createDescriptorSets()
+	{
+		descriptorPool->resetPool();
+
+		auto velocities = velocityBuffer->descriptorInfo();
+		auto appearances = appearanceBuffer->descriptorInfo();
+		for (int i = 0; i < 2; i++) {
+			auto positionsIn = positionBuffers[i]->descriptorInfo();
+			auto positionsOut = positionBuffers[1 - i]->descriptorInfo();
+			if (!DescriptorWriter(*stepSetLayout, *descriptorPool)
+				.writeBuffer(0, &positionsIn)
+				.writeBuffer(1, &positionsOut)
+				.writeBuffer(2, &velocities)
+				.build(stepSets[i])) {
+				throw std::runtime_error("Failed to allocate gravity descriptor set");
+			}
+
+			if (!DescriptorWriter(*renderSetLayout, *descriptorPool)
+				.writeBuffer(0, &positionsIn)
+				.writeBuffer(1, &appearances)
+				.build(renderSets[i])) {
+				throw std::runtime_error("Failed to allocate gravity descriptor set");
+			}
+		}
+	}
+
+	void GravityComputeSystem::copyToDevice(const void* data, VkDeviceSize size, Buffer& destination)
+	{
+		Buffer stagingBuffer{
+			device,
+			size,
+			1,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT };
+		stagingBuffer.map();
+		stagingBuffer.writeToBuffer(data);
+		device.copyBuffer(stagingBuffer.getBuffer(), destination.getBuffer(), size);
+	}
+
+	void GravityComputeSystem::copyToHost(Buffer& source, void* data, VkDeviceSize size)
+	{
+		Buffer stagingBuffer{
+			device,
+			size,
+			1,
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT };
+		// update() ends with a barrier making the shader writes visible to transfers
+		device.copyBuffer(source.getBuffer(), stagingBuffer.getBuffer(), size);
+		stagingBuffer.map();
+		memcpy(data, stagingBuffer.getMappedMemory(), static_cast<size_t>(size));
+	}
+
+	void GravityComputeSystem::upload(const BodyStore& bodies)
+	{
+		const uint32_t count = static_cast<uint32_t>(bodies.size());
+		if (count == 0) {
+			bodyCount = 0;
+			return;
+		}
+
+		if (count != bodyCount) {
+			createBuffers(count);
+			createDescriptorSets();
+			uploadAppearance(std::vector<BodyAppearance>(count));
+		}
+		bodyCount = count;
+		current = 0;
+
+		std::vector<glm::vec4> positions(count);
+		std::vector<glm::vec2> velocities(count);
+		for (uint32_t i = 0; i < count; i++) {
+			positions[i] = { bodies.x[i], bodies.y[i], bodies.mass[i], 0.f };
+			velocities[i] = bodies.velocity(i);
+		}
+		copyToDevice(positions.data(), sizeof(glm::vec4) * count, *positionBuffers[current]);
+		copyToDevice(velocities.data(), sizeof(glm::vec2) * count, *velocityBuffer);
+	}
+
+	void GravityComputeSystem::uploadAppearance(const std::vector<BodyAppearance>& appearances)
+	{
+		assert(appearanceBuffer && appearances.size() == appearanceBuffer->getInstanceCount() && "One appearance per uploaded body expected");
+		copyToDevice(appearances.data(), sizeof(BodyAppearance) * appearances.size(), *appearanceBuffer);
+	}
+
+	void GravityComputeSystem::download(BodyStore& bodies)
+	{
+		bodies.clear();
+		if (bodyCount == 0) return;
+
+		std::vector<glm::vec4> positions(bodyCount);
+		std::vector<glm::vec2> velocities(bodyCount);
+		copyToHost(*positionBuffers[current], positions.data(), sizeof(glm::vec4) * bodyCount);
+		copyToHost(*velocityBuffer, velocities.data(), sizeof(glm::vec2) * bodyCount);
+
+		bodies.reserve(bodyCount);
+		for (uint32_t i = 0; i < bodyCount; i++) {
+			bodies.add({ positions[i].x, positions[i].y }, velocities[i], positions[i].z);
+		}
+	}
+
+	void GravityComputeSystem::update(VkCommandBuffer commandBuffer, float dt, unsigned int substeps)
+	{
+		if (bodyCount == 0 || substeps == 0) return;
+
+		// Earlier reads of the bodies (previous frame's draw, field evaluation, downloads) must be done before they are
+		// overwritten, and uploads must be visible
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0,
+			1, &barrier,
+			0, nullptr,
+			0, nullptr);
+
+		GravityStepPushConstantData push{};
+		push.bodyCount = bodyCount;
+		push.dt = dt / substeps;
+		push.strength = strengthGravity;
+		push.softeningSquared = softening * softening;
+
+		stepPipeline->bind(commandBuffer);
+		vkCmdPushConstants(commandBuffer, stepPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(GravityStepPushConstantData), &push);
+		for (unsigned int i = 0; i < substeps; i++) {
+			if (i > 0) {
+				// The next substep reads the positions and velocities this one wrote
+				barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+				barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+				vkCmdPipelineBarrier(
+					commandBuffer,
+					VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+					VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+					0,
+					1, &barrier,
+					0, nullptr,
+					0, nullptr);
+			}
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, stepPipelineLayout, 0, 1, &stepSets[current], 0, nullptr);
+			vkCmdDispatch(commandBuffer, ComputePipeline::groupCount(bodyCount, LOCAL_SIZE), 1, 1);
+			current = 1 - current;
+		}
+
+		// Make the new state visible to the body draw, the field evaluation and downloads
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+		vkCmdPipelineBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+			0,
+			1, &barrier,
+			0, nullptr,
+			0, nullptr);
+	}
+
+	void GravityComputeSystem::render(VkCommandBuffer commandBuffer, Model& bodyModel)
+	{
+		assert(pipelineStates && "Gravity compute system was created without a render pass");
+		Pipeline* pipeline = pipelineStates->get(renderPipeline);
+		if (pipeline == nullptr || bodyCount == 0 || !bodyModel.isReady()) return; // Still compiling or uploading
+
+		pipeline->bind(commandBuffer);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, renderPipelineLayout, 0, 1, &renderSets[current], 0, nullptr);
+		bodyModel.bind(commandBuffer);
+		bodyModel.draw(commandBuffer, bodyCount);
+	}
+
+	GravityComputeSystem::ParityReport GravityComputeSystem::compareWithCpu(
+		GravityPhysicsSystem& cpuSystem,
+		const BodyStore& initial,
+		unsigned int steps,
+		float dt,
+		unsigned int substeps
+	) {
+		ParityReport report{};
+		report.steps = steps;
+		if (initial.size() == 0) return report;
+
+		const float previousSoftening = softening;
+		softening = cpuSystem.getSoftening();
+
+		// Every GPU step goes into a single submission
+		upload(initial);
+		VkCommandBuffer commandBuffer = device.beginSingleTimeCommands();
+		for (unsigned int i = 0; i < steps; i++) {
+			update(commandBuffer, dt, substeps);
+		}
+		device.endSingleTimeCommands(commandBuffer);
+		softening = previousSoftening;
+
+		// The GPU only integrates with semi-implicit Euler at a fixed substep count
+		const Integrator previousIntegrator = cpuSystem.integrator;
+		const bool previousAdaptive = cpuSystem.adaptiveSubsteps;
+		cpuSystem.integrator = Integrator::SemiImplicitEuler;
+		cpuSystem.adaptiveSubsteps = false;
+		BodyStore cpuBodies = initial;
+		for (unsigned int i = 0; i < steps; i++) {
+			cpuSystem.update(cpuBodies, dt, substeps);
+		}
+		cpuSystem.integrator = previousIntegrator;
+		cpuSystem.adaptiveSubsteps = previousAdaptive;
+
+		BodyStore gpuBodies{};
+		download(gpuBodies);
+
+		double sumPositionError = 0.0;
+		for (size_t i = 0; i < cpuBodies.size(); i++) {
+			float positionError = glm::length(gpuBodies.position(i) - cpuBodies.position(i));
+			float velocityError = glm::length(gpuBodies.velocity(i) - cpuBodies.velocity(i));
+			report.maxPositionError = std::max(report.maxPositionError, positionError);
+			report.maxVelocityError = std::max(report.maxVelocityError, velocityError);
+			sumPositionError += positionError;
+		}
+		report.meanPositionError = static_cast<float>(sumPositionError / cpuBodies.size());
+		return report;
+	}
+
+	VkDescriptorBufferInfo GravityComputeSystem::positionInfo() const
+	{
+		assert(bodyCount > 0 && "No bodies were uploaded");
+		return positionBuffers[current]->descriptorInfo();
+	}
+}
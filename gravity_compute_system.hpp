@@ -0,0 +1,110 @@
+#pragma once
+
+#include "device.hpp"
+#include "buffer.hpp"
+#include "descriptors.hpp"
+#include "compute_pipeline.hpp"
+#include "pipeline.hpp"
+#include "pipeline_state_cache.hpp"
+#include "model.hpp"
+#include "body_store.hpp"
+#include "gravity_physics_system.hpp"
+
+#include <memory>
+#include <vector>
+
+namespace vraus_VulkanEngine {
+	/* GPU version of the pairwise GravityPhysicsSystem. Bodies are uploaded once and then stay in storage buffers:
+	every substep is one dispatch of gravity_step.comp, all recorded into the frame's command buffer, and the bodies
+	are drawn straight from the position buffer. Vec2FieldComputeSystem can read the same buffer through positionInfo().
+	There is a single simulation state, so consecutive frames are serialized by barriers instead of duplicating it.
+	*/
+	class GravityComputeSystem {
+	public:
+		static constexpr uint32_t LOCAL_SIZE = 64; // Must match gravity_step.comp
+
+		// Per body rendering data, bodies are drawn as bodyModel scaled by scale
+		struct BodyAppearance {
+			glm::vec3 color{ 1.f };
+			float scale = .05f;
+		};
+
+		// How far the GPU state drifted from the CPU one after the same steps
+		struct ParityReport {
+			unsigned int steps = 0;
+			float maxPositionError = 0.f;
+			float maxVelocityError = 0.f;
+			float meanPositionError = 0.f;
+		};
+
+		// Compute side only, works without a swap chain
+		GravityComputeSystem(Device& device, float strength);
+		// Also draws the bodies, the render pipeline compiles in the background through pipelineStates
+		GravityComputeSystem(Device& device, float strength, VkRenderPass renderPass, PipelineStateCache& pipelineStates);
+		~GravityComputeSystem();
+
+		GravityComputeSystem(const GravityComputeSystem&) = delete;
+		GravityComputeSystem& operator=(const GravityComputeSystem&) = delete;
+
+		const float strengthGravity;
+		float softening = 1e-5f;
+
+		// Replaces the GPU state. Blocks until the copy is done, must not be called while a frame using the bodies is in flight.
+		void upload(const BodyStore& bodies);
+		void uploadAppearance(const std::vector<BodyAppearance>& appearances);
+		// Copies the GPU state back, blocking
+		void download(BodyStore& bodies);
+
+		// Records the same step as GravityPhysicsSystem::update(bodies, dt, substeps) with Integrator::SemiImplicitEuler.
+		// Must be recorded outside of a render pass.
+		void update(VkCommandBuffer commandBuffer, float dt, unsigned int substeps = 1);
+
+		// Draws nothing until the render pipeline is compiled
+		void render(VkCommandBuffer commandBuffer, Model& bodyModel);
+
+		// Runs steps updates on both the CPU system and the GPU from the same initial state, then compares them.
+		// cpuSystem should use the pairwise solver with a softened kernel, its softening is used on both sides.
+		// It is run with semi-implicit Euler and fixed substeps whatever its settings.
+		// Replaces the GPU state.
+		ParityReport compareWithCpu(
+			GravityPhysicsSystem& cpuSystem,
+			const BodyStore& initial,
+			unsigned int steps,
+			float dt,
+			unsigned int substeps = 1
+		);
+
+		// Positions of the last update, vec4(x, y, mass, unused) per body
+		VkDescriptorBufferInfo positionInfo() const;
+		uint32_t getBodyCount() const { return bodyCount; }
+
+	private:
+		void createDescriptorSetLayouts();
+		void createPipelineLayouts();
+		void createPipelines();
+		void createRenderPipeline(VkRenderPass renderPass);
+		void createBuffers(uint32_t count);
+		void createDescriptorSets();
+		void copyToDevice(const void* data, VkDeviceSize size, Buffer& destination);
+		void copyToHost(Buffer& source, void* data, VkDeviceSize size);
+
+		Device& device;
+		PipelineStateCache* pipelineStates = nullptr; // Null when compute only
+		uint32_t bodyCount = 0;
+		int current = 0; // Which of the two position buffers holds the latest positions
+
+		std::unique_ptr<DescriptorPool> descriptorPool;
+		std::unique_ptr<DescriptorSetLayout> stepSetLayout;
+		std::unique_ptr<DescriptorSetLayout> renderSetLayout;
+		VkPipelineLayout stepPipelineLayout = VK_NULL_HANDLE;
+		VkPipelineLayout renderPipelineLayout = VK_NULL_HANDLE;
+		std::unique_ptr<ComputePipeline> stepPipeline;
+		PipelineManager::Handle renderPipeline = PipelineManager::INVALID_HANDLE;
+
+		std::unique_ptr<Buffer> positionBuffers[2];
+		std::unique_ptr<Buffer> velocityBuffer;
+		std::unique_ptr<Buffer> appearanceBuffer;
+		VkDescriptorSet stepSets[2]{}; // stepSets[i] reads positionBuffers[i] and writes the other one
+		VkDescriptorSet renderSets[2]{}; // renderSets[i] draws positionBuffers[i]
+	};
+}
@@ -0,0 +1,234 @@
+#include "gravity_kernels.hpp"
+
+#include <cassert>
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define VRAUS_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// MSVC lets any function use AVX2 intrinsics, GCC and Clang need the target enabled per function
+#if defined(VRAUS_X86) && !defined(_MSC_VER)
+#define VRAUS_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#else
+#define VRAUS_TARGET_AVX2
+#endif
+
+namespace vraus_VulkanEngine {
+
+	static bool cpuSupportsAvx2() {
+#if defined(VRAUS_X86) && defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 1);
+		const bool fma = (info[2] & (1 << 12)) != 0;
+		const bool osxsave = (info[2] & (1 << 27)) != 0;
+		const bool avx = (info[2] & (1 << 28)) != 0;
+		if (!fma || !osxsave || !avx) return false;
+		// The OS must also save the YMM registers on context switches
+		if ((_xgetbv(0) & 0x6) != 0x6) return false;
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#elif defined(VRAUS_X86)
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#else
+		return false;
+#endif
+	}
+
+	bool isForceKernelSupported(ForceKernel kernel) {
+		switch (kernel) {
+		case ForceKernel::Auto:
+		case ForceKernel::Reference:
+		case ForceKernel::Scalar:
+			return true;
+		case ForceKernel::SSE:
+#ifdef VRAUS_X86
+			return true;
+#else
+			return false;
+#endif
+		case ForceKernel::AVX2: {
+			static const bool supported = cpuSupportsAvx2();
+			return supported;
+		}
+		}
+		return false;
+	}
+
+	ForceKernel resolveForceKernel(ForceKernel kernel) {
+		if (kernel == ForceKernel::Auto) {
+			if (isForceKernelSupported(ForceKernel::AVX2)) return ForceKernel::AVX2;
+			if (isForceKernelSupported(ForceKernel::SSE)) return ForceKernel::SSE;
+			return ForceKernel::Scalar;
+		}
+		return isForceKernelSupported(kernel) ? kernel : ForceKernel::Scalar;
+	}
+
+	const char* forceKernelName(ForceKernel kernel) {
+		switch (kernel) {
+		case ForceKernel::Auto: return "auto";
+		case ForceKernel::Reference: return "reference";
+		case ForceKernel::Scalar: return "scalar";
+		case ForceKernel::SSE: return "sse";
+		case ForceKernel::AVX2: return "avx2";
+		}
+		return "unknown";
+	}
+
+	static void computeAccelerationsScalar(
+		const float* x, const float* y, const float* mass, size_t count, size_t begin, size_t end,
+		float strength, float softeningSquared, float* ax, float* ay)
+	{
+		for (size_t i = begin; i < end; i++) {
+			const float xi = x[i];
+			const float yi = y[i];
+			float sumX = 0.f;
+			float sumY = 0.f;
+			for (size_t j = 0; j < count; j++) {
+				float dx = x[j] - xi;
+				float dy = y[j] - yi;
+				float inverseDistance = 1.f / std::sqrt(dx * dx + dy * dy + softeningSquared);
+				float s = mass[j] * inverseDistance * inverseDistance * inverseDistance;
+				sumX += s * dx;
+				sumY += s * dy;
+			}
+			ax[i] = strength * sumX;
+			ay[i] = strength * sumY;
+		}
+	}
+
+#ifdef VRAUS_X86
+	static void computeAccelerationsSSE(
+		const float* x, const float* y, const float* mass, size_t count, size_t begin, size_t end,
+		float strength, float softeningSquared, float* ax, float* ay)
+	{
+		const __m128 softening = _mm_set1_ps(softeningSquared);
+		const __m128 half = _mm_set1_ps(.5f);
+		const __m128 threeHalves = _mm_set1_ps(1.5f);
+		const size_t vectorCount = count & ~size_t(3);
+
+		for (size_t i = begin; i < end; i++) {
+			const __m128 xi = _mm_set1_ps(x[i]);
+			const __m128 yi = _mm_set1_ps(y[i]);
+			__m128 sumX = _mm_setzero_ps();
+			__m128 sumY = _mm_setzero_ps();
+
+			for (size_t j = 0; j < vectorCount; j += 4) {
+				__m128 dx = _mm_sub_ps(_mm_loadu_ps(x + j), xi);
+				__m128 dy = _mm_sub_ps(_mm_loadu_ps(y + j), yi);
+				__m128 r2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), softening);
+
+				// rsqrt is only ~12 bits accurate, one Newton-Raphson step brings it close to full float precision
+				__m128 inv = _mm_rsqrt_ps(r2);
+				inv = _mm_mul_ps(inv, _mm_sub_ps(threeHalves, _mm_mul_ps(_mm_mul_ps(half, r2), _mm_mul_ps(inv, inv))));
+
+				__m128 s = _mm_mul_ps(_mm_loadu_ps(mass + j), _mm_mul_ps(inv, _mm_mul_ps(inv, inv)));
+				sumX = _mm_add_ps(sumX, _mm_mul_ps(s, dx));
+				sumY = _mm_add_ps(sumY, _mm_mul_ps(s, dy));
+			}
+
+			// Horizontal sums in a fixed order so the result doesn't depend on anything but the input
+			alignas(16) float laneX[4];
+			alignas(16) float laneY[4];
+			_mm_store_ps(laneX, sumX);
+			_mm_store_ps(laneY, sumY);
+			float totalX = (laneX[0] + laneX[1]) + (laneX[2] + laneX[3]);
+			float totalY = (laneY[0] + laneY[1]) + (laneY[2] + laneY[3]);
+
+			for (size_t j = vectorCount; j < count; j++) {
+				float dx = x[j] - x[i];
+				float dy = y[j] - y[i];
+				float inverseDistance = 1.f / std::sqrt(dx * dx + dy * dy + softeningSquared);
+				float s = mass[j] * inverseDistance * inverseDistance * inverseDistance;
+				totalX += s * dx;
+				totalY += s * dy;
+			}
+			ax[i] = strength * totalX;
+			ay[i] = strength * totalY;
+		}
+	}
+
+	VRAUS_TARGET_AVX2
+	static void computeAccelerationsAVX2(
+		const float* x, const float* y, const float* mass, size_t count, size_t begin, size_t end,
+		float strength, float softeningSquared, float* ax, float* ay)
+	{
+		const __m256 softening = _mm256_set1_ps(softeningSquared);
+		const __m256 half = _mm256_set1_ps(.5f);
+		const __m256 threeHalves = _mm256_set1_ps(1.5f);
+		const size_t vectorCount = count & ~size_t(7);
+
+		for (size_t i = begin; i < end; i++) {
+			const __m256 xi = _mm256_set1_ps(x[i]);
+			const __m256 yi = _mm256_set1_ps(y[i]);
+			__m256 sumX = _mm256_setzero_ps();
+			__m256 sumY = _mm256_setzero_ps();
+
+			for (size_t j = 0; j < vectorCount; j += 8) {
+				__m256 dx = _mm256_sub_ps(_mm256_loadu_ps(x + j), xi);
+				__m256 dy = _mm256_sub_ps(_mm256_loadu_ps(y + j), yi);
+				__m256 r2 = _mm256_fmadd_ps(dx, dx, _mm256_fmadd_ps(dy, dy, softening));
+
+				__m256 inv = _mm256_rsqrt_ps(r2);
+				inv = _mm256_mul_ps(inv, _mm256_fnmadd_ps(_mm256_mul_ps(half, r2), _mm256_mul_ps(inv, inv), threeHalves));
+
+				__m256 s = _mm256_mul_ps(_mm256_loadu_ps(mass + j), _mm256_mul_ps(inv, _mm256_mul_ps(inv, inv)));
+				sumX = _mm256_fmadd_ps(s, dx, sumX);
+				sumY = _mm256_fmadd_ps(s, dy, sumY);
+			}
+
+			alignas(32) float laneX[8];
+			alignas(32) float laneY[8];
+			_mm256_store_ps(laneX, sumX);
+			_mm256_store_ps(laneY, sumY);
+			float totalX = ((laneX[0] + laneX[1]) + (laneX[2] + laneX[3])) + ((laneX[4] + laneX[5]) + (laneX[6] + laneX[7]));
+			float totalY = ((laneY[0] + laneY[1]) + (laneY[2] + laneY[3])) + ((laneY[4] + laneY[5]) + (laneY[6] + laneY[7]));
+
+			for (size_t j = vectorCount; j < count; j++) {
+				float dx = x[j] - x[i];
+				float dy = y[j] - y[i];
+				float inverseDistance = 1.f / std::sqrt(dx * dx + dy * dy + softeningSquared);
+				float s = mass[j] * inverseDistance * inverseDistance * inverseDistance;
+				totalX += s * dx;
+				totalY += s * dy;
+			}
+			ax[i] = strength * totalX;
+			ay[i] = strength * totalY;
+		}
+	}
+#endif
+
+	void computeAccelerations(
+		ForceKernel kernel,
+		const float* x,
+		const float* y,
+		const float* mass,
+		size_t count,
+		size_t begin,
+		size_t end,
+		float strength,
+		float softeningSquared,
+		float* ax,
+		float* ay)
+	{
+		assert(kernel != ForceKernel::Reference && "The reference kernel does not compute accelerations");
+		switch (resolveForceKernel(kernel)) {
+#ifdef VRAUS_X86
+		case ForceKernel::AVX2:
+			computeAccelerationsAVX2(x, y, mass, count, begin, end, strength, softeningSquared, ax, ay);
+			return;
+		case ForceKernel::SSE:
+			computeAccelerationsSSE(x, y, mass, count, begin, end, strength, softeningSquared, ax, ay);
+			return;
+#endif
+		default:
+			computeAccelerationsScalar(x, y, mass, count, begin, end, strength, softeningSquared, ax, ay);
+			return;
+		}
+	}
+}
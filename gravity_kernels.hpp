@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+
+namespace vraus_VulkanEngine {
+
+	// Implementations of the all pairs force loop, selectable at runtime.
+	enum class ForceKernel {
+		Auto,		// Fastest kernel supported by the running CPU
+		Reference,	// Original symmetric loop, visits each pair once but branches on close bodies
+		Scalar,		// Branch-free softened kernel, used as fallback on non x86 CPUs
+		SSE,		// 4 partner bodies per iteration
+		AVX2,		// 8 partner bodies per iteration
+	};
+
+	bool isForceKernelSupported(ForceKernel kernel);
+
+	// Resolves Auto to the best supported kernel, and unsupported kernels to Scalar
+	ForceKernel resolveForceKernel(ForceKernel kernel);
+
+	const char* forceKernelName(ForceKernel kernel);
+
+	/* Computes the gravitational acceleration of bodies [begin, end) due to all `count` bodies and writes it in ax / ay.
+	The distance uses a softening term: a = G * m * d / (|d|^2 + softening^2)^(3/2). A body facing itself gets d = 0 so it
+	contributes nothing, which removes the branch of the reference kernel.
+	Reference is not accepted here since it updates velocities directly.
+	*/
+	void computeAccelerations(
+		ForceKernel kernel,
+		const float* x,
+		const float* y,
+		const float* mass,
+		size_t count,
+		size_t begin,
+		size_t end,
+		float strength,
+		float softeningSquared,
+		float* ax,
+		float* ay);
+}
@@ -0,0 +1,393 @@
+#include "gravity_physics_system.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace vraus_VulkanEngine {
+
+	namespace {
+		// Forest-Ruth / Yoshida 4th order weights, built from three leapfrog steps of w1, w0, w1
+		const double CUBE_ROOT_2 = std::cbrt(2.0);
+		const float YOSHIDA_W1 = static_cast<float>(1.0 / (2.0 - CUBE_ROOT_2));
+		const float YOSHIDA_W0 = static_cast<float>(-CUBE_ROOT_2 / (2.0 - CUBE_ROOT_2));
+	}
+
+	void GravityPhysicsSystem::update(BodyStore& bodies, float dt, unsigned int substeps) {
+		lastForceEvaluations = 0;
+		if (adaptiveSubsteps) {
+			substeps = chooseSubsteps(bodies, dt);
+		}
+		substeps = std::max(substeps, 1u);
+		lastSubsteps = substeps;
+
+		if (driftTracking && (!hasDriftReference || bodies.size() != driftBodyCount)) {
+			driftReference = measureConservedQuantities(bodies);
+			driftBodyCount = bodies.size();
+			hasDriftReference = true;
+		}
+
+		const float stepDelta = dt / substeps;
+		for (unsigned int i = 0; i < substeps; i++) {
+			step(bodies, stepDelta);
+		}
+
+		if (driftTracking) {
+			driftReport = compareConservedQuantities(driftReference, measureConservedQuantities(bodies));
+		}
+	}
+
+	void GravityPhysicsSystem::setDriftTracking(bool enabled) {
+		driftTracking = enabled;
+		hasDriftReference = false;
+		driftReport = {};
+	}
+
+	void GravityPhysicsSystem::step(BodyStore& bodies, float dt) {
+		switch (integrator) {
+		case Integrator::SemiImplicitEuler:
+			evaluateAccelerations(bodies);
+			kick(bodies, dt);
+			drift(bodies, dt);
+			break;
+		case Integrator::Leapfrog:
+			drift(bodies, .5f * dt);
+			evaluateAccelerations(bodies);
+			kick(bodies, dt);
+			drift(bodies, .5f * dt);
+			break;
+		case Integrator::Yoshida4:
+			// Consecutive half drifts of the three leapfrog steps are merged, so this is still 3 evaluations
+			drift(bodies, .5f * YOSHIDA_W1 * dt);
+			evaluateAccelerations(bodies);
+			kick(bodies, YOSHIDA_W1 * dt);
+			drift(bodies, .5f * (YOSHIDA_W0 + YOSHIDA_W1) * dt);
+			evaluateAccelerations(bodies);
+			kick(bodies, YOSHIDA_W0 * dt);
+			drift(bodies, .5f * (YOSHIDA_W0 + YOSHIDA_W1) * dt);
+			evaluateAccelerations(bodies);
+			kick(bodies, YOSHIDA_W1 * dt);
+			drift(bodies, .5f * YOSHIDA_W1 * dt);
+			break;
+		}
+	}
+
+	void GravityPhysicsSystem::drift(BodyStore& bodies, float dt) const {
+		const size_t count = bodies.size();
+		for (size_t i = 0; i < count; i++) {
+			bodies.x[i] += dt * bodies.vx[i];
+			bodies.y[i] += dt * bodies.vy[i];
+		}
+	}
+
+	void GravityPhysicsSystem::kick(BodyStore& bodies, float dt) const {
+		const size_t count = bodies.size();
+		for (size_t i = 0; i < count; i++) {
+			bodies.vx[i] += dt * accelerationX[i];
+			bodies.vy[i] += dt * accelerationY[i];
+		}
+	}
+
+	unsigned int GravityPhysicsSystem::chooseSubsteps(const BodyStore& bodies, float dt) {
+		// The accelerations of the last evaluation are close enough to the current ones to pick a step size,
+		// only evaluate when there are none yet or the body count changed
+		if (!accelerationsValid || accelerationX.size() != bodies.size()) {
+			evaluateAccelerations(bodies);
+		}
+
+		float maxAccelerationSquared = 0.f;
+		for (size_t i = 0; i < accelerationX.size(); i++) {
+			maxAccelerationSquared = std::max(maxAccelerationSquared, accelerationX[i] * accelerationX[i] + accelerationY[i] * accelerationY[i]);
+		}
+		if (maxAccelerationSquared <= 0.f) return minSubsteps;
+
+		// a ~ GM / r^2 near a close approach, so h ~ sqrt(r / a) is a fraction of the local free fall time
+		float stepSize = timestepAccuracy * std::sqrt(adaptiveLengthScale / std::sqrt(maxAccelerationSquared));
+		float substeps = std::ceil(std::abs(dt) / stepSize);
+		return static_cast<unsigned int>(std::clamp(substeps, static_cast<float>(minSubsteps), static_cast<float>(maxSubsteps)));
+	}
+
+	bool GravityPhysicsSystem::usesSoftening() const {
+		return solver == GravitySolver::Pairwise && resolveForceKernel(forceKernel) != ForceKernel::Reference;
+	}
+
+	void GravityPhysicsSystem::setThreadCount(unsigned int threads) {
+		if (threads <= 1) {
+			threadPool.reset();
+		}
+		else if (getThreadCount() != threads) {
+			threadPool = std::make_unique<ThreadPool>(threads - 1);
+		}
+	}
+
+	void GravityPhysicsSystem::setSoftening(float length) {
+		if (!(length > 0.f)) { // Also rejects NaN
+			throw std::runtime_error("gravity softening must be greater than 0");
+		}
+		softening = length;
+	}
+
+	glm::vec2 GravityPhysicsSystem::computeForce(glm::vec2 fromPosition, float fromMass, glm::vec2 toPosition, float toMass) const {
+		auto offset = fromPosition - toPosition;
+		float distanceSquared = glm::dot(offset, offset);
+
+		// Just to ensure a 0 return if objects are to close to each other.
+		if (glm::abs(distanceSquared) < 1e-10f)
+			return { .0f,.0f };
+
+		float force = strengthGravity * toMass * fromMass / distanceSquared;
+		return force * offset / glm::sqrt(distanceSquared);
+	}
+
+	GravityPhysicsSystem::ForceErrorReport GravityPhysicsSystem::compareWithExact(
+		const BodyStore& bodies, size_t maxSamples) const
+	{
+		ForceErrorReport report{};
+		if (bodies.size() == 0 || maxSamples == 0) return report;
+
+		QuadTree tree;
+		tree.build(bodies.x.data(), bodies.y.data(), bodies.mass.data(), bodies.size());
+
+		const size_t stride = std::max<size_t>(1, bodies.size() / maxSamples);
+		double sumError = 0.0;
+		double sumSquaredError = 0.0;
+		for (size_t i = 0; i < bodies.size(); i += stride) {
+			glm::vec2 exact{};
+			for (size_t j = 0; j < bodies.size(); j++) {
+				if (i == j) continue;
+				exact += computeForce(bodies.position(j), bodies.mass[j], bodies.position(i), 1.f);
+			}
+			glm::vec2 approx = tree.computeAcceleration(bodies.position(i), strengthGravity, openingAngle);
+
+			float exactLength = glm::length(exact);
+			if (exactLength <= 0.f) continue; // Relative error is meaningless for a body with no net force
+
+			float error = glm::length(approx - exact) / exactLength;
+			report.maxRelativeError = std::max(report.maxRelativeError, error);
+			sumError += error;
+			sumSquaredError += static_cast<double>(error) * error;
+			report.sampledBodies++;
+		}
+
+		if (report.sampledBodies > 0) {
+			report.meanRelativeError = static_cast<float>(sumError / report.sampledBodies);
+			report.rmsRelativeError = static_cast<float>(std::sqrt(sumSquaredError / report.sampledBodies));
+		}
+		return report;
+	}
+
+	GravityPhysicsSystem::ConservedQuantities GravityPhysicsSystem::measureConservedQuantities(const BodyStore& bodies) const {
+		ConservedQuantities quantities{};
+		const size_t count = bodies.size();
+		const bool softened = usesSoftening();
+		const double softeningSquared = static_cast<double>(softening) * softening;
+
+		for (size_t a = 0; a < count; a++) {
+			const double massA = bodies.mass[a];
+			const double vx = bodies.vx[a];
+			const double vy = bodies.vy[a];
+			quantities.kineticEnergy += .5 * massA * (vx * vx + vy * vy);
+			quantities.momentumX += massA * vx;
+			quantities.momentumY += massA * vy;
+			quantities.angularMomentum += massA * (bodies.x[a] * vy - bodies.y[a] * vx);
+			quantities.momentumScale += massA * std::sqrt(vx * vx + vy * vy);
+
+			for (size_t b = a + 1; b < count; b++) {
+				double dx = static_cast<double>(bodies.x[b]) - bodies.x[a];
+				double dy = static_cast<double>(bodies.y[b]) - bodies.y[a];
+				double distanceSquared = dx * dx + dy * dy;
+				if (softened) {
+					distanceSquared += softeningSquared;
+				}
+				else if (distanceSquared < 1e-10) {
+					continue; // Pairs this close exert no force, so they hold no potential either
+				}
+				quantities.potentialEnergy -= strengthGravity * massA * bodies.mass[b] / std::sqrt(distanceSquared);
+			}
+		}
+		return quantities;
+	}
+
+	GravityPhysicsSystem::DriftReport GravityPhysicsSystem::compareConservedQuantities(
+		const ConservedQuantities& initial, const ConservedQuantities& current)
+	{
+		DriftReport report{};
+		const double initialEnergy = initial.totalEnergy();
+		const double energyChange = std::abs(current.totalEnergy() - initialEnergy);
+		report.relativeEnergyDrift = initialEnergy != 0.0 ? energyChange / std::abs(initialEnergy) : energyChange;
+
+		const double momentumChange = std::hypot(current.momentumX - initial.momentumX, current.momentumY - initial.momentumY);
+		report.relativeMomentumDrift = initial.momentumScale > 0.0 ? momentumChange / initial.momentumScale : momentumChange;
+
+		const double angularMomentumChange = std::abs(current.angularMomentum - initial.angularMomentum);
+		report.angularMomentumDrift = initial.angularMomentum != 0.0
+			? angularMomentumChange / std::abs(initial.angularMomentum)
+			: angularMomentumChange;
+		return report;
+	}
+
+	void GravityPhysicsSystem::evaluateAccelerations(const BodyStore& bodies) {
+		lastForceEvaluations++;
+		accelerationsValid = true;
+
+		const size_t count = bodies.size();
+		accelerationX.resize(count);
+		accelerationY.resize(count);
+
+		if (solver == GravitySolver::BarnesHut) {
+			evaluateAccelerationsBarnesHut(bodies);
+			return;
+		}
+
+		const ForceKernel kernel = resolveForceKernel(forceKernel);
+		if (kernel == ForceKernel::Reference) {
+			if (threadPool) {
+				evaluateAccelerationsReferenceParallel(bodies);
+			}
+			else {
+				evaluateAccelerationsReference(bodies);
+			}
+			return;
+		}
+
+		// The vectorized kernels evaluate every pair twice (once per body) but never write to the partner body,
+		// which is what lets them process several partners at once. It also means threads can split the bodies
+		// between them without sharing any accumulator, each acceleration is summed in the same order whatever the thread count.
+		auto accumulate = [&](size_t begin, size_t end, unsigned int) {
+			computeAccelerations(
+				kernel,
+				bodies.x.data(),
+				bodies.y.data(),
+				bodies.mass.data(),
+				count,
+				begin,
+				end,
+				strengthGravity,
+				softening * softening,
+				accelerationX.data(),
+				accelerationY.data());
+		};
+		if (threadPool) {
+			threadPool->parallelFor(count, accumulate);
+		}
+		else {
+			accumulate(0, count, 0);
+		}
+	}
+
+	void GravityPhysicsSystem::evaluateAccelerationsReference(const BodyStore& bodies) {
+		const size_t count = bodies.size();
+		const float* x = bodies.x.data();
+		const float* y = bodies.y.data();
+		const float* mass = bodies.mass.data();
+		float* ax = accelerationX.data();
+		float* ay = accelerationY.data();
+		std::fill(accelerationX.begin(), accelerationX.end(), 0.f);
+		std::fill(accelerationY.begin(), accelerationY.end(), 0.f);
+
+		// Loops through all pairs of bodies and applies attractive force between them, each pair is only visited once
+		for (size_t a = 0; a < count; a++) {
+			const float xa = x[a];
+			const float ya = y[a];
+			float axA = 0.f;
+			float ayA = 0.f;
+
+			for (size_t b = a + 1; b < count; b++) {
+				float dx = x[b] - xa;
+				float dy = y[b] - ya;
+				float distanceSquared = dx * dx + dy * dy;
+				if (distanceSquared < 1e-10f) continue; // Same rule as computeForce
+
+				// G / r^3, the direction still has to be multiplied in
+				float inverseDistance = 1.f / std::sqrt(distanceSquared);
+				float scale = strengthGravity * inverseDistance * inverseDistance * inverseDistance;
+
+				axA += scale * mass[b] * dx;
+				ayA += scale * mass[b] * dy;
+				ax[b] -= scale * mass[a] * dx;
+				ay[b] -= scale * mass[a] * dy;
+			}
+			ax[a] += axA;
+			ay[a] += ayA;
+		}
+	}
+
+	void GravityPhysicsSystem::evaluateAccelerationsReferenceParallel(const BodyStore& bodies) {
+		const size_t count = bodies.size();
+		const unsigned int threads = threadPool->threadCount();
+		const float* x = bodies.x.data();
+		const float* y = bodies.y.data();
+		const float* mass = bodies.mass.data();
+
+		// Each thread owns a private copy of every acceleration, so pairs can still be visited only once
+		threadAccelerations.assign(static_cast<size_t>(threads) * 2 * count, 0.f);
+
+		threadPool->run([&](unsigned int threadIndex) {
+			// Row a holds count - a - 1 pairs, rows are split so each thread gets about the same number of pairs
+			auto rowBoundary = [&](unsigned int t) {
+				if (t >= threads) return count;
+				double remaining = std::sqrt(1.0 - static_cast<double>(t) / threads);
+				return std::min(count, static_cast<size_t>(count * (1.0 - remaining)));
+			};
+			const size_t rowBegin = rowBoundary(threadIndex);
+			const size_t rowEnd = rowBoundary(threadIndex + 1);
+			float* ax = threadAccelerations.data() + static_cast<size_t>(threadIndex) * 2 * count;
+			float* ay = ax + count;
+
+			for (size_t a = rowBegin; a < rowEnd; a++) {
+				const float xa = x[a];
+				const float ya = y[a];
+				for (size_t b = a + 1; b < count; b++) {
+					float dx = x[b] - xa;
+					float dy = y[b] - ya;
+					float distanceSquared = dx * dx + dy * dy;
+					if (distanceSquared < 1e-10f) continue;
+
+					float inverseDistance = 1.f / std::sqrt(distanceSquared);
+					float scale = strengthGravity * inverseDistance * inverseDistance * inverseDistance;
+
+					ax[a] += scale * mass[b] * dx;
+					ay[a] += scale * mass[b] * dy;
+					ax[b] -= scale * mass[a] * dx;
+					ay[b] -= scale * mass[a] * dy;
+				}
+			}
+		});
+
+		// Reduce the per thread accelerations always in thread order
+		threadPool->parallelFor(count, [&](size_t begin, size_t end, unsigned int) {
+			for (size_t i = begin; i < end; i++) {
+				float sumX = 0.f;
+				float sumY = 0.f;
+				for (unsigned int t = 0; t < threads; t++) {
+					const float* ax = threadAccelerations.data() + static_cast<size_t>(t) * 2 * count;
+					sumX += ax[i];
+					sumY += ax[count + i];
+				}
+				accelerationX[i] = sumX;
+				accelerationY[i] = sumY;
+			}
+		});
+	}
+
+	void GravityPhysicsSystem::evaluateAccelerationsBarnesHut(const BodyStore& bodies) {
+		// Positions change every evaluation, so the tree has to be rebuilt each time
+		const size_t count = bodies.size();
+		quadTree.build(bodies.x.data(), bodies.y.data(), bodies.mass.data(), count);
+
+		// The tree is only read from here on, so bodies can be split between threads
+		auto traverse = [&](size_t begin, size_t end, unsigned int) {
+			for (size_t i = begin; i < end; i++) {
+				glm::vec2 acceleration = quadTree.computeAcceleration(bodies.position(i), strengthGravity, openingAngle);
+				accelerationX[i] = acceleration.x;
+				accelerationY[i] = acceleration.y;
+			}
+		};
+		if (threadPool) {
+			threadPool->parallelFor(count, traverse);
+		}
+		else {
+			traverse(0, count, 0);
+		}
+	}
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include "body_store.hpp"
+#include "gravity_kernels.hpp"
+#include "quad_tree.hpp"
+#include "thread_pool.hpp"
+
+#include <memory>
+#include <vector>
+
+namespace vraus_VulkanEngine {
+
+	enum class GravitySolver {
+		Pairwise,	// Exact O(N^2) sum over every pair of bodies
+		BarnesHut,	// O(N log N) approximation using a quadtree rebuilt every substep
+	};
+
+	// How a substep advances positions and velocities from the accelerations
+	enum class Integrator {
+		SemiImplicitEuler,	// Kick then drift. 1st order, 1 force evaluation per substep
+		Leapfrog,			// Drift-kick-drift, same as velocity Verlet. 2nd order and symplectic, 1 force evaluation per substep
+		Yoshida4,			// Three leapfrog substeps with Yoshida / Forest-Ruth weights. 4th order, 3 force evaluations per substep
+	};
+
+	class GravityPhysicsSystem {
+	public:
+		// How close the Barnes-Hut approximation is to the exact solver, relative errors are |a_approx - a_exact| / |a_exact|
+		struct ForceErrorReport {
+			size_t sampledBodies = 0;
+			float maxRelativeError = 0.f;
+			float meanRelativeError = 0.f;
+			float rmsRelativeError = 0.f;
+		};
+
+		// Quantities a closed system keeps, used to measure how much an integrator drifts
+		struct ConservedQuantities {
+			double kineticEnergy = 0.0;
+			double potentialEnergy = 0.0;
+			double momentumX = 0.0;
+			double momentumY = 0.0;
+			double angularMomentum = 0.0;
+			double momentumScale = 0.0; // Sum of |m v|, what momentum drift is relative to
+
+			double totalEnergy() const { return kineticEnergy + potentialEnergy; }
+		};
+
+		struct DriftReport {
+			double relativeEnergyDrift = 0.0;	// |E - E0| / |E0|
+			double relativeMomentumDrift = 0.0;	// |P - P0| / sum |m v0|
+			double angularMomentumDrift = 0.0;	// |L - L0| / |L0|, or absolute when L0 is 0
+		};
+
+		GravityPhysicsSystem(float strength) : strengthGravity{ strength } {}
+
+		const float strengthGravity;
+
+		GravitySolver solver = GravitySolver::Pairwise;
+		// Barnes-Hut opening angle theta: smaller is more accurate but opens more nodes. 0.5 is the usual compromise.
+		float openingAngle = .5f;
+		// Kernel used by the pairwise solver. Every kernel but Reference uses a softened distance.
+		ForceKernel forceKernel = ForceKernel::Auto;
+
+		// Length added to every distance by the softened kernels. Must be greater than 0: the self pair has a zero
+		// distance, and only the softening keeps its term at 0 instead of NaN. Throws otherwise.
+		void setSoftening(float length);
+		float getSoftening() const { return softening; }
+
+		Integrator integrator = Integrator::SemiImplicitEuler;
+		// When enabled, update() ignores its substeps argument and picks the substep count from the current accelerations:
+		// h = timestepAccuracy * sqrt(adaptiveLengthScale / max |a|), so close approaches get small steps and quiet phases large ones.
+		// The count only changes between updates, each update still uses equal substeps.
+		bool adaptiveSubsteps = false;
+		float timestepAccuracy = .1f;
+		float adaptiveLengthScale = .05f;
+		unsigned int minSubsteps = 1;
+		unsigned int maxSubsteps = 64;
+
+		// Number of threads used to accumulate forces, including the calling thread. 1 disables multithreading.
+		// Results are bitwise reproducible for a given thread count.
+		void setThreadCount(unsigned int threads);
+		unsigned int getThreadCount() const { return threadPool ? threadPool->threadCount() : 1; }
+
+		// dt stands for delta time. Specifies the amount of time to advance the simulation
+		// substeps is how many intervals to divide the forward time step in. More substeps result in a
+		// more stable simulation, but takes longer to compute.
+		void update(BodyStore& bodies, float dt, unsigned int substeps = 1);
+
+		// Substeps and force evaluations (one per body set) used by the last update
+		unsigned int getLastSubsteps() const { return lastSubsteps; }
+		unsigned int getLastForceEvaluations() const { return lastForceEvaluations; }
+
+		// Force applied on toPosition, pointing towards fromPosition
+		glm::vec2 computeForce(glm::vec2 fromPosition, float fromMass, glm::vec2 toPosition, float toMass) const;
+
+		// Compares the Barnes-Hut accelerations against the exact pairwise ones for the current state of bodies.
+		// The exact sum is O(N) per body, so at most maxSamples evenly spread bodies are checked.
+		ForceErrorReport compareWithExact(const BodyStore& bodies, size_t maxSamples = 1000) const;
+
+		// Energy uses the same potential as the forces (softened or not), so it is conserved exactly by an exact integration. O(N^2).
+		ConservedQuantities measureConservedQuantities(const BodyStore& bodies) const;
+		static DriftReport compareConservedQuantities(const ConservedQuantities& initial, const ConservedQuantities& current);
+
+		// While enabled, every update measures the conserved quantities, O(N^2), and compares them with those of the bodies
+		// before the first tracked update. Enabling it again, or a change in body count, starts over from the current state.
+		void setDriftTracking(bool enabled);
+		bool isDriftTracking() const { return driftTracking; }
+		// Drift since tracking started, as of the last update
+		const DriftReport& getDrift() const { return driftReport; }
+
+	private:
+		void step(BodyStore& bodies, float dt);
+		void drift(BodyStore& bodies, float dt) const;
+		void kick(BodyStore& bodies, float dt) const;
+		unsigned int chooseSubsteps(const BodyStore& bodies, float dt);
+		bool usesSoftening() const;
+
+		// Fill accelerationX / accelerationY for the current positions
+		void evaluateAccelerations(const BodyStore& bodies);
+		void evaluateAccelerationsReference(const BodyStore& bodies);
+		void evaluateAccelerationsReferenceParallel(const BodyStore& bodies);
+		void evaluateAccelerationsBarnesHut(const BodyStore& bodies);
+
+		// Rebuilt every force evaluation, kept as a member so its node storage is reused between frames
+		QuadTree quadTree;
+		std::vector<float> accelerationX;
+		std::vector<float> accelerationY;
+
+		std::unique_ptr<ThreadPool> threadPool;
+		// Accelerations accumulated by each thread in the parallel reference kernel, [thread][ax..., ay...]
+		std::vector<float> threadAccelerations;
+		bool accelerationsValid = false; // accelerationX / Y match the bodies as they were at the end of the last update
+
+		float softening = 1e-5f;
+
+		unsigned int lastSubsteps = 0;
+		unsigned int lastForceEvaluations = 0;
+
+		bool driftTracking = false;
+		bool hasDriftReference = false;
+		size_t driftBodyCount = 0;
+		ConservedQuantities driftReference{};
+		DriftReport driftReport{};
+	};
+}
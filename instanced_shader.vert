@@ -0,0 +1,16 @@
+#version 450
+
+layout (location = 0) in vec2 position;
+layout (location = 1) in vec3 color;
+
+// Per instance, from binding 1
+layout (location = 2) in mat2 instanceTransform; // Takes locations 2 and 3
+layout (location = 4) in vec2 instanceOffset;
+layout (location = 5) in vec3 instanceColor;
+
+layout (location = 0) out vec3 fragColor;
+
+void main() {
+	gl_Position = vec4(instanceTransform * position + instanceOffset, 0.0, 1.0);
+	fragColor = instanceColor;
+}
\ No newline at end of file
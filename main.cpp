@@ -1,14 +1,50 @@
 #include "first_app.hpp"
 
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <memory>
 #include <stdexcept>
+#include <string>
 
-int main() {
-    vraus_VulkanEngine::FirstApp app{};
+// --headless [--frames N] [--screenshot file.png] renders offscreen, without a window or a display
+// --cpu-field evaluates the vector field on the CPU, then culls and draws it indirectly
+// --parallel-record records the objects drawn one by one on every core
+// --record-benchmark adds 100k objects drawn one by one and compares their recording time on 1 and on every thread
+int main(int argc, char* argv[]) {
+    bool headless = false;
+    vraus_VulkanEngine::FirstApp::HeadlessConfig headlessConfig{};
+    vraus_VulkanEngine::FirstApp::Options options{};
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--headless") == 0) {
+            headless = true;
+        }
+        else if (strcmp(argv[i], "--cpu-field") == 0) {
+            options.computeFieldOnGpu = false;
+        }
+        else if (strcmp(argv[i], "--parallel-record") == 0) {
+            options.recordInParallel = true;
+        }
+        else if (strcmp(argv[i], "--record-benchmark") == 0) {
+            options.recordBenchmarkObjectCount = 100000;
+        }
+        else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            headlessConfig.frameCount = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (strcmp(argv[i], "--screenshot") == 0 && i + 1 < argc) {
+            headlessConfig.screenshotPath = argv[++i];
+        }
+        else {
+            std::cerr << "unknown argument: " << argv[i] << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
 
     try {
-        app.run();
+        auto app = headless ?
+            std::make_unique<vraus_VulkanEngine::FirstApp>(headlessConfig, options) :
+            std::make_unique<vraus_VulkanEngine::FirstApp>(options);
+        app->run();
     }
     catch (const std::exception& e) {
         std::cerr << e.what() << std::endl;
@@ -16,4 +52,4 @@ int main() {
     }
     
     return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
@@ -0,0 +1,84 @@
+#include "mapped_file.hpp"
+
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace vraus_VulkanEngine {
+
+#ifdef _WIN32
+	MappedFile::MappedFile(const std::string& filepath) {
+		fileHandle = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (fileHandle == INVALID_HANDLE_VALUE) {
+			fileHandle = nullptr;
+			throw std::runtime_error("failed to open file: " + filepath);
+		}
+
+		LARGE_INTEGER fileSize{};
+		if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0) {
+			unmap();
+			throw std::runtime_error("failed to map empty file: " + filepath);
+		}
+		size_ = static_cast<size_t>(fileSize.QuadPart);
+
+		mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mappingHandle != nullptr) {
+			data_ = static_cast<const char*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+		}
+		if (data_ == nullptr) {
+			unmap();
+			throw std::runtime_error("failed to map file: " + filepath);
+		}
+	}
+
+	void MappedFile::unmap() {
+		if (data_ != nullptr) UnmapViewOfFile(data_);
+		if (mappingHandle != nullptr) CloseHandle(mappingHandle);
+		if (fileHandle != nullptr) CloseHandle(fileHandle);
+		data_ = nullptr;
+		mappingHandle = nullptr;
+		fileHandle = nullptr;
+	}
+#else
+	MappedFile::MappedFile(const std::string& filepath) {
+		fileDescriptor = open(filepath.c_str(), O_RDONLY);
+		if (fileDescriptor < 0) {
+			throw std::runtime_error("failed to open file: " + filepath);
+		}
+
+		struct stat fileStat {};
+		if (fstat(fileDescriptor, &fileStat) != 0 || fileStat.st_size == 0) {
+			unmap();
+			throw std::runtime_error("failed to map empty file: " + filepath);
+		}
+		size_ = static_cast<size_t>(fileStat.st_size);
+
+		void* mapped = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+		if (mapped == MAP_FAILED) {
+			unmap();
+			throw std::runtime_error("failed to map file: " + filepath);
+		}
+		data_ = static_cast<const char*>(mapped);
+	}
+
+	void MappedFile::unmap() {
+		if (data_ != nullptr) munmap(const_cast<char*>(data_), size_);
+		if (fileDescriptor >= 0) close(fileDescriptor);
+		data_ = nullptr;
+		fileDescriptor = -1;
+	}
+#endif
+
+	MappedFile::~MappedFile() {
+		unmap();
+	}
+}
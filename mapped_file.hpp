@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace vraus_VulkanEngine {
+	/* Read only view of a whole file mapped into memory. The OS pages the contents in when they are read,
+	nothing is copied into a buffer of our own. The view is page aligned.
+	*/
+	class MappedFile {
+	public:
+		// Throws when the file can't be opened, is empty or can't be mapped
+		MappedFile(const std::string& filepath);
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		const char* data() const { return data_; }
+		size_t size() const { return size_; }
+
+	private:
+		void unmap();
+
+#ifdef _WIN32
+		void* fileHandle = nullptr;
+		void* mappingHandle = nullptr;
+#else
+		int fileDescriptor = -1;
+#endif
+		const char* data_ = nullptr;
+		size_t size_ = 0;
+	};
+}
@@ -0,0 +1,458 @@
+#include "memory_allocator.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <iomanip>
+#include <stdexcept>
+#include <string>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace vraus_VulkanEngine {
+
+	// Index of the lowest set bit, value must not be 0
+	static uint32_t lowestBit(uint64_t value) {
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward64(&index, value);
+		return static_cast<uint32_t>(index);
+#else
+		return static_cast<uint32_t>(__builtin_ctzll(value));
+#endif
+	}
+
+	// Index of the highest set bit, value must not be 0
+	static uint32_t highestBit(uint64_t value) {
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanReverse64(&index, value);
+		return static_cast<uint32_t>(index);
+#else
+		return 63 - static_cast<uint32_t>(__builtin_clzll(value));
+#endif
+	}
+
+	// alignment must be a power of 2
+	static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	MemoryAllocator::MemoryAllocator(
+		VkDevice device,
+		const VkPhysicalDeviceMemoryProperties& memoryProperties,
+		const VkPhysicalDeviceLimits& limits,
+		VkDeviceSize preferredBlockSize)
+		: device{ device },
+		memoryProperties{ memoryProperties },
+		preferredBlockSize{ preferredBlockSize },
+		bufferImageGranularity{ limits.bufferImageGranularity },
+		nonCoherentAtomSize{ limits.nonCoherentAtomSize } {
+		pools.resize(memoryProperties.memoryTypeCount * 2);
+		for (uint32_t type = 0; type < memoryProperties.memoryTypeCount; type++) {
+			// Small heaps (host visible device local memory is often 256MB) get smaller blocks so a few don't exhaust them
+			const VkDeviceSize heapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[type].heapIndex].size;
+			const VkDeviceSize blockSize = std::max(MIN_ALIGNMENT, std::min(preferredBlockSize, heapSize / 8) & ~(MIN_ALIGNMENT - 1));
+			for (ResourceKind kind : { ResourceKind::Linear, ResourceKind::Optimal }) {
+				Pool& pool = pools[type * 2 + (kind == ResourceKind::Optimal ? 1 : 0)];
+				pool.memoryTypeIndex = type;
+				pool.kind = kind;
+				pool.blockSize = blockSize;
+				for (auto& lists : pool.freeLists) {
+					std::fill(std::begin(lists), std::end(lists), NONE);
+				}
+			}
+		}
+	}
+
+	MemoryAllocator::~MemoryAllocator() {
+		assert(getStats().allocationCount == 0 && "Memory allocations still alive when the allocator is destroyed");
+		for (Pool& pool : pools) {
+			for (Block& block : pool.blocks) {
+				if (block.memory != VK_NULL_HANDLE) freeDeviceMemory(block.memory, pool.memoryTypeIndex);
+			}
+		}
+		for (Dedicated& allocation : dedicated) {
+			if (allocation.memory != VK_NULL_HANDLE) freeDeviceMemory(allocation.memory, allocation.memoryTypeIndex);
+		}
+	}
+
+	MemoryAllocation MemoryAllocator::allocate(
+		const VkMemoryRequirements& requirements, uint32_t memoryTypeIndex, ResourceKind kind)
+	{
+		assert(memoryTypeIndex < memoryProperties.memoryTypeCount && "Memory type out of range");
+		std::lock_guard<std::mutex> lock{ mutex };
+
+		// The size only needs rounding to the range granularity, the next allocation aligns its own offset
+		const VkDeviceSize alignment = requiredAlignment(requirements, memoryTypeIndex);
+		const VkDeviceSize granularity = isHostCoherent(memoryTypeIndex) ? MIN_ALIGNMENT : std::max(MIN_ALIGNMENT, nonCoherentAtomSize);
+		const VkDeviceSize size = alignUp(std::max<VkDeviceSize>(requirements.size, 1), granularity);
+		const uint32_t index = poolIndex(memoryTypeIndex, kind);
+		Pool& pool = pools[index];
+		if (size > pool.blockSize / 2) {
+			return allocateDedicated(requirements, memoryTypeIndex);
+		}
+
+		// Free ranges start on MIN_ALIGNMENT, so a range this large always fits an aligned allocation
+		const VkDeviceSize searchSize = size + alignment - MIN_ALIGNMENT;
+		uint32_t node = findFree(pool, searchSize);
+		if (node == NONE) {
+			addBlock(pool, searchSize);
+			node = findFree(pool, searchSize);
+			if (node == NONE) throw std::runtime_error("failed to find a free range in a new memory block!");
+		}
+		removeFree(pool, node);
+
+		const VkDeviceSize padding = alignUp(pool.nodes[node].offset, alignment) - pool.nodes[node].offset;
+		if (padding > 0) {
+			insertFree(pool, splitFront(pool, node, padding));
+		}
+		if (pool.nodes[node].size > size) {
+			uint32_t used = splitFront(pool, node, size);
+			insertFree(pool, node);
+			node = used;
+		}
+		pool.nodes[node].free = false;
+
+		Block& block = pool.blocks[pool.nodes[node].block];
+		if (block.allocationCount++ == 0) pool.emptyBlockCount--;
+		pool.allocationCount++;
+		pool.usedBytes += pool.nodes[node].size;
+
+		MemoryAllocation allocation{};
+		allocation.memory = block.memory;
+		allocation.offset = pool.nodes[node].offset;
+		allocation.size = pool.nodes[node].size;
+		allocation.mapped = block.mapped ? static_cast<char*>(block.mapped) + allocation.offset : nullptr;
+		allocation.pool = index;
+		allocation.node = node;
+		return allocation;
+	}
+
+	void MemoryAllocator::free(MemoryAllocation& allocation) {
+		if (allocation.memory == VK_NULL_HANDLE) return;
+		std::lock_guard<std::mutex> lock{ mutex };
+
+		if (allocation.dedicated) {
+			Dedicated& entry = dedicated[allocation.node];
+			freeDeviceMemory(entry.memory, entry.memoryTypeIndex);
+			entry = {};
+			unusedDedicatedSlots.push_back(allocation.node);
+			allocation = {};
+			return;
+		}
+
+		Pool& pool = pools[allocation.pool];
+		uint32_t node = allocation.node;
+		assert(!pool.nodes[node].free && pool.nodes[node].offset == allocation.offset && "Allocation freed twice");
+		pool.nodes[node].free = true;
+		pool.allocationCount--;
+		pool.usedBytes -= pool.nodes[node].size;
+
+		uint32_t next = pool.nodes[node].nextPhysical;
+		if (next != NONE && pool.nodes[next].free) {
+			removeFree(pool, next);
+			merge(pool, node, next);
+		}
+		uint32_t prev = pool.nodes[node].prevPhysical;
+		if (prev != NONE && pool.nodes[prev].free) {
+			removeFree(pool, prev);
+			merge(pool, prev, node);
+			node = prev;
+		}
+
+		const uint32_t blockIndex = pool.nodes[node].block;
+		if (--pool.blocks[blockIndex].allocationCount == 0) {
+			// One empty block is kept per pool so allocating and freeing around a block boundary doesn't thrash the driver
+			if (pool.emptyBlockCount > 0) {
+				destroyNode(pool, node);
+				releaseBlock(pool, blockIndex);
+				allocation = {};
+				return;
+			}
+			pool.emptyBlockCount++;
+		}
+		insertFree(pool, node);
+		allocation = {};
+	}
+
+	MemoryAllocator::Stats MemoryAllocator::getStats() const {
+		std::lock_guard<std::mutex> lock{ mutex };
+		Stats stats{};
+		stats.deviceMemoryCount = deviceMemoryCount;
+		for (const Pool& pool : pools) {
+			stats.allocationCount += pool.allocationCount;
+			stats.usedBytes += pool.usedBytes;
+			for (const Block& block : pool.blocks) {
+				stats.reservedBytes += block.size;
+			}
+		}
+		for (const Dedicated& entry : dedicated) {
+			if (entry.memory == VK_NULL_HANDLE) continue;
+			stats.allocationCount++;
+			stats.dedicatedAllocationCount++;
+			stats.reservedBytes += entry.size;
+			stats.usedBytes += entry.size;
+		}
+		return stats;
+	}
+
+	void MemoryAllocator::dumpStats(std::ostream& out) const {
+		Stats totals = getStats();
+		std::lock_guard<std::mutex> lock{ mutex };
+
+		auto kib = [](VkDeviceSize bytes) { return (bytes + 1023) / 1024; };
+		out << "Memory allocator: " << totals.deviceMemoryCount << " device memory allocations, "
+			<< totals.allocationCount << " suballocations (" << totals.dedicatedAllocationCount << " dedicated), "
+			<< kib(totals.usedBytes) << " KiB used of " << kib(totals.reservedBytes) << " KiB reserved\n";
+		out << std::left << std::setw(6) << "type" << std::setw(12) << "flags" << std::setw(9) << "kind"
+			<< std::right << std::setw(7) << "blocks" << std::setw(8) << "allocs" << std::setw(14) << "used KiB"
+			<< std::setw(14) << "reserved KiB" << std::setw(12) << "free ranges" << std::setw(18) << "largest free KiB" << "\n";
+
+		for (const Pool& pool : pools) {
+			uint32_t blockCount = 0;
+			VkDeviceSize reserved = 0;
+			for (const Block& block : pool.blocks) {
+				if (block.memory == VK_NULL_HANDLE) continue;
+				blockCount++;
+				reserved += block.size;
+			}
+			if (blockCount == 0) continue;
+
+			uint32_t freeRanges = 0;
+			VkDeviceSize largestFree = 0;
+			for (const Node& node : pool.nodes) {
+				if (node.block == NONE || !node.free) continue;
+				freeRanges++;
+				largestFree = std::max(largestFree, node.size);
+			}
+
+			const VkMemoryPropertyFlags flags = memoryProperties.memoryTypes[pool.memoryTypeIndex].propertyFlags;
+			std::string flagNames{};
+			if (flags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) flagNames += "DL ";
+			if (flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) flagNames += "HV ";
+			if (flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) flagNames += "HC ";
+			if (flags & VK_MEMORY_PROPERTY_HOST_CACHED_BIT) flagNames += "HCa";
+
+			out << std::left << std::setw(6) << pool.memoryTypeIndex << std::setw(12) << flagNames
+				<< std::setw(9) << (pool.kind == ResourceKind::Linear ? "linear" : "optimal")
+				<< std::right << std::setw(7) << blockCount << std::setw(8) << pool.allocationCount
+				<< std::setw(14) << kib(pool.usedBytes) << std::setw(14) << kib(reserved)
+				<< std::setw(12) << freeRanges << std::setw(18) << largestFree / 1024 << "\n";
+		}
+	}
+
+	/* TLSF size classes. The first level is the power of 2 below the size, the second level splits every power of 2
+	into SL_COUNT linear steps. Sizes below 2^SMALL_LOG2 all go in first level 0, MIN_ALIGNMENT apart.
+	Free ranges are filed by rounding their size down (every range in a list is at least the list's size),
+	searches round the requested size up to the next list so any range found fits without walking the list. */
+	void MemoryAllocator::mapping(VkDeviceSize size, uint32_t& fl, uint32_t& sl) {
+		if (size < (VkDeviceSize{ 1 } << SMALL_LOG2)) {
+			fl = 0;
+			sl = static_cast<uint32_t>(size / MIN_ALIGNMENT);
+			return;
+		}
+		const uint32_t log2 = highestBit(size);
+		fl = log2 - SMALL_LOG2 + 1;
+		sl = static_cast<uint32_t>(size >> (log2 - SL_LOG2)) - SL_COUNT;
+	}
+
+	void MemoryAllocator::mappingSearch(VkDeviceSize size, uint32_t& fl, uint32_t& sl) {
+		if (size >= (VkDeviceSize{ 1 } << SMALL_LOG2)) {
+			size += (VkDeviceSize{ 1 } << (highestBit(size) - SL_LOG2)) - 1;
+		}
+		mapping(size, fl, sl);
+	}
+
+	uint32_t MemoryAllocator::poolIndex(uint32_t memoryTypeIndex, ResourceKind kind) const {
+		// Without a granularity constraint, linear and optimal resources can share blocks
+		const bool separate = bufferImageGranularity > 1 && kind == ResourceKind::Optimal;
+		return memoryTypeIndex * 2 + (separate ? 1 : 0);
+	}
+
+	bool MemoryAllocator::isHostVisible(uint32_t memoryTypeIndex) const {
+		return memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+	}
+
+	// Host visible memory without the coherent bit is flushed and invalidated by hand
+	bool MemoryAllocator::isHostCoherent(uint32_t memoryTypeIndex) const {
+		const VkMemoryPropertyFlags flags = memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags;
+		return !(flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) || (flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	}
+
+	VkDeviceSize MemoryAllocator::requiredAlignment(const VkMemoryRequirements& requirements, uint32_t memoryTypeIndex) const {
+		VkDeviceSize alignment = std::max(requirements.alignment, MIN_ALIGNMENT);
+		// Flushes and invalidates work on whole atoms, neighbours must not share one
+		if (!isHostCoherent(memoryTypeIndex)) {
+			alignment = std::max(alignment, nonCoherentAtomSize);
+		}
+		return alignment;
+	}
+
+	VkDeviceMemory MemoryAllocator::allocateDeviceMemory(VkDeviceSize size, uint32_t memoryTypeIndex, void** mapped) {
+		VkMemoryAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.allocationSize = size;
+		allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+		VkDeviceMemory memory;
+		if (vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate device memory!");
+		}
+		deviceMemoryCount++;
+
+		// A VkDeviceMemory can only be mapped once at a time, and it is shared by every allocation in it
+		*mapped = nullptr;
+		if (isHostVisible(memoryTypeIndex) && vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, mapped) != VK_SUCCESS) {
+			vkFreeMemory(device, memory, nullptr);
+			deviceMemoryCount--;
+			throw std::runtime_error("failed to map device memory!");
+		}
+		return memory;
+	}
+
+	void MemoryAllocator::freeDeviceMemory(VkDeviceMemory memory, uint32_t memoryTypeIndex) {
+		if (isHostVisible(memoryTypeIndex)) vkUnmapMemory(device, memory);
+		vkFreeMemory(device, memory, nullptr);
+		deviceMemoryCount--;
+	}
+
+	MemoryAllocation MemoryAllocator::allocateDedicated(const VkMemoryRequirements& requirements, uint32_t memoryTypeIndex) {
+		MemoryAllocation allocation{};
+		allocation.memory = allocateDeviceMemory(requirements.size, memoryTypeIndex, &allocation.mapped);
+		allocation.size = requirements.size;
+		allocation.dedicated = true;
+
+		if (unusedDedicatedSlots.empty()) {
+			unusedDedicatedSlots.push_back(static_cast<uint32_t>(dedicated.size()));
+			dedicated.emplace_back();
+		}
+		allocation.node = unusedDedicatedSlots.back();
+		unusedDedicatedSlots.pop_back();
+		dedicated[allocation.node] = { allocation.memory, allocation.size, memoryTypeIndex };
+		return allocation;
+	}
+
+	uint32_t MemoryAllocator::addBlock(Pool& pool, VkDeviceSize minimumSize) {
+		if (pool.unusedBlockSlots.empty()) {
+			pool.unusedBlockSlots.push_back(static_cast<uint32_t>(pool.blocks.size()));
+			pool.blocks.emplace_back();
+		}
+		const uint32_t blockIndex = pool.unusedBlockSlots.back();
+
+		Block block{};
+		block.size = std::max(pool.blockSize, alignUp(minimumSize, MIN_ALIGNMENT));
+		block.memory = allocateDeviceMemory(block.size, pool.memoryTypeIndex, &block.mapped);
+		pool.unusedBlockSlots.pop_back();
+		pool.blocks[blockIndex] = block;
+		pool.emptyBlockCount++;
+
+		uint32_t node = createNode(pool);
+		pool.nodes[node].offset = 0;
+		pool.nodes[node].size = block.size;
+		pool.nodes[node].block = blockIndex;
+		insertFree(pool, node);
+		return blockIndex;
+	}
+
+	void MemoryAllocator::releaseBlock(Pool& pool, uint32_t blockIndex) {
+		Block& block = pool.blocks[blockIndex];
+		freeDeviceMemory(block.memory, pool.memoryTypeIndex);
+		block = {};
+		pool.unusedBlockSlots.push_back(blockIndex);
+	}
+
+	uint32_t MemoryAllocator::createNode(Pool& pool) {
+		if (pool.unusedNodes.empty()) {
+			pool.nodes.emplace_back();
+			return static_cast<uint32_t>(pool.nodes.size() - 1);
+		}
+		uint32_t node = pool.unusedNodes.back();
+		pool.unusedNodes.pop_back();
+		pool.nodes[node] = {};
+		return node;
+	}
+
+	void MemoryAllocator::destroyNode(Pool& pool, uint32_t node) {
+		pool.nodes[node] = {};
+		pool.unusedNodes.push_back(node);
+	}
+
+	void MemoryAllocator::insertFree(Pool& pool, uint32_t node) {
+		uint32_t fl, sl;
+		mapping(pool.nodes[node].size, fl, sl);
+		assert(fl < FL_COUNT && "Memory range too large");
+
+		uint32_t head = pool.freeLists[fl][sl];
+		pool.nodes[node].free = true;
+		pool.nodes[node].prevFree = NONE;
+		pool.nodes[node].nextFree = head;
+		if (head != NONE) pool.nodes[head].prevFree = node;
+		pool.freeLists[fl][sl] = node;
+		pool.flBitmap |= uint64_t{ 1 } << fl;
+		pool.slBitmap[fl] |= 1u << sl;
+	}
+
+	void MemoryAllocator::removeFree(Pool& pool, uint32_t node) {
+		uint32_t fl, sl;
+		mapping(pool.nodes[node].size, fl, sl);
+
+		const uint32_t prev = pool.nodes[node].prevFree;
+		const uint32_t next = pool.nodes[node].nextFree;
+		if (prev != NONE) pool.nodes[prev].nextFree = next;
+		if (next != NONE) pool.nodes[next].prevFree = prev;
+		if (pool.freeLists[fl][sl] == node) {
+			pool.freeLists[fl][sl] = next;
+			if (next == NONE) {
+				pool.slBitmap[fl] &= ~(1u << sl);
+				if (pool.slBitmap[fl] == 0) pool.flBitmap &= ~(uint64_t{ 1 } << fl);
+			}
+		}
+		pool.nodes[node].prevFree = NONE;
+		pool.nodes[node].nextFree = NONE;
+		pool.nodes[node].free = false;
+	}
+
+	uint32_t MemoryAllocator::findFree(Pool& pool, VkDeviceSize size) const {
+		uint32_t fl, sl;
+		mappingSearch(size, fl, sl);
+		if (fl >= FL_COUNT) return NONE;
+
+		uint32_t slMap = pool.slBitmap[fl] & (~0u << sl);
+		if (slMap == 0) {
+			const uint64_t flMap = fl + 1 < 64 ? pool.flBitmap & (~uint64_t{ 0 } << (fl + 1)) : 0;
+			if (flMap == 0) return NONE;
+			fl = lowestBit(flMap);
+			slMap = pool.slBitmap[fl];
+		}
+		return pool.freeLists[fl][lowestBit(slMap)];
+	}
+
+	uint32_t MemoryAllocator::splitFront(Pool& pool, uint32_t node, VkDeviceSize size) {
+		assert(size < pool.nodes[node].size && "Split larger than the range");
+		const uint32_t front = createNode(pool);
+		Node& original = pool.nodes[node];
+		Node& created = pool.nodes[front];
+		created.offset = original.offset;
+		created.size = size;
+		created.block = original.block;
+		created.prevPhysical = original.prevPhysical;
+		created.nextPhysical = node;
+		if (original.prevPhysical != NONE) pool.nodes[original.prevPhysical].nextPhysical = front;
+		original.prevPhysical = front;
+		original.offset += size;
+		original.size -= size;
+		return front;
+	}
+
+	void MemoryAllocator::merge(Pool& pool, uint32_t node, uint32_t next) {
+		Node& first = pool.nodes[node];
+		const Node& second = pool.nodes[next];
+		assert(first.nextPhysical == next && first.offset + first.size == second.offset && "Merging ranges that are not neighbours");
+		first.size += second.size;
+		first.nextPhysical = second.nextPhysical;
+		if (second.nextPhysical != NONE) pool.nodes[second.nextPhysical].prevPhysical = node;
+		destroyNode(pool, next);
+	}
+}
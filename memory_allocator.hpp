@@ -0,0 +1,154 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+namespace vraus_VulkanEngine {
+
+	// A range of a VkDeviceMemory handed out by MemoryAllocator. Bind the resource at memory + offset.
+	struct MemoryAllocation {
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;
+		VkDeviceSize size = 0;
+		// Start of the range when the memory is host visible, blocks stay mapped for their whole life
+		void* mapped = nullptr;
+
+		// Owned by the allocator
+		uint32_t pool = 0;
+		uint32_t node = 0;
+		bool dedicated = false;
+	};
+
+	/* Sub-allocates buffers and images out of large VkDeviceMemory blocks instead of one vkAllocateMemory each,
+	drivers limit the number of allocations (often to 4096) and allocating is slow.
+	There is one pool per memory type and resource kind. Linear resources (buffers) and optimal images never share a
+	block, so bufferImageGranularity never has to be checked between neighbours.
+	Inside a pool every free range of every block sits in a TLSF (two level segregated fit) free list: finding a range,
+	splitting it and merging it back with its neighbours on free are all O(1).
+	Requests bigger than half a block get a dedicated allocation. Thread safe.
+	*/
+	class MemoryAllocator {
+	public:
+		enum class ResourceKind { Linear, Optimal };
+
+		struct Stats {
+			uint32_t deviceMemoryCount = 0; // Live vkAllocateMemory allocations, blocks and dedicated
+			uint32_t allocationCount = 0;
+			uint32_t dedicatedAllocationCount = 0;
+			VkDeviceSize reservedBytes = 0; // Allocated from the driver
+			VkDeviceSize usedBytes = 0; // Handed out, alignment padding included
+		};
+
+		static constexpr VkDeviceSize DEFAULT_BLOCK_SIZE = 64ull * 1024 * 1024;
+
+		MemoryAllocator(
+			VkDevice device,
+			const VkPhysicalDeviceMemoryProperties& memoryProperties,
+			const VkPhysicalDeviceLimits& limits,
+			VkDeviceSize preferredBlockSize = DEFAULT_BLOCK_SIZE);
+		~MemoryAllocator();
+
+		MemoryAllocator(const MemoryAllocator&) = delete;
+		MemoryAllocator& operator=(const MemoryAllocator&) = delete;
+
+		MemoryAllocation allocate(
+			const VkMemoryRequirements& requirements, uint32_t memoryTypeIndex, ResourceKind kind);
+		// Resets the allocation, freeing an empty allocation does nothing
+		void free(MemoryAllocation& allocation);
+
+		Stats getStats() const;
+		// Human readable table of every pool
+		void dumpStats(std::ostream& out) const;
+
+	private:
+		static constexpr uint32_t NONE = UINT32_MAX;
+		static constexpr uint32_t SL_LOG2 = 4; // 16 second level lists per power of 2
+		static constexpr uint32_t SL_COUNT = 1 << SL_LOG2;
+		static constexpr uint32_t FL_COUNT = 48;
+		static constexpr VkDeviceSize MIN_ALIGNMENT = 16; // Every range offset and size is a multiple of this
+		static constexpr uint32_t SMALL_LOG2 = SL_LOG2 + 4; // Below 2^SMALL_LOG2 the lists are MIN_ALIGNMENT apart
+
+		struct Block {
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			VkDeviceSize size = 0;
+			void* mapped = nullptr;
+			uint32_t allocationCount = 0;
+		};
+
+		// A range of a block, free or used. Ranges of a block form a list in address order.
+		struct Node {
+			VkDeviceSize offset = 0;
+			VkDeviceSize size = 0;
+			uint32_t block = NONE;
+			uint32_t prevPhysical = NONE;
+			uint32_t nextPhysical = NONE;
+			uint32_t prevFree = NONE;
+			uint32_t nextFree = NONE;
+			bool free = false;
+		};
+
+		struct Pool {
+			uint32_t memoryTypeIndex = 0;
+			ResourceKind kind = ResourceKind::Linear;
+			VkDeviceSize blockSize = 0;
+			std::vector<Block> blocks{};
+			std::vector<uint32_t> unusedBlockSlots{};
+			uint32_t emptyBlockCount = 0;
+
+			std::vector<Node> nodes{};
+			std::vector<uint32_t> unusedNodes{};
+			uint64_t flBitmap = 0;
+			uint32_t slBitmap[FL_COUNT]{};
+			uint32_t freeLists[FL_COUNT][SL_COUNT];
+
+			uint32_t allocationCount = 0;
+			VkDeviceSize usedBytes = 0;
+		};
+
+		struct Dedicated {
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			VkDeviceSize size = 0;
+			uint32_t memoryTypeIndex = 0;
+		};
+
+		static void mapping(VkDeviceSize size, uint32_t& fl, uint32_t& sl);
+		static void mappingSearch(VkDeviceSize size, uint32_t& fl, uint32_t& sl);
+
+		uint32_t poolIndex(uint32_t memoryTypeIndex, ResourceKind kind) const;
+		VkDeviceMemory allocateDeviceMemory(VkDeviceSize size, uint32_t memoryTypeIndex, void** mapped);
+		void freeDeviceMemory(VkDeviceMemory memory, uint32_t memoryTypeIndex);
+		bool isHostVisible(uint32_t memoryTypeIndex) const;
+		bool isHostCoherent(uint32_t memoryTypeIndex) const;
+		VkDeviceSize requiredAlignment(const VkMemoryRequirements& requirements, uint32_t memoryTypeIndex) const;
+
+		MemoryAllocation allocateDedicated(const VkMemoryRequirements& requirements, uint32_t memoryTypeIndex);
+		uint32_t addBlock(Pool& pool, VkDeviceSize minimumSize);
+		void releaseBlock(Pool& pool, uint32_t block);
+
+		uint32_t createNode(Pool& pool);
+		void destroyNode(Pool& pool, uint32_t node);
+		void insertFree(Pool& pool, uint32_t node);
+		void removeFree(Pool& pool, uint32_t node);
+		uint32_t findFree(Pool& pool, VkDeviceSize size) const;
+		// Cuts the first size bytes of node into a new node placed before it, returns the new node
+		uint32_t splitFront(Pool& pool, uint32_t node, VkDeviceSize size);
+		// Merges next into node, next is destroyed
+		void merge(Pool& pool, uint32_t node, uint32_t next);
+
+		VkDevice device;
+		VkPhysicalDeviceMemoryProperties memoryProperties;
+		VkDeviceSize preferredBlockSize;
+		VkDeviceSize bufferImageGranularity;
+		VkDeviceSize nonCoherentAtomSize;
+
+		mutable std::mutex mutex;
+		std::vector<Pool> pools;
+		std::vector<Dedicated> dedicated;
+		std::vector<uint32_t> unusedDedicatedSlots;
+		uint32_t deviceMemoryCount = 0;
+	};
+}
@@ -1,18 +1,39 @@
 #include "model.hpp"
 
+#include <algorithm>
 #include <cassert>
 #include <cstring>
+#include <functional>
 
 namespace vraus_VulkanEngine {
 
-	Model::Model(Device& device, const std::vector<Vertex>& vertices) : device{ device } {
+	Model::Model(Device& device, const std::vector<Vertex>& vertices, Usage usage) : device{ device }, usage{ usage } {
 		createVertexBuffers(vertices);
 	}
 
+	Model::Model(Device& device, const Builder& builder, Usage usage) : device{ device }, usage{ usage } {
+		createVertexBuffers(builder.vertices);
+		createIndexBuffers(builder.indices);
+	}
+
+	Model::Model(Device& device, const Builder& builder, UploadService& uploadService)
+		: device{ device }, usage{ Usage::Static }, uploadService{ &uploadService } {
+		createVertexBuffers(builder.vertices);
+		createIndexBuffers(builder.indices);
+	}
+
 	Model::~Model()
 	{
+		// The buffers may still be the destination of a copy
+		if (!isReady()) uploadService->wait(uploadHandle);
+
 		vkDestroyBuffer(device.device(), vertexBuffer, nullptr);
-		vkFreeMemory(device.device(), vertexBufferMemory, nullptr);
+		device.freeMemory(vertexBufferMemory);
+
+		if (hasIndexBuffer()) {
+			vkDestroyBuffer(device.device(), indexBuffer, nullptr);
+			device.freeMemory(indexBufferMemory);
+		}
 	}
 
 	/* Record to our command buffer to bind 1 vertex buffers starting at biding 0
@@ -23,35 +44,150 @@ namespace vraus_VulkanEngine {
 		VkBuffer buffers[] = { vertexBuffer };
 		VkDeviceSize offsets[] = { 0 };
 		vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+
+		if (hasIndexBuffer()) {
+			vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, indexType);
+		}
 	}
 
-	void Model::draw(VkCommandBuffer commandBuffer)
+	void Model::draw(VkCommandBuffer commandBuffer, uint32_t instanceCount)
 	{
-		vkCmdDraw(commandBuffer, vertexCount, 1, 0, 0);
+		if (hasIndexBuffer()) {
+			vkCmdDrawIndexed(commandBuffer, indexCount, instanceCount, 0, 0, 0);
+		}
+		else {
+			vkCmdDraw(commandBuffer, vertexCount, instanceCount, 0, 0);
+		}
 	}
 
 	void Model::createVertexBuffers(const std::vector<Vertex>& vertices)
 	{
 		vertexCount = static_cast<uint32_t>(vertices.size());
 		assert(vertexCount >= 3 && "Vertex count must be at least 3");
+		computeBoundingRadius(vertices);
 		VkDeviceSize bufferSize = sizeof(vertices[0]) * vertexCount; // Total number of bits required for our vertex buffer to store all the vertices of our model
+		uploadBuffer(vertices.data(), bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, vertexBuffer, vertexBufferMemory);
+	}
+
+	void Model::updateVertices(const std::vector<Vertex>& vertices)
+	{
+		assert(usage == Usage::Dynamic && "Only dynamic models can be updated, static ones live in device local memory");
+		assert(vertices.size() == vertexCount && "Vertex count of a model can't change");
+
+		computeBoundingRadius(vertices); // The GPU cull reads it for every object using the model
+		VkDeviceSize bufferSize = sizeof(vertices[0]) * vertexCount;
+		memcpy(vertexBufferMemory.mapped, vertices.data(), static_cast<size_t>(bufferSize));
+	}
+
+	void Model::computeBoundingRadius(const std::vector<Vertex>& vertices)
+	{
+		boundingRadius = 0.f;
+		for (const auto& vertex : vertices) {
+			boundingRadius = std::max(boundingRadius, glm::length(vertex.position));
+		}
+	}
+
+	void Model::uploadBuffer(const void* source, VkDeviceSize bufferSize, VkBufferUsageFlags bufferUsage, VkBuffer& buffer, MemoryAllocation& memory)
+	{
 		// HOST: CPU, Device : GPU
 		// VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT: Tells Vulkan that we want that allocated can be accessible from our host. Necessary so that the host can write on our device memory.
 		// VK_MEMORY_PROPERTY_HOST_COHERENT_BIT: Keeps the host and device memory regions consistent with each other, changes are then propagated in one an other.
+		if (usage == Usage::Dynamic) {
+			device.createBuffer(
+				bufferSize,
+				bufferUsage,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				buffer,
+				memory
+			);
+			// The allocator keeps host visible memory mapped, mapped points to the begining of our range
+			// Because of the coherence bit property, the host memory will automaticly be flushed to update the device memory. Otherwise use Flushed() to propagate changes
+			memcpy(memory.mapped, source, static_cast<size_t>(bufferSize));
+			return;
+		}
+
+		// Static data is written once into a host visible staging buffer, then copied by the GPU into device local memory
+		// that the vertex shader reads at full speed instead of across the bus every frame.
+		device.createBuffer(
+			bufferSize,
+			bufferUsage | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			buffer,
+			memory
+		);
+		// The upload service owns the staging buffer and copies on the transfer queue without waiting
+		if (uploadService) {
+			const VkAccessFlags access = bufferUsage & VK_BUFFER_USAGE_INDEX_BUFFER_BIT ? VK_ACCESS_INDEX_READ_BIT : VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+			uploadHandle = uploadService->uploadToBuffer(source, bufferSize, buffer, 0, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, access);
+			return;
+		}
+
+		VkBuffer stagingBuffer;
+		MemoryAllocation stagingBufferMemory;
 		device.createBuffer(
 			bufferSize,
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			vertexBuffer,
-			vertexBufferMemory
+			stagingBuffer,
+			stagingBufferMemory
 		);
-		void* data;
-		// Creates a region of host memory, maped to device memory and sets data to point to the begining of the maped memory range
-		vkMapMemory(device.device(), vertexBufferMemory, 0, bufferSize, 0, &data);
-		// Takes the vertices data and copies it into the host maped memory region
-		// Because of the coherence bit property, the host memory will automaticly be flushed to update the device memory. Otherwise use Flushed() to propagate changes
-		memcpy(data, vertices.data(), static_cast<size_t>(bufferSize));
-		vkUnmapMemory(device.device(), vertexBufferMemory);
+		memcpy(stagingBufferMemory.mapped, source, static_cast<size_t>(bufferSize));
+
+		// Waits for the copy, the staging buffer can be destroyed right after
+		device.copyBuffer(stagingBuffer, buffer, bufferSize);
+
+		vkDestroyBuffer(device.device(), stagingBuffer, nullptr);
+		device.freeMemory(stagingBufferMemory);
+	}
+
+	void Model::createIndexBuffers(const std::vector<uint32_t>& indices)
+	{
+		indexCount = static_cast<uint32_t>(indices.size());
+		if (!hasIndexBuffer()) return;
+		assert(indexCount >= 3 && "Index count must be at least 3");
+
+		// 16 bit indices halve the index buffer whenever every vertex can be addressed with them.
+		// 0xFFFF is left out, it is the primitive restart value.
+		std::vector<uint16_t> shortIndices{};
+		const void* indexData = indices.data();
+		VkDeviceSize bufferSize = sizeof(uint32_t) * indexCount;
+		if (vertexCount <= 0xFFFF) {
+			shortIndices.assign(indices.begin(), indices.end());
+			indexType = VK_INDEX_TYPE_UINT16;
+			indexData = shortIndices.data();
+			bufferSize = sizeof(uint16_t) * indexCount;
+		}
+
+		uploadBuffer(indexData, bufferSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, indexBuffer, indexBufferMemory);
+	}
+
+	void Model::Builder::addVertex(const Vertex& vertex)
+	{
+		auto [it, inserted] = uniqueVertices.try_emplace(vertex, static_cast<uint32_t>(vertices.size()));
+		if (inserted) {
+			vertices.push_back(vertex);
+		}
+		indices.push_back(it->second);
+	}
+
+	void Model::Builder::addTriangle(const Vertex& a, const Vertex& b, const Vertex& c)
+	{
+		addVertex(a);
+		addVertex(b);
+		addVertex(c);
+	}
+
+	size_t Model::Builder::VertexHash::operator()(const Vertex& vertex) const
+	{
+		// Adding 0 turns -0 into +0, they compare equal so they must hash the same
+		const float components[] = {
+			vertex.position.x + 0.f, vertex.position.y + 0.f,
+			vertex.color.x + 0.f, vertex.color.y + 0.f, vertex.color.z + 0.f };
+		size_t seed = 0;
+		for (float component : components) {
+			seed ^= std::hash<float>{}(component) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+		}
+		return seed;
 	}
 
 	/* This binding description correspond to our single vertex buffer. 
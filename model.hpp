@@ -1,12 +1,14 @@
 #pragma once
 
 #include "device.hpp"
+#include "upload_service.hpp"
 
 // libs
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
 
+#include <unordered_map>
 #include <vector>
 
 namespace vraus_VulkanEngine {
@@ -21,9 +23,38 @@ namespace vraus_VulkanEngine {
 			glm::vec3 color;
 			static std::vector<VkVertexInputBindingDescription> getBindingDescriptions();
 			static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
+
+			bool operator==(const Vertex& other) const { return position == other.position && color == other.color; }
+		};
+
+		/* Builds an indexed mesh. Every vertex goes through addVertex, which reuses the index of an identical vertex
+		added before instead of storing it again, so meshes can be written as plain triangle lists.
+		*/
+		struct Builder {
+			std::vector<Vertex> vertices{};
+			std::vector<uint32_t> indices{};
+
+			void addVertex(const Vertex& vertex);
+			void addTriangle(const Vertex& a, const Vertex& b, const Vertex& c);
+
+		private:
+			struct VertexHash {
+				size_t operator()(const Vertex& vertex) const;
+			};
+
+			std::unordered_map<Vertex, uint32_t, VertexHash> uniqueVertices{};
 		};
 
-		Model(Device &device, const std::vector<Vertex> &vertices);
+		// Static models are uploaded once into device local memory. Dynamic ones stay in host visible memory
+		// so updateVertices can rewrite them, at the cost of slower reads by the GPU.
+		enum class Usage { Static, Dynamic };
+
+		// Non indexed, every 3 vertices make a triangle
+		Model(Device &device, const std::vector<Vertex> &vertices, Usage usage = Usage::Static);
+		// Indexed when the builder has indices
+		Model(Device& device, const Builder& builder, Usage usage = Usage::Static);
+		// Static model uploaded through the transfer queue without blocking, not drawable until isReady()
+		Model(Device& device, const Builder& builder, UploadService& uploadService);
 		~Model();
 
 		// We must delete the copy constructor because model class manages the vulkan buffer and memory object
@@ -31,15 +62,43 @@ namespace vraus_VulkanEngine {
 		Model& operator=(const Model&) = delete;
 
 		void bind(VkCommandBuffer commandBuffer);
-		void draw(VkCommandBuffer commandBuffer);
+		void draw(VkCommandBuffer commandBuffer, uint32_t instanceCount = 1);
+
+		// Dynamic models only, same vertex count as at creation. The caller makes sure no frame in flight still reads the model.
+		// The bounding radius follows the new vertices.
+		void updateVertices(const std::vector<Vertex>& vertices);
+		Usage getUsage() const { return usage; }
+		// False while an asynchronous upload of the buffers is in flight
+		bool isReady() const { return !uploadService || uploadService->isReady(uploadHandle); }
+
+		uint32_t getVertexCount() const { return vertexCount; }
+		bool hasIndexBuffer() const { return indexCount > 0; }
+		uint32_t getIndexCount() const { return indexCount; }
+		// Number of vertices the draw call processes, indices when indexed
+		uint32_t getDrawCount() const { return hasIndexBuffer() ? indexCount : vertexCount; }
+		// Radius of the smallest circle centered on the model origin containing every vertex, used for culling
+		float getBoundingRadius() const { return boundingRadius; }
 
 	private: 
 
 		void createVertexBuffers(const std::vector<Vertex>& vertices);
+		void computeBoundingRadius(const std::vector<Vertex>& vertices);
+		void createIndexBuffers(const std::vector<uint32_t>& indices);
+		// Creates the buffer in the memory matching usage and fills it with source
+		void uploadBuffer(const void* source, VkDeviceSize bufferSize, VkBufferUsageFlags bufferUsage, VkBuffer& buffer, MemoryAllocation& memory);
 
 		Device& device;
+		Usage usage;
+		UploadService* uploadService = nullptr;
+		UploadService::Handle uploadHandle = 0;
 		VkBuffer vertexBuffer; // Buffer and its assigned memory are two seperate objects
-		VkDeviceMemory vertexBufferMemory;
+		MemoryAllocation vertexBufferMemory;
 		uint32_t vertexCount;
+		float boundingRadius = 0.f;
+
+		VkBuffer indexBuffer = VK_NULL_HANDLE;
+		MemoryAllocation indexBufferMemory{};
+		uint32_t indexCount = 0;
+		VkIndexType indexType = VK_INDEX_TYPE_UINT32;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,270 @@
+#include "offscreen_target.hpp"
+
+#include "buffer.hpp"
+
+#include <array>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace vraus_VulkanEngine {
+
+	OffscreenTarget::OffscreenTarget(Device& device, VkExtent2D extent) : device{ device }, extent{ extent } {
+		depthFormat = findDepthFormat();
+		createRenderPass();
+		createImages();
+		createFramebuffers();
+		createSyncObjects();
+	}
+
+	OffscreenTarget::~OffscreenTarget() {
+		for (VkFence fence : inFlightFences) {
+			vkDestroyFence(device.device(), fence, nullptr);
+		}
+		for (VkFramebuffer framebuffer : framebuffers) {
+			vkDestroyFramebuffer(device.device(), framebuffer, nullptr);
+		}
+		for (Target& target : targets) {
+			vkDestroyImageView(device.device(), target.colorView, nullptr);
+			vkDestroyImage(device.device(), target.colorImage, nullptr);
+			device.freeMemory(target.colorMemory);
+			vkDestroyImageView(device.device(), target.depthView, nullptr);
+			vkDestroyImage(device.device(), target.depthImage, nullptr);
+			device.freeMemory(target.depthMemory);
+		}
+		vkDestroyRenderPass(device.device(), renderPass, nullptr);
+	}
+
+	VkResult OffscreenTarget::acquireNextImage(uint32_t* imageIndex) {
+		// Nothing to acquire, the image of this frame slot is free once its last frame is done
+		vkWaitForFences(device.device(), 1, &inFlightFences[currentFrame], VK_TRUE, std::numeric_limits<uint64_t>::max());
+		*imageIndex = static_cast<uint32_t>(currentFrame);
+		return VK_SUCCESS;
+	}
+
+	VkResult OffscreenTarget::submitCommandBuffers(const VkCommandBuffer* buffers, uint32_t* imageIndex) {
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = buffers;
+
+		vkResetFences(device.device(), 1, &inFlightFences[*imageIndex]);
+		if (vkQueueSubmit(device.graphicsQueue(), 1, &submitInfo, inFlightFences[*imageIndex]) != VK_SUCCESS) {
+			throw std::runtime_error("failed to submit offscreen draw command buffer!");
+		}
+
+		currentFrame = (currentFrame + 1) % SwapChain::MAX_FRAMES_IN_FLIGHT;
+		return VK_SUCCESS;
+	}
+
+	void OffscreenTarget::readback(uint32_t imageIndex, std::vector<uint8_t>& rgba) {
+		vkWaitForFences(device.device(), 1, &inFlightFences[imageIndex], VK_TRUE, std::numeric_limits<uint64_t>::max());
+
+		const VkDeviceSize size = static_cast<VkDeviceSize>(extent.width) * extent.height * 4;
+		Buffer stagingBuffer{
+			device,
+			size,
+			1,
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT };
+
+		VkCommandBuffer commandBuffer = device.beginSingleTimeCommands();
+
+		VkBufferImageCopy region{};
+		region.bufferOffset = 0;
+		region.bufferRowLength = 0; // Tightly packed
+		region.bufferImageHeight = 0;
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.mipLevel = 0;
+		region.imageSubresource.baseArrayLayer = 0;
+		region.imageSubresource.layerCount = 1;
+		region.imageOffset = { 0, 0, 0 };
+		region.imageExtent = { extent.width, extent.height, 1 };
+		vkCmdCopyImageToBuffer(
+			commandBuffer,
+			targets[imageIndex].colorImage,
+			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			stagingBuffer.getBuffer(),
+			1,
+			&region);
+
+		// Makes the copy visible to the host read below
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		vkCmdPipelineBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_HOST_BIT,
+			0,
+			1, &barrier,
+			0, nullptr,
+			0, nullptr);
+
+		device.endSingleTimeCommands(commandBuffer);
+
+		stagingBuffer.map();
+		rgba.resize(static_cast<size_t>(size));
+		memcpy(rgba.data(), stagingBuffer.getMappedMemory(), rgba.size());
+	}
+
+	void OffscreenTarget::createRenderPass() {
+		VkAttachmentDescription colorAttachment{};
+		colorAttachment.format = COLOR_FORMAT;
+		colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+		colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		colorAttachment.finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL; // Instead of PRESENT_SRC_KHR
+
+		VkAttachmentDescription depthAttachment{};
+		depthAttachment.format = depthFormat;
+		depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+		depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+		VkAttachmentReference colorAttachmentRef{};
+		colorAttachmentRef.attachment = 0;
+		colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+		VkAttachmentReference depthAttachmentRef{};
+		depthAttachmentRef.attachment = 1;
+		depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+		VkSubpassDescription subpass{};
+		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.colorAttachmentCount = 1;
+		subpass.pColorAttachments = &colorAttachmentRef;
+		subpass.pDepthStencilAttachment = &depthAttachmentRef;
+
+		// Same incoming dependency as the SwapChain's render pass
+		std::array<VkSubpassDependency, 2> dependencies{};
+		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[0].srcAccessMask = 0;
+		dependencies[0].srcStageMask =
+			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+		dependencies[0].dstSubpass = 0;
+		dependencies[0].dstStageMask =
+			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+		dependencies[0].dstAccessMask =
+			VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		// The color writes must be available to the readback copy, submitted later on the same queue
+		dependencies[1].srcSubpass = 0;
+		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		dependencies[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+		std::array<VkAttachmentDescription, 2> attachments = { colorAttachment, depthAttachment };
+		VkRenderPassCreateInfo renderPassInfo{};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+		renderPassInfo.pAttachments = attachments.data();
+		renderPassInfo.subpassCount = 1;
+		renderPassInfo.pSubpasses = &subpass;
+		renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+		renderPassInfo.pDependencies = dependencies.data();
+
+		if (vkCreateRenderPass(device.device(), &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create offscreen render pass!");
+		}
+	}
+
+	void OffscreenTarget::createImages() {
+		targets.resize(SwapChain::MAX_FRAMES_IN_FLIGHT);
+
+		VkImageCreateInfo imageInfo{};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.extent.width = extent.width;
+		imageInfo.extent.height = extent.height;
+		imageInfo.extent.depth = 1;
+		imageInfo.mipLevels = 1;
+		imageInfo.arrayLayers = 1;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageInfo.flags = 0;
+
+		for (Target& target : targets) {
+			imageInfo.format = COLOR_FORMAT;
+			imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+			device.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, target.colorImage, target.colorMemory);
+			target.colorView = createImageView(target.colorImage, COLOR_FORMAT, VK_IMAGE_ASPECT_COLOR_BIT);
+
+			imageInfo.format = depthFormat;
+			imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+			device.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, target.depthImage, target.depthMemory);
+			target.depthView = createImageView(target.depthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
+		}
+	}
+
+	void OffscreenTarget::createFramebuffers() {
+		framebuffers.resize(targets.size());
+		for (size_t i = 0; i < targets.size(); i++) {
+			std::array<VkImageView, 2> attachments = { targets[i].colorView, targets[i].depthView };
+
+			VkFramebufferCreateInfo framebufferInfo{};
+			framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+			framebufferInfo.renderPass = renderPass;
+			framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+			framebufferInfo.pAttachments = attachments.data();
+			framebufferInfo.width = extent.width;
+			framebufferInfo.height = extent.height;
+			framebufferInfo.layers = 1;
+
+			if (vkCreateFramebuffer(device.device(), &framebufferInfo, nullptr, &framebuffers[i]) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create offscreen framebuffer!");
+			}
+		}
+	}
+
+	void OffscreenTarget::createSyncObjects() {
+		inFlightFences.resize(SwapChain::MAX_FRAMES_IN_FLIGHT);
+
+		VkFenceCreateInfo fenceInfo{};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+		for (VkFence& fence : inFlightFences) {
+			if (vkCreateFence(device.device(), &fenceInfo, nullptr, &fence) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create offscreen fence!");
+			}
+		}
+	}
+
+	VkImageView OffscreenTarget::createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectMask) {
+		VkImageViewCreateInfo viewInfo{};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = image;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = format;
+		viewInfo.subresourceRange.aspectMask = aspectMask;
+		viewInfo.subresourceRange.baseMipLevel = 0;
+		viewInfo.subresourceRange.levelCount = 1;
+		viewInfo.subresourceRange.baseArrayLayer = 0;
+		viewInfo.subresourceRange.layerCount = 1;
+
+		VkImageView imageView;
+		if (vkCreateImageView(device.device(), &viewInfo, nullptr, &imageView) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create offscreen image view!");
+		}
+		return imageView;
+	}
+
+	VkFormat OffscreenTarget::findDepthFormat() {
+		return device.findSupportedFormat(
+			{ VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT },
+			VK_IMAGE_TILING_OPTIMAL,
+			VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
+	}
+}
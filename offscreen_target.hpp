@@ -0,0 +1,64 @@
+#pragma once
+
+#include "device.hpp"
+#include "swapChain.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace vraus_VulkanEngine {
+	/* Stands in for the SwapChain when there is no window: one color and one depth image per frame in flight,
+	owned by the device and never presented. Frames are only throttled by their fence, so the render path runs
+	as fast as the device allows (CI on lavapipe / llvmpipe, benchmarks).
+	Color images end the render pass in TRANSFER_SRC_OPTIMAL so any finished frame can be read back.
+	*/
+	class OffscreenTarget {
+	public:
+		static constexpr VkFormat COLOR_FORMAT = VK_FORMAT_R8G8B8A8_SRGB; // Readback is already in PNG channel order
+
+		OffscreenTarget(Device& device, VkExtent2D extent);
+		~OffscreenTarget();
+
+		OffscreenTarget(const OffscreenTarget&) = delete;
+		OffscreenTarget& operator=(const OffscreenTarget&) = delete;
+
+		VkFramebuffer getFrameBuffer(int index) { return framebuffers[index]; }
+		VkRenderPass getRenderPass() { return renderPass; }
+		VkExtent2D getExtent() { return extent; }
+		size_t imageCount() { return targets.size(); }
+
+		// Same contract as the SwapChain's, without semaphores or presentation. Always returns VK_SUCCESS.
+		VkResult acquireNextImage(uint32_t* imageIndex);
+		VkResult submitCommandBuffers(const VkCommandBuffer* buffers, uint32_t* imageIndex);
+
+		// Waits for the last frame drawn into imageIndex and copies its color image, tightly packed RGBA rows from the top
+		void readback(uint32_t imageIndex, std::vector<uint8_t>& rgba);
+
+	private:
+		struct Target {
+			VkImage colorImage = VK_NULL_HANDLE;
+			MemoryAllocation colorMemory{};
+			VkImageView colorView = VK_NULL_HANDLE;
+			VkImage depthImage = VK_NULL_HANDLE;
+			MemoryAllocation depthMemory{};
+			VkImageView depthView = VK_NULL_HANDLE;
+		};
+
+		void createRenderPass();
+		void createImages();
+		void createFramebuffers();
+		void createSyncObjects();
+		VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectMask);
+		VkFormat findDepthFormat();
+
+		Device& device;
+		VkExtent2D extent;
+		VkFormat depthFormat;
+		VkRenderPass renderPass = VK_NULL_HANDLE;
+
+		std::vector<Target> targets; // One per frame in flight
+		std::vector<VkFramebuffer> framebuffers;
+		std::vector<VkFence> inFlightFences;
+		size_t currentFrame = 0;
+	};
+}
@@ -0,0 +1,147 @@
+#include "parallel_command_recorder.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+namespace vraus_VulkanEngine {
+
+	ParallelCommandRecorder::ParallelCommandRecorder(Device& device, unsigned int workerCount)
+		: device{ device }, threadPool{ workerCount } {
+		createCommandPools();
+		rangeCommandBuffers.resize(threadCount());
+	}
+
+	ParallelCommandRecorder::~ParallelCommandRecorder() {
+		for (auto& frameCommands : threadCommands) {
+			for (ThreadCommands& commands : frameCommands) {
+				vkDestroyCommandPool(device.device(), commands.commandPool, nullptr); // Frees the command buffers
+			}
+		}
+	}
+
+	void ParallelCommandRecorder::createCommandPools() {
+		VkCommandPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.queueFamilyIndex = device.graphicsQueueFamily();
+		// The whole pool is reset at once, no per buffer reset flag
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+		for (auto& frameCommands : threadCommands) {
+			frameCommands.resize(threadCount());
+			for (ThreadCommands& commands : frameCommands) {
+				if (vkCreateCommandPool(device.device(), &poolInfo, nullptr, &commands.commandPool) != VK_SUCCESS) {
+					throw std::runtime_error("failed to create secondary command pool!");
+				}
+			}
+		}
+	}
+
+	void ParallelCommandRecorder::beginFrame(int frameIndex) {
+		assert(frameIndex >= 0 && frameIndex < SwapChain::MAX_FRAMES_IN_FLIGHT && "Frame index out of range");
+		assert(recorded.empty() && "Secondary command buffers recorded but never executed");
+
+		for (ThreadCommands& commands : threadCommands[frameIndex]) {
+			if (vkResetCommandPool(device.device(), commands.commandPool, 0) != VK_SUCCESS) {
+				throw std::runtime_error("failed to reset secondary command pool!");
+			}
+			commands.usedCount = 0;
+		}
+		currentFrameIndex = frameIndex;
+	}
+
+	void ParallelCommandRecorder::beginRenderPass(VkRenderPass renderPass, VkFramebuffer framebuffer, VkExtent2D extent) {
+		assert(currentFrameIndex >= 0 && "Render pass begun before the first frame");
+		this->renderPass = renderPass;
+		this->framebuffer = framebuffer;
+		this->extent = extent;
+	}
+
+	void ParallelCommandRecorder::record(size_t count, const RangeTask& task) {
+		assert(renderPass != VK_NULL_HANDLE && "Recording before beginRenderPass");
+
+		std::fill(rangeCommandBuffers.begin(), rangeCommandBuffers.end(), VK_NULL_HANDLE);
+		threadPool.parallelFor(count, [&](size_t begin, size_t end, unsigned int threadIndex) {
+			VkCommandBuffer commandBuffer = beginSecondary(threadIndex);
+			task(commandBuffer, begin, end, threadIndex);
+			endSecondary(commandBuffer);
+			rangeCommandBuffers[threadIndex] = commandBuffer;
+		});
+
+		// Ranges left empty recorded nothing
+		for (VkCommandBuffer commandBuffer : rangeCommandBuffers) {
+			if (commandBuffer != VK_NULL_HANDLE) {
+				recorded.push_back(commandBuffer);
+			}
+		}
+	}
+
+	void ParallelCommandRecorder::recordSingle(const SingleTask& task) {
+		assert(renderPass != VK_NULL_HANDLE && "Recording before beginRenderPass");
+
+		// The calling thread is thread 0 of the pool, and record() is done with its pool by now
+		VkCommandBuffer commandBuffer = beginSecondary(0);
+		task(commandBuffer);
+		endSecondary(commandBuffer);
+		recorded.push_back(commandBuffer);
+	}
+
+	void ParallelCommandRecorder::execute(VkCommandBuffer primaryCommandBuffer) {
+		if (recorded.empty()) return;
+
+		vkCmdExecuteCommands(primaryCommandBuffer, static_cast<uint32_t>(recorded.size()), recorded.data());
+		recorded.clear();
+	}
+
+	VkCommandBuffer ParallelCommandRecorder::beginSecondary(unsigned int threadIndex) {
+		ThreadCommands& commands = threadCommands[currentFrameIndex][threadIndex];
+		if (commands.usedCount == commands.commandBuffers.size()) {
+			VkCommandBufferAllocateInfo allocInfo{};
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+			allocInfo.commandPool = commands.commandPool;
+			allocInfo.commandBufferCount = 1;
+
+			VkCommandBuffer commandBuffer;
+			if (vkAllocateCommandBuffers(device.device(), &allocInfo, &commandBuffer) != VK_SUCCESS) {
+				throw std::runtime_error("failed to allocate secondary command buffer!");
+			}
+			commands.commandBuffers.push_back(commandBuffer);
+		}
+		VkCommandBuffer commandBuffer = commands.commandBuffers[commands.usedCount++];
+
+		VkCommandBufferInheritanceInfo inheritanceInfo{};
+		inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+		inheritanceInfo.renderPass = renderPass;
+		inheritanceInfo.subpass = 0;
+		inheritanceInfo.framebuffer = framebuffer;
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		// RENDER_PASS_CONTINUE : Executed entirely inside the render pass of the inheritance info
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		beginInfo.pInheritanceInfo = &inheritanceInfo;
+		if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+			throw std::runtime_error("failed to begin recording secondary command buffer!");
+		}
+
+		// Dynamic state isn't inherited from the primary command buffer
+		VkViewport viewport{};
+		viewport.x = 0.0f;
+		viewport.y = 0.0f;
+		viewport.width = static_cast<float>(extent.width);
+		viewport.height = static_cast<float>(extent.height);
+		viewport.minDepth = 0.0f;
+		viewport.maxDepth = 1.0f;
+		VkRect2D scissor{ {0, 0}, extent };
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+		return commandBuffer;
+	}
+
+	void ParallelCommandRecorder::endSecondary(VkCommandBuffer commandBuffer) {
+		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to record secondary command buffer!");
+		}
+	}
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "device.hpp"
+#include "swapChain.hpp"
+#include "thread_pool.hpp"
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+namespace vraus_VulkanEngine {
+	/* Records the draws of a render pass on several threads at once.
+	Every thread has its own command pool per frame in flight, command pools can't be used by two threads at the same
+	time and a frame's pools can only be reset once the GPU is done with that frame. Threads record secondary command
+	buffers that continue the render pass, the primary command buffer then runs them with vkCmdExecuteCommands.
+	The render pass must be begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS, nothing else can be recorded
+	in the primary until it ends, so draws that aren't split go through recordSingle().
+	Driven from the thread recording the frames.
+	*/
+	class ParallelCommandRecorder {
+	public:
+		using RangeTask = std::function<void(VkCommandBuffer commandBuffer, size_t begin, size_t end, unsigned int threadIndex)>;
+		using SingleTask = std::function<void(VkCommandBuffer commandBuffer)>;
+
+		// Records on workerCount threads plus the calling one
+		ParallelCommandRecorder(Device& device, unsigned int workerCount);
+		~ParallelCommandRecorder();
+
+		ParallelCommandRecorder(const ParallelCommandRecorder&) = delete;
+		ParallelCommandRecorder& operator=(const ParallelCommandRecorder&) = delete;
+
+		unsigned int threadCount() const { return threadPool.threadCount(); }
+
+		// Once per frame after Renderer::beginFrame, which waited for the fence of the frame that last used frameIndex.
+		// Resets that frame's pools.
+		void beginFrame(int frameIndex);
+		// After Renderer::beginSwapChainRenderPass. The secondaries inherit renderPass and framebuffer and set the viewport to extent.
+		void beginRenderPass(VkRenderPass renderPass, VkFramebuffer framebuffer, VkExtent2D extent);
+
+		// Splits [0, count) into one contiguous range per thread, each recorded into its own secondary command buffer.
+		// Blocks until every range is recorded. The ranges are executed in order, as if recorded by a single thread.
+		void record(size_t count, const RangeTask& task);
+		// Records into one secondary command buffer on the calling thread
+		void recordSingle(const SingleTask& task);
+
+		// Executes every secondary recorded since the last execute() in recording order
+		void execute(VkCommandBuffer primaryCommandBuffer);
+
+	private:
+		struct ThreadCommands {
+			VkCommandPool commandPool = VK_NULL_HANDLE;
+			std::vector<VkCommandBuffer> commandBuffers{}; // Allocated once, reused every time the pool is reset
+			size_t usedCount = 0;
+		};
+
+		void createCommandPools();
+		VkCommandBuffer beginSecondary(unsigned int threadIndex);
+		void endSecondary(VkCommandBuffer commandBuffer);
+
+		Device& device;
+		ThreadPool threadPool;
+		// [frame in flight][thread]
+		std::vector<ThreadCommands> threadCommands[SwapChain::MAX_FRAMES_IN_FLIGHT];
+
+		int currentFrameIndex = -1;
+		VkRenderPass renderPass = VK_NULL_HANDLE;
+		VkFramebuffer framebuffer = VK_NULL_HANDLE;
+		VkExtent2D extent{};
+
+		std::vector<VkCommandBuffer> recorded; // In execution order
+		std::vector<VkCommandBuffer> rangeCommandBuffers; // Per thread, for the current record() call
+	};
+}
@@ -2,8 +2,6 @@
 
 #include "model.hpp"
 
-#include <iostream>
-#include <fstream>
 #include <stdexcept>
 #include <cassert>
 
@@ -14,16 +12,30 @@ namespace vraus_VulkanEngine {
 		const std::string& fragFilepath, 
 		const PipelineConfigInfo& configInfo
 	) : device {device} {
-		createGraphicsPipeline(vertFilepath, fragFilepath, configInfo);
+		try {
+			createGraphicsPipeline(vertFilepath, fragFilepath, configInfo);
+		}
+		catch (...) {
+			// No destructor for a constructor that throws, PipelineManager recovers from these so nothing may leak
+			releaseShaderModules();
+			throw;
+		}
 	}
 
 	Pipeline::~Pipeline()
 	{
-		vkDestroyShaderModule(device.device(), vertShaderModule, nullptr);
-		vkDestroyShaderModule(device.device(), fragShaderModule, nullptr);
+		releaseShaderModules();
 		vkDestroyPipeline(device.device(), graphicsPipeline, nullptr);
 	}
 
+	void Pipeline::releaseShaderModules()
+	{
+		if (vertShaderModule != VK_NULL_HANDLE) device.shaderRegistry().release(vertShaderModule);
+		if (fragShaderModule != VK_NULL_HANDLE) device.shaderRegistry().release(fragShaderModule);
+		vertShaderModule = VK_NULL_HANDLE;
+		fragShaderModule = VK_NULL_HANDLE;
+	}
+
 	void Pipeline::bind(VkCommandBuffer commandBuffer)
 	{
 		// VK_PIPELINE_BIND_POINT_GRAPHICS : specifies binding as a graphics pipeline.
@@ -104,41 +116,18 @@ namespace vraus_VulkanEngine {
 		configInfo.dynamicStateInfo.pDynamicStates = configInfo.dynamicStateEnables.data();
 		configInfo.dynamicStateInfo.dynamicStateCount = static_cast<uint32_t>(configInfo.dynamicStateEnables.size());
 		configInfo.dynamicStateInfo.flags = 0;
-	}
-
-	std::vector<char> Pipeline::readFile(const std::string& filepath) {
-		/* bit flag explains
-		* std::iod::ate - When the file opens, we seek the end imediatly. 
-		*	(Makes the size a bit more conveniant)
-		* std::ios::binary - Read the file as a binary.
-		*	Avoid any unwanted text transformation from occuring.
-		*/
-		std::ifstream file{ filepath, std::ios::ate | std::ios::binary };
-
-		if (!file.is_open()) {
-			throw std::runtime_error("failed to open file: " + filepath);
-		}
 
-		// Since we are at the end of the file, file.tellg() will give us the last position hense the file size.
-		size_t fileSize = static_cast<size_t>(file.tellg());
-		std::vector<char> buffer(fileSize);
-
-		file.seekg(0);
-		file.read(buffer.data(), fileSize);
-
-		file.close();
-		return buffer;
+		configInfo.bindingDescriptions = Model::Vertex::getBindingDescriptions();
+		configInfo.attributeDescriptions = Model::Vertex::getAttributeDescriptions();
 	}
 
 	void Pipeline::createGraphicsPipeline(const std::string& vertFilepath, const std::string& fragFilepath, const PipelineConfigInfo& configInfo)
 	{
 		assert(configInfo.pipelineLayout != VK_NULL_HANDLE && "Cannot create graphics pipeline:: no pipelineLayout provided in configInfo");
 		assert(configInfo.renderPass != VK_NULL_HANDLE && "Cannot create graphics pipeline:: no renderPass provided in configInfo");
-		auto vertCode = readFile(vertFilepath);
-		auto fragCode = readFile(fragFilepath);
-
-		createShaderModule(vertCode, &vertShaderModule);
-		createShaderModule(fragCode, &fragShaderModule);
+		// Pipelines using the same shaders share their modules
+		vertShaderModule = device.shaderRegistry().acquire(vertFilepath);
+		fragShaderModule = device.shaderRegistry().acquire(fragFilepath);
 
 		VkPipelineShaderStageCreateInfo shaderStages[2];
 		// Shader Stage of Vertex
@@ -158,8 +147,8 @@ namespace vraus_VulkanEngine {
 		shaderStages[1].pNext = nullptr;
 		shaderStages[1].pSpecializationInfo = nullptr; // Customization of shader functionality
 
-		auto bindingDescriptions = Model::Vertex::getBindingDescriptions();
-		auto attributeDescriptions = Model::Vertex::getAttributeDescriptions();
+		auto& bindingDescriptions = configInfo.bindingDescriptions;
+		auto& attributeDescriptions = configInfo.attributeDescriptions;
 		VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
 		vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
 		vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
@@ -188,21 +177,9 @@ namespace vraus_VulkanEngine {
 		pipelineInfo.basePipelineIndex = -1;
 		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
-		if (vkCreateGraphicsPipelines(device.device(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS) {
+		if (vkCreateGraphicsPipelines(device.device(), device.pipelineCache(), 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS) {
 			throw std::runtime_error("Failed to create graphics pipeline");
 		 }
 
 	}
-
-	void Pipeline::createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule)
-	{
-		VkShaderModuleCreateInfo createInfo{};
-		createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-		createInfo.codeSize = code.size();
-		createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
-
-		if (vkCreateShaderModule(device.device(), &createInfo, nullptr, shaderModule) != VK_SUCCESS) {
-			throw std::runtime_error("Fail to run shader module");
-		}
-	}
 }
\ No newline at end of file
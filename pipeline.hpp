@@ -12,6 +12,9 @@ namespace vraus_VulkanEngine {
 		PipelineConfigInfo(const PipelineConfigInfo&) = delete;
 		PipelineConfigInfo& operator=(const PipelineConfigInfo&) = delete;
 
+		// Vertex buffer layout, defaults to a single Model::Vertex binding. Add bindings with VK_VERTEX_INPUT_RATE_INSTANCE for per instance data.
+		std::vector<VkVertexInputBindingDescription> bindingDescriptions{};
+		std::vector<VkVertexInputAttributeDescription> attributeDescriptions{};
 		VkPipelineViewportStateCreateInfo viewportInfo;
 		VkPipelineInputAssemblyStateCreateInfo inputAssemblyInfo;
 		VkPipelineRasterizationStateCreateInfo rasterizationInfo;
@@ -45,15 +48,13 @@ namespace vraus_VulkanEngine {
 
 		static void defaultPipelineConfigInfo(PipelineConfigInfo& configInfo);
 	private:
-		static std::vector<char> readFile(const std::string& filepath);
 
 		void createGraphicsPipeline(const std::string& vertFilepath, const std::string& fragFilepath, const PipelineConfigInfo& configInfo);
-
-		void createShaderModule(const std::vector<char>& code, VkShaderModule *shaderModule);
+		void releaseShaderModules();
 
 		Device& device;
 		VkPipeline graphicsPipeline;
-		VkShaderModule vertShaderModule;
-		VkShaderModule fragShaderModule;
+		VkShaderModule vertShaderModule = VK_NULL_HANDLE; // Acquired from the device's ShaderRegistry
+		VkShaderModule fragShaderModule = VK_NULL_HANDLE;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,217 @@
+#include "pipeline_manager.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <filesystem>
+#include <iostream>
+
+namespace vraus_VulkanEngine {
+
+	PipelineManager::PipelineManager(Device& device, unsigned int workerCount) : device{ device } {
+		assert(workerCount > 0 && "Pipelines would only compile in wait() without workers");
+		workers.reserve(workerCount);
+		for (unsigned int i = 0; i < workerCount; i++) {
+			workers.emplace_back(&PipelineManager::workerLoop, this);
+		}
+	}
+
+	PipelineManager::~PipelineManager() {
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			stopping = true;
+			queue.clear();
+		}
+		wakeCondition.notify_all();
+		for (std::thread& worker : workers) {
+			worker.join();
+		}
+	}
+
+	std::unique_ptr<PipelineConfigInfo> PipelineManager::createDefaultConfig() {
+		std::unique_ptr<PipelineConfigInfo> config{ new PipelineConfigInfo{} };
+		Pipeline::defaultPipelineConfigInfo(*config);
+		return config;
+	}
+
+	PipelineManager::Handle PipelineManager::request(
+		const std::string& vertFilepath,
+		const std::string& fragFilepath,
+		std::unique_ptr<PipelineConfigInfo> config,
+		Handle fallback)
+	{
+		assert(config != nullptr && "Pipeline requested without a config");
+		assert((fallback == INVALID_HANDLE || fallback < entries.size()) && "Unknown fallback pipeline");
+
+		auto entry = std::make_unique<Entry>();
+		entry->vertFilepath = vertFilepath;
+		entry->fragFilepath = fragFilepath;
+		entry->config = std::move(config);
+		entry->fallback = fallback;
+
+		Handle handle = static_cast<Handle>(entries.size());
+		queueJob({ entry.get(), false });
+		entries.push_back(std::move(entry));
+		return handle;
+	}
+
+	void PipelineManager::queueJob(Job job) {
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			queue.push_back(job);
+		}
+		wakeCondition.notify_one();
+	}
+
+	bool PipelineManager::isReady(Handle handle) const {
+		assert(handle < entries.size() && "Unknown pipeline handle");
+		return entries[handle]->ready.load(std::memory_order_acquire);
+	}
+
+	Pipeline* PipelineManager::get(Handle handle) const {
+		// Fallbacks can have fallbacks too
+		while (handle != INVALID_HANDLE) {
+			const Entry& entry = *entries[handle];
+			if (entry.ready.load(std::memory_order_acquire)) return entry.pipeline.get();
+			handle = entry.fallback;
+		}
+		return nullptr;
+	}
+
+	Pipeline& PipelineManager::wait(Handle handle) {
+		assert(handle < entries.size() && "Unknown pipeline handle");
+		Entry& entry = *entries[handle];
+
+		std::unique_lock<std::mutex> lock{ mutex };
+		auto queued = std::find_if(queue.begin(), queue.end(), [&](const Job& job) { return job.entry == &entry && !job.reload; });
+		if (queued != queue.end()) {
+			Job job = *queued;
+			queue.erase(queued);
+			running++;
+			lock.unlock();
+			compile(job);
+			lock.lock();
+		}
+		doneCondition.wait(lock, [&] { return entry.done; });
+
+		if (entry.error) std::rethrow_exception(entry.error);
+		return *entry.pipeline;
+	}
+
+	void PipelineManager::waitIdle() {
+		std::unique_lock<std::mutex> lock{ mutex };
+		doneCondition.wait(lock, [&] { return queue.empty() && running == 0; });
+	}
+
+	size_t PipelineManager::getPendingCount() const {
+		std::lock_guard<std::mutex> lock{ mutex };
+		return queue.size() + running;
+	}
+
+	void PipelineManager::workerLoop() {
+		while (true) {
+			Job job{};
+			{
+				std::unique_lock<std::mutex> lock{ mutex };
+				wakeCondition.wait(lock, [&] { return stopping || !queue.empty(); });
+				if (stopping) return;
+				job = queue.front();
+				queue.pop_front();
+				running++;
+			}
+			compile(job);
+		}
+	}
+
+	void PipelineManager::compile(Job job) {
+		Entry& entry = *job.entry;
+		if (job.reload) {
+			try {
+				entry.replacement = std::make_unique<Pipeline>(device, entry.vertFilepath, entry.fragFilepath, *entry.config);
+				entry.replacementState.store(REPLACEMENT_READY, std::memory_order_release);
+			}
+			catch (const std::exception& e) {
+				std::cerr << "pipeline " << entry.vertFilepath << " / " << entry.fragFilepath
+					<< " failed to reload, keeping the previous one: " << e.what() << std::endl;
+				entry.replacementState.store(REPLACEMENT_FAILED, std::memory_order_release);
+			}
+
+			{
+				std::lock_guard<std::mutex> lock{ mutex };
+				running--;
+			}
+			doneCondition.notify_all();
+			return;
+		}
+
+		try {
+			entry.pipeline = std::make_unique<Pipeline>(device, entry.vertFilepath, entry.fragFilepath, *entry.config);
+			entry.ready.store(true, std::memory_order_release);
+		}
+		catch (...) {
+			// Left for wait() to rethrow, get() keeps returning the fallback
+			entry.error = std::current_exception();
+			std::cerr << "pipeline " << entry.vertFilepath << " / " << entry.fragFilepath << " failed to compile" << std::endl;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			entry.done = true;
+			running--;
+		}
+		doneCondition.notify_all();
+	}
+
+	void PipelineManager::reload(const std::string& spirvFilepath) {
+		const auto path = std::filesystem::path(spirvFilepath).lexically_normal();
+		for (auto& entry : entries) {
+			if (std::filesystem::path(entry->vertFilepath).lexically_normal() == path ||
+				std::filesystem::path(entry->fragFilepath).lexically_normal() == path) {
+				entry->reloadRequested = true;
+			}
+		}
+	}
+
+	void PipelineManager::beginFrame() {
+		frameCount++;
+		// Renderer::beginFrame waited for the fence of the frame MAX_FRAMES_IN_FLIGHT before this one,
+		// so nothing recorded before the swap is still running
+		while (!retired.empty() && retired.front().releaseFrame <= frameCount) {
+			retired.pop_front();
+		}
+
+		for (auto& entryPointer : entries) {
+			Entry& entry = *entryPointer;
+
+			// Swapped between frames, every draw of a frame uses the same version
+			int state = entry.replacementState.load(std::memory_order_acquire);
+			if (state == REPLACEMENT_READY) {
+				retired.push_back({ std::move(entry.pipeline), frameCount + SwapChain::MAX_FRAMES_IN_FLIGHT });
+				entry.pipeline = std::move(entry.replacement);
+				entry.replacementState.store(REPLACEMENT_NONE, std::memory_order_relaxed);
+				reloadCount++;
+			}
+			else if (state == REPLACEMENT_FAILED) {
+				entry.replacementState.store(REPLACEMENT_NONE, std::memory_order_relaxed);
+			}
+
+			if (!entry.reloadRequested || entry.replacementState.load(std::memory_order_relaxed) != REPLACEMENT_NONE) continue;
+
+			if (entry.ready.load(std::memory_order_acquire)) {
+				entry.reloadRequested = false;
+				entry.replacementState.store(REPLACEMENT_COMPILING, std::memory_order_relaxed);
+				queueJob({ &entry, true });
+				continue;
+			}
+
+			// Never built: compiled again when it failed, left for later while its first compilation runs
+			std::unique_lock<std::mutex> lock{ mutex };
+			if (entry.done) {
+				entry.done = false;
+				entry.error = nullptr;
+				entry.reloadRequested = false;
+				lock.unlock();
+				queueJob({ &entry, false });
+			}
+		}
+	}
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include "device.hpp"
+#include "pipeline.hpp"
+#include "swapChain.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace vraus_VulkanEngine {
+	/* Compiles graphics pipelines on worker threads so creating them never blocks the render loop.
+	request() queues a compilation and returns a handle right away, the handle becomes ready once a worker built the
+	pipeline. Every worker goes through the device's VkPipelineCache and ShaderRegistry, both safe to share.
+	Until a handle is ready get() returns its fallback when it has a ready one, nullptr otherwise and the draw is skipped.
+	request() and get() are called from the thread recording the frames, get() also from threads recording in parallel.
+	Hot reload: reload() rebuilds the pipelines using a rewritten SPIR-V file in the background, the old pipeline keeps
+	being drawn with until beginFrame() swaps the new one in, and is destroyed once no frame in flight can use it.
+	*/
+	class PipelineManager {
+	public:
+		using Handle = uint32_t;
+		static constexpr Handle INVALID_HANDLE = UINT32_MAX;
+
+		PipelineManager(Device& device, unsigned int workerCount);
+		// Queued compilations are dropped, the ones running are finished
+		~PipelineManager();
+
+		PipelineManager(const PipelineManager&) = delete;
+		PipelineManager& operator=(const PipelineManager&) = delete;
+
+		// PipelineConfigInfo points into itself and can't be copied, it is filled in place and handed over with the request
+		static std::unique_ptr<PipelineConfigInfo> createDefaultConfig();
+
+		// The layout and render pass of config must stay alive until the handle is ready.
+		// fallback is drawn with instead while this one compiles, it must be compatible with the same draws.
+		Handle request(
+			const std::string& vertFilepath,
+			const std::string& fragFilepath,
+			std::unique_ptr<PipelineConfigInfo> config,
+			Handle fallback = INVALID_HANDLE);
+
+		bool isReady(Handle handle) const;
+		// The pipeline to draw with this frame: the requested one, its fallback or nullptr
+		Pipeline* get(Handle handle) const;
+		// Blocks until the pipeline is built, compiling it on the calling thread if no worker started it yet.
+		// Rethrows the error of a failed compilation.
+		Pipeline& wait(Handle handle);
+		// Blocks until nothing is queued or compiling, errors are left for wait()
+		void waitIdle();
+
+		size_t getPendingCount() const;
+
+		// Every pipeline using the SPIR-V file at spirvFilepath is compiled again, e.g. after ShaderWatcher rebuilt it.
+		// A pipeline that failed to compile gets another try.
+		void reload(const std::string& spirvFilepath);
+		// Once per frame before recording: swaps in the rebuilt pipelines, queues the pending reloads and destroys the
+		// pipelines replaced SwapChain::MAX_FRAMES_IN_FLIGHT frames ago. Never waits for the device.
+		void beginFrame();
+
+		uint32_t getReloadCount() const { return reloadCount; }
+
+	private:
+		struct Entry {
+			std::string vertFilepath;
+			std::string fragFilepath;
+			std::unique_ptr<PipelineConfigInfo> config;
+			Handle fallback = INVALID_HANDLE;
+
+			std::unique_ptr<Pipeline> pipeline;
+			std::exception_ptr error;
+			std::atomic<bool> ready{ false };
+			bool done = false; // Built or failed, guarded by mutex
+
+			// Hot reload: built by a worker, swapped with pipeline by beginFrame()
+			std::unique_ptr<Pipeline> replacement;
+			std::atomic<int> replacementState{ REPLACEMENT_NONE };
+			bool reloadRequested = false;
+		};
+
+		enum ReplacementState { REPLACEMENT_NONE, REPLACEMENT_COMPILING, REPLACEMENT_READY, REPLACEMENT_FAILED };
+
+		struct Job {
+			Entry* entry;
+			bool reload; // Builds the replacement instead of the pipeline
+		};
+
+		struct RetiredPipeline {
+			std::unique_ptr<Pipeline> pipeline;
+			uint64_t releaseFrame;
+		};
+
+		void workerLoop();
+		void compile(Job job);
+		void queueJob(Job job);
+
+		Device& device;
+		std::vector<std::thread> workers;
+		std::vector<std::unique_ptr<Entry>> entries; // Indexed by handle, entries never move
+
+		mutable std::mutex mutex;
+		std::condition_variable wakeCondition;
+		std::condition_variable doneCondition;
+		std::deque<Job> queue;
+		size_t running = 0;
+		bool stopping = false;
+
+		std::deque<RetiredPipeline> retired; // Still used by frames in flight, in release order
+		uint64_t frameCount = 0;
+		uint32_t reloadCount = 0;
+	};
+}
@@ -0,0 +1,35 @@
+#include "pipeline_state_cache.hpp"
+
+#include <functional>
+
+namespace vraus_VulkanEngine {
+
+	PipelineStateCache::PipelineStateCache(PipelineManager& pipelineManager) : pipelineManager{ pipelineManager } {}
+
+	size_t PipelineStateCache::EntryHash::operator()(const Entry& entry) const {
+		uint64_t value = entry.key.hash();
+		value ^= std::hash<VkPipelineLayout>{}(entry.pipelineLayout) + 0x9E3779B97F4A7C15ull + (value << 6) + (value >> 2);
+		value ^= std::hash<VkRenderPass>{}(entry.renderPass) + 0x9E3779B97F4A7C15ull + (value << 6) + (value >> 2);
+		return static_cast<size_t>(value);
+	}
+
+	PipelineManager::Handle PipelineStateCache::request(
+		const PipelineStateKey& key,
+		VkPipelineLayout pipelineLayout,
+		VkRenderPass renderPass,
+		PipelineManager::Handle fallback)
+	{
+		Entry entry{ key, pipelineLayout, renderPass };
+		auto found = handles.find(entry);
+		if (found != handles.end()) {
+			sharedCount++;
+			return found->second;
+		}
+
+		auto config = PipelineManager::createDefaultConfig();
+		key.toConfigInfo(*config, pipelineLayout, renderPass);
+		PipelineManager::Handle handle = pipelineManager.request(key.vertFilepath, key.fragFilepath, std::move(config), fallback);
+		handles.emplace(std::move(entry), handle);
+		return handle;
+	}
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "pipeline_manager.hpp"
+#include "pipeline_state_key.hpp"
+
+#include <cstdint>
+#include <unordered_map>
+
+namespace vraus_VulkanEngine {
+	/* Hands out one pipeline per distinct state. Render systems asking for the same PipelineStateKey with the same
+	layout and render pass get the same PipelineManager handle, so the VkPipeline is only compiled once.
+	Pipelines live as long as the PipelineManager. Not thread safe, use it from the thread recording the frames.
+	*/
+	class PipelineStateCache {
+	public:
+		PipelineStateCache(PipelineManager& pipelineManager);
+
+		PipelineStateCache(const PipelineStateCache&) = delete;
+		PipelineStateCache& operator=(const PipelineStateCache&) = delete;
+
+		// Compiles the pipeline in the background the first time the state is seen. fallback only applies then.
+		PipelineManager::Handle request(
+			const PipelineStateKey& key,
+			VkPipelineLayout pipelineLayout,
+			VkRenderPass renderPass,
+			PipelineManager::Handle fallback = PipelineManager::INVALID_HANDLE);
+
+		Pipeline* get(PipelineManager::Handle handle) const { return pipelineManager.get(handle); }
+		PipelineManager& getPipelineManager() { return pipelineManager; }
+
+		size_t size() const { return handles.size(); }
+		// Requests answered with an existing pipeline
+		uint32_t getSharedCount() const { return sharedCount; }
+
+	private:
+		struct Entry {
+			PipelineStateKey key;
+			VkPipelineLayout pipelineLayout;
+			VkRenderPass renderPass;
+
+			bool operator==(const Entry& other) const {
+				return pipelineLayout == other.pipelineLayout && renderPass == other.renderPass && key == other.key;
+			}
+		};
+
+		struct EntryHash {
+			size_t operator()(const Entry& entry) const;
+		};
+
+		PipelineManager& pipelineManager;
+		std::unordered_map<Entry, PipelineManager::Handle, EntryHash> handles;
+		uint32_t sharedCount = 0;
+	};
+}
@@ -0,0 +1,291 @@
+#include "pipeline_state_key.hpp"
+
+#include "model.hpp"
+
+#include <stdexcept>
+
+namespace vraus_VulkanEngine {
+
+	static constexpr uint8_t SERIALIZED_VERSION = 1;
+
+	// Writes little endian bytes into a buffer
+	struct ByteWriter {
+		std::vector<uint8_t>& out;
+
+		void u8(uint8_t value) { out.push_back(value); }
+		void u16(uint16_t value) { u8(static_cast<uint8_t>(value)); u8(static_cast<uint8_t>(value >> 8)); }
+		void u32(uint32_t value) { u16(static_cast<uint16_t>(value)); u16(static_cast<uint16_t>(value >> 16)); }
+		void string(const std::string& value) {
+			if (value.size() > UINT16_MAX) throw std::runtime_error("string too long for a pipeline state key");
+			u16(static_cast<uint16_t>(value.size()));
+			out.insert(out.end(), value.begin(), value.end());
+		}
+	};
+
+	// Same bytes as ByteWriter, folded into an FNV-1a 64 hash instead of stored
+	struct HashWriter {
+		uint64_t value = 14695981039346656037ull;
+
+		void u8(uint8_t byte) { value = (value ^ byte) * 1099511628211ull; }
+		void u16(uint16_t word) { u8(static_cast<uint8_t>(word)); u8(static_cast<uint8_t>(word >> 8)); }
+		void u32(uint32_t word) { u16(static_cast<uint16_t>(word)); u16(static_cast<uint16_t>(word >> 16)); }
+		void string(const std::string& text) {
+			u16(static_cast<uint16_t>(text.size()));
+			for (char c : text) u8(static_cast<uint8_t>(c));
+		}
+	};
+
+	struct ByteReader {
+		const uint8_t* data;
+		size_t size;
+		size_t position = 0;
+
+		void require(size_t count) {
+			if (size - position < count) throw std::runtime_error("truncated pipeline state key");
+		}
+		uint8_t u8() { require(1); return data[position++]; }
+		uint16_t u16() { uint16_t low = u8(); return static_cast<uint16_t>(low | (u8() << 8)); }
+		uint32_t u32() { uint32_t low = u16(); return low | (static_cast<uint32_t>(u16()) << 16); }
+		std::string string() {
+			uint16_t length = u16();
+			require(length);
+			std::string value(reinterpret_cast<const char*>(data + position), length);
+			position += length;
+			return value;
+		}
+	};
+
+	// Only the used bindings and attributes are written, unused slots never change the bytes
+	template <typename Writer>
+	static void writeKey(const PipelineStateKey& key, Writer& writer) {
+		writer.u8(SERIALIZED_VERSION);
+		writer.string(key.vertFilepath);
+		writer.string(key.fragFilepath);
+
+		writer.u8(key.bindingCount);
+		for (uint32_t i = 0; i < key.bindingCount; i++) {
+			writer.u8(key.bindings[i].binding);
+			writer.u8(key.bindings[i].inputRate);
+			writer.u16(key.bindings[i].stride);
+		}
+		writer.u8(key.attributeCount);
+		for (uint32_t i = 0; i < key.attributeCount; i++) {
+			writer.u8(key.attributes[i].location);
+			writer.u8(key.attributes[i].binding);
+			writer.u16(key.attributes[i].offset);
+			writer.u32(key.attributes[i].format);
+		}
+
+		writer.u8(key.topology);
+		writer.u8(key.polygonMode);
+		writer.u8(key.cullMode);
+		writer.u8(key.frontFace);
+		writer.u8(key.sampleCount);
+		writer.u8(key.depthTest);
+		writer.u8(key.depthWrite);
+		writer.u8(key.depthCompareOp);
+		writer.u8(key.blendEnable);
+		writer.u8(key.srcColorBlendFactor);
+		writer.u8(key.dstColorBlendFactor);
+		writer.u8(key.colorBlendOp);
+		writer.u8(key.srcAlphaBlendFactor);
+		writer.u8(key.dstAlphaBlendFactor);
+		writer.u8(key.alphaBlendOp);
+		writer.u8(key.colorWriteMask);
+		writer.u32(key.subpass);
+	}
+
+	PipelineStateKey PipelineStateKey::create(const std::string& vertFilepath, const std::string& fragFilepath) {
+		PipelineStateKey key{};
+		key.vertFilepath = vertFilepath;
+		key.fragFilepath = fragFilepath;
+		key.setVertexLayout(Model::Vertex::getBindingDescriptions(), Model::Vertex::getAttributeDescriptions());
+		return key;
+	}
+
+	void PipelineStateKey::setVertexLayout(
+		const std::vector<VkVertexInputBindingDescription>& bindingDescriptions,
+		const std::vector<VkVertexInputAttributeDescription>& attributeDescriptions)
+	{
+		const uint8_t previousBindingCount = bindingCount;
+		const uint8_t previousAttributeCount = attributeCount;
+		bindingCount = 0;
+		attributeCount = 0;
+		try {
+			addVertexLayout(bindingDescriptions, attributeDescriptions);
+		}
+		catch (...) {
+			// addVertexLayout wrote nothing, restoring the counts restores the layout
+			bindingCount = previousBindingCount;
+			attributeCount = previousAttributeCount;
+			throw;
+		}
+	}
+
+	void PipelineStateKey::addVertexLayout(
+		const std::vector<VkVertexInputBindingDescription>& bindingDescriptions,
+		const std::vector<VkVertexInputAttributeDescription>& attributeDescriptions)
+	{
+		if (bindingCount + bindingDescriptions.size() > MAX_VERTEX_BINDINGS ||
+			attributeCount + attributeDescriptions.size() > MAX_VERTEX_ATTRIBUTES) {
+			throw std::runtime_error("vertex layout too large for a pipeline state key");
+		}
+		// The key packs these fields, checked before anything is written so a throw leaves the key unchanged
+		for (const auto& description : bindingDescriptions) {
+			if (description.binding > UINT8_MAX || description.stride > UINT16_MAX) {
+				throw std::runtime_error("vertex binding out of range for a pipeline state key");
+			}
+		}
+		for (const auto& description : attributeDescriptions) {
+			if (description.location > UINT8_MAX || description.binding > UINT8_MAX || description.offset > UINT16_MAX) {
+				throw std::runtime_error("vertex attribute out of range for a pipeline state key");
+			}
+		}
+
+		for (const auto& description : bindingDescriptions) {
+			VertexBinding& binding = bindings[bindingCount++];
+			binding.binding = static_cast<uint8_t>(description.binding);
+			binding.inputRate = static_cast<uint8_t>(description.inputRate);
+			binding.stride = static_cast<uint16_t>(description.stride);
+		}
+		for (const auto& description : attributeDescriptions) {
+			VertexAttribute& attribute = attributes[attributeCount++];
+			attribute.location = static_cast<uint8_t>(description.location);
+			attribute.binding = static_cast<uint8_t>(description.binding);
+			attribute.offset = static_cast<uint16_t>(description.offset);
+			attribute.format = static_cast<uint32_t>(description.format);
+		}
+	}
+
+	void PipelineStateKey::toConfigInfo(PipelineConfigInfo& config, VkPipelineLayout pipelineLayout, VkRenderPass renderPass) const {
+		Pipeline::defaultPipelineConfigInfo(config);
+
+		config.bindingDescriptions.resize(bindingCount);
+		for (uint32_t i = 0; i < bindingCount; i++) {
+			config.bindingDescriptions[i].binding = bindings[i].binding;
+			config.bindingDescriptions[i].stride = bindings[i].stride;
+			config.bindingDescriptions[i].inputRate = static_cast<VkVertexInputRate>(bindings[i].inputRate);
+		}
+		config.attributeDescriptions.resize(attributeCount);
+		for (uint32_t i = 0; i < attributeCount; i++) {
+			config.attributeDescriptions[i].location = attributes[i].location;
+			config.attributeDescriptions[i].binding = attributes[i].binding;
+			config.attributeDescriptions[i].format = static_cast<VkFormat>(attributes[i].format);
+			config.attributeDescriptions[i].offset = attributes[i].offset;
+		}
+
+		config.inputAssemblyInfo.topology = static_cast<VkPrimitiveTopology>(topology);
+		config.rasterizationInfo.polygonMode = static_cast<VkPolygonMode>(polygonMode);
+		config.rasterizationInfo.cullMode = static_cast<VkCullModeFlags>(cullMode);
+		config.rasterizationInfo.frontFace = static_cast<VkFrontFace>(frontFace);
+		config.multisampleInfo.rasterizationSamples = static_cast<VkSampleCountFlagBits>(sampleCount);
+
+		config.depthStencilInfo.depthTestEnable = depthTest ? VK_TRUE : VK_FALSE;
+		config.depthStencilInfo.depthWriteEnable = depthWrite ? VK_TRUE : VK_FALSE;
+		config.depthStencilInfo.depthCompareOp = static_cast<VkCompareOp>(depthCompareOp);
+
+		config.colorBlendAttachment.blendEnable = blendEnable ? VK_TRUE : VK_FALSE;
+		config.colorBlendAttachment.srcColorBlendFactor = static_cast<VkBlendFactor>(srcColorBlendFactor);
+		config.colorBlendAttachment.dstColorBlendFactor = static_cast<VkBlendFactor>(dstColorBlendFactor);
+		config.colorBlendAttachment.colorBlendOp = static_cast<VkBlendOp>(colorBlendOp);
+		config.colorBlendAttachment.srcAlphaBlendFactor = static_cast<VkBlendFactor>(srcAlphaBlendFactor);
+		config.colorBlendAttachment.dstAlphaBlendFactor = static_cast<VkBlendFactor>(dstAlphaBlendFactor);
+		config.colorBlendAttachment.alphaBlendOp = static_cast<VkBlendOp>(alphaBlendOp);
+		config.colorBlendAttachment.colorWriteMask = colorWriteMask;
+
+		config.pipelineLayout = pipelineLayout;
+		config.renderPass = renderPass;
+		config.subpass = subpass;
+	}
+
+	void PipelineStateKey::serialize(std::vector<uint8_t>& out) const {
+		ByteWriter writer{ out };
+		writeKey(*this, writer);
+	}
+
+	size_t PipelineStateKey::deserialize(const uint8_t* data, size_t size, PipelineStateKey& key) {
+		ByteReader reader{ data, size };
+		if (reader.u8() != SERIALIZED_VERSION) {
+			throw std::runtime_error("unsupported pipeline state key version");
+		}
+
+		key = PipelineStateKey{};
+		key.vertFilepath = reader.string();
+		key.fragFilepath = reader.string();
+
+		key.bindingCount = reader.u8();
+		if (key.bindingCount > MAX_VERTEX_BINDINGS) throw std::runtime_error("too many vertex bindings in pipeline state key");
+		for (uint32_t i = 0; i < key.bindingCount; i++) {
+			key.bindings[i].binding = reader.u8();
+			key.bindings[i].inputRate = reader.u8();
+			key.bindings[i].stride = reader.u16();
+		}
+		key.attributeCount = reader.u8();
+		if (key.attributeCount > MAX_VERTEX_ATTRIBUTES) throw std::runtime_error("too many vertex attributes in pipeline state key");
+		for (uint32_t i = 0; i < key.attributeCount; i++) {
+			key.attributes[i].location = reader.u8();
+			key.attributes[i].binding = reader.u8();
+			key.attributes[i].offset = reader.u16();
+			key.attributes[i].format = reader.u32();
+		}
+
+		key.topology = reader.u8();
+		key.polygonMode = reader.u8();
+		key.cullMode = reader.u8();
+		key.frontFace = reader.u8();
+		key.sampleCount = reader.u8();
+		key.depthTest = reader.u8() != 0;
+		key.depthWrite = reader.u8() != 0;
+		key.depthCompareOp = reader.u8();
+		key.blendEnable = reader.u8() != 0;
+		key.srcColorBlendFactor = reader.u8();
+		key.dstColorBlendFactor = reader.u8();
+		key.colorBlendOp = reader.u8();
+		key.srcAlphaBlendFactor = reader.u8();
+		key.dstAlphaBlendFactor = reader.u8();
+		key.alphaBlendOp = reader.u8();
+		key.colorWriteMask = reader.u8();
+		key.subpass = reader.u32();
+		return reader.position;
+	}
+
+	uint64_t PipelineStateKey::hash() const {
+		HashWriter writer{};
+		writeKey(*this, writer);
+		return writer.value;
+	}
+
+	bool PipelineStateKey::operator==(const PipelineStateKey& other) const {
+		if (bindingCount != other.bindingCount || attributeCount != other.attributeCount) return false;
+		for (uint32_t i = 0; i < bindingCount; i++) {
+			const VertexBinding& a = bindings[i];
+			const VertexBinding& b = other.bindings[i];
+			if (a.binding != b.binding || a.inputRate != b.inputRate || a.stride != b.stride) return false;
+		}
+		for (uint32_t i = 0; i < attributeCount; i++) {
+			const VertexAttribute& a = attributes[i];
+			const VertexAttribute& b = other.attributes[i];
+			if (a.location != b.location || a.binding != b.binding || a.offset != b.offset || a.format != b.format) return false;
+		}
+
+		return topology == other.topology &&
+			polygonMode == other.polygonMode &&
+			cullMode == other.cullMode &&
+			frontFace == other.frontFace &&
+			sampleCount == other.sampleCount &&
+			depthTest == other.depthTest &&
+			depthWrite == other.depthWrite &&
+			depthCompareOp == other.depthCompareOp &&
+			blendEnable == other.blendEnable &&
+			srcColorBlendFactor == other.srcColorBlendFactor &&
+			dstColorBlendFactor == other.dstColorBlendFactor &&
+			colorBlendOp == other.colorBlendOp &&
+			srcAlphaBlendFactor == other.srcAlphaBlendFactor &&
+			dstAlphaBlendFactor == other.dstAlphaBlendFactor &&
+			alphaBlendOp == other.alphaBlendOp &&
+			colorWriteMask == other.colorWriteMask &&
+			subpass == other.subpass &&
+			vertFilepath == other.vertFilepath &&
+			fragFilepath == other.fragFilepath;
+	}
+}
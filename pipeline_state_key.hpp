@@ -0,0 +1,91 @@
+#pragma once
+
+#include "pipeline.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace vraus_VulkanEngine {
+	/* Value type description of a graphics pipeline: shaders, vertex layout and fixed function state.
+	Unlike PipelineConfigInfo it has no pointers, so it can be copied, compared, hashed and written to disk.
+	Handles (layout, render pass) are not part of it, they only exist at runtime and are given when lowering.
+	Defaults match Pipeline::defaultPipelineConfigInfo. Viewport and scissor are always dynamic.
+	*/
+	struct PipelineStateKey {
+		static constexpr uint32_t MAX_VERTEX_BINDINGS = 4;
+		static constexpr uint32_t MAX_VERTEX_ATTRIBUTES = 8;
+
+		struct VertexBinding {
+			uint8_t binding = 0;
+			uint8_t inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+			uint16_t stride = 0;
+		};
+
+		struct VertexAttribute {
+			uint8_t location = 0;
+			uint8_t binding = 0;
+			uint16_t offset = 0;
+			uint32_t format = VK_FORMAT_UNDEFINED;
+		};
+
+		std::string vertFilepath;
+		std::string fragFilepath;
+
+		uint8_t bindingCount = 0;
+		uint8_t attributeCount = 0;
+		std::array<VertexBinding, MAX_VERTEX_BINDINGS> bindings{};
+		std::array<VertexAttribute, MAX_VERTEX_ATTRIBUTES> attributes{};
+
+		uint8_t topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+		uint8_t polygonMode = VK_POLYGON_MODE_FILL;
+		uint8_t cullMode = VK_CULL_MODE_NONE;
+		uint8_t frontFace = VK_FRONT_FACE_CLOCKWISE;
+		uint8_t sampleCount = VK_SAMPLE_COUNT_1_BIT;
+
+		bool depthTest = true;
+		bool depthWrite = true;
+		uint8_t depthCompareOp = VK_COMPARE_OP_LESS;
+
+		bool blendEnable = false;
+		uint8_t srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+		uint8_t dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
+		uint8_t colorBlendOp = VK_BLEND_OP_ADD;
+		uint8_t srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+		uint8_t dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+		uint8_t alphaBlendOp = VK_BLEND_OP_ADD;
+		uint8_t colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+		uint32_t subpass = 0;
+
+		// Model::Vertex layout, the rest defaulted
+		static PipelineStateKey create(const std::string& vertFilepath, const std::string& fragFilepath);
+
+		// Replaces the vertex layout, throws past MAX_VERTEX_BINDINGS or MAX_VERTEX_ATTRIBUTES and leaves the key unchanged
+		void setVertexLayout(
+			const std::vector<VkVertexInputBindingDescription>& bindingDescriptions,
+			const std::vector<VkVertexInputAttributeDescription>& attributeDescriptions);
+		// Appends to the vertex layout, e.g. a per instance binding
+		void addVertexLayout(
+			const std::vector<VkVertexInputBindingDescription>& bindingDescriptions,
+			const std::vector<VkVertexInputAttributeDescription>& attributeDescriptions);
+
+		// Fills config for Pipeline, which turns it into the VkGraphicsPipelineCreateInfo
+		void toConfigInfo(PipelineConfigInfo& config, VkPipelineLayout pipelineLayout, VkRenderPass renderPass) const;
+
+		// Byte exact and independent of padding and endianness. Equal keys serialize to the same bytes.
+		void serialize(std::vector<uint8_t>& out) const;
+		// Reads a key written by serialize() at data, returns the number of bytes read. Throws on malformed data.
+		static size_t deserialize(const uint8_t* data, size_t size, PipelineStateKey& key);
+
+		uint64_t hash() const;
+		bool operator==(const PipelineStateKey& other) const;
+		bool operator!=(const PipelineStateKey& other) const { return !(*this == other); }
+	};
+
+	struct PipelineStateKeyHash {
+		size_t operator()(const PipelineStateKey& key) const { return static_cast<size_t>(key.hash()); }
+	};
+}
@@ -0,0 +1,117 @@
+#include "png_writer.hpp"
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <stdexcept>
+
+namespace vraus_VulkanEngine {
+
+	static uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0) {
+		static const std::array<uint32_t, 256> table = [] {
+			std::array<uint32_t, 256> t{};
+			for (uint32_t n = 0; n < 256; n++) {
+				uint32_t c = n;
+				for (int k = 0; k < 8; k++) {
+					c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+				}
+				t[n] = c;
+			}
+			return t;
+		}();
+
+		crc = ~crc;
+		for (size_t i = 0; i < size; i++) {
+			crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+		}
+		return ~crc;
+	}
+
+	static uint32_t adler32(const std::vector<uint8_t>& data) {
+		uint32_t a = 1;
+		uint32_t b = 0;
+		for (uint8_t byte : data) {
+			a = (a + byte) % 65521;
+			b = (b + a) % 65521;
+		}
+		return (b << 16) | a;
+	}
+
+	static void appendBigEndian(std::vector<uint8_t>& out, uint32_t value) {
+		out.push_back(static_cast<uint8_t>(value >> 24));
+		out.push_back(static_cast<uint8_t>(value >> 16));
+		out.push_back(static_cast<uint8_t>(value >> 8));
+		out.push_back(static_cast<uint8_t>(value));
+	}
+
+	static void writeChunk(std::ofstream& file, const char type[4], const std::vector<uint8_t>& data) {
+		std::vector<uint8_t> chunk{};
+		chunk.reserve(data.size() + 12);
+		appendBigEndian(chunk, static_cast<uint32_t>(data.size()));
+		chunk.insert(chunk.end(), type, type + 4);
+		chunk.insert(chunk.end(), data.begin(), data.end());
+		// The CRC covers the type and the data, not the length
+		appendBigEndian(chunk, crc32(chunk.data() + 4, data.size() + 4));
+		file.write(reinterpret_cast<const char*>(chunk.data()), static_cast<std::streamsize>(chunk.size()));
+	}
+
+	void writePng(const std::string& filepath, uint32_t width, uint32_t height, const std::vector<uint8_t>& rgba) {
+		const size_t rowSize = static_cast<size_t>(width) * 4;
+		if (rgba.size() != rowSize * height) {
+			throw std::runtime_error("PNG pixel data doesn't match its size: " + filepath);
+		}
+
+		std::ofstream file{ filepath, std::ios::binary | std::ios::trunc };
+		if (!file) {
+			throw std::runtime_error("failed to open file: " + filepath);
+		}
+
+		static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+		file.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+
+		std::vector<uint8_t> header{};
+		appendBigEndian(header, width);
+		appendBigEndian(header, height);
+		header.push_back(8); // Bit depth
+		header.push_back(6); // Color type RGBA
+		header.push_back(0); // Compression, filter and interlace methods
+		header.push_back(0);
+		header.push_back(0);
+		writeChunk(file, "IHDR", header);
+
+		// Every row starts with its filter type, 0 is none
+		std::vector<uint8_t> scanlines{};
+		scanlines.reserve((rowSize + 1) * height);
+		for (uint32_t y = 0; y < height; y++) {
+			scanlines.push_back(0);
+			scanlines.insert(scanlines.end(), rgba.begin() + y * rowSize, rgba.begin() + (y + 1) * rowSize);
+		}
+
+		// zlib stream of stored deflate blocks, 65535 bytes at most each
+		constexpr size_t MAX_BLOCK_SIZE = 65535;
+		std::vector<uint8_t> compressed{};
+		compressed.reserve(scanlines.size() + (scanlines.size() / MAX_BLOCK_SIZE + 1) * 5 + 6);
+		compressed.push_back(0x78); // Deflate with a 32K window
+		compressed.push_back(0x01); // Makes the header a multiple of 31
+		size_t offset = 0;
+		do {
+			const size_t blockSize = std::min(MAX_BLOCK_SIZE, scanlines.size() - offset);
+			const bool lastBlock = offset + blockSize == scanlines.size();
+			compressed.push_back(lastBlock ? 1 : 0);
+			compressed.push_back(static_cast<uint8_t>(blockSize));
+			compressed.push_back(static_cast<uint8_t>(blockSize >> 8));
+			compressed.push_back(static_cast<uint8_t>(~blockSize));
+			compressed.push_back(static_cast<uint8_t>(~blockSize >> 8));
+			compressed.insert(compressed.end(), scanlines.begin() + offset, scanlines.begin() + offset + blockSize);
+			offset += blockSize;
+		} while (offset < scanlines.size());
+		appendBigEndian(compressed, adler32(scanlines));
+		writeChunk(file, "IDAT", compressed);
+
+		writeChunk(file, "IEND", {});
+
+		if (!file) {
+			throw std::runtime_error("failed to write file: " + filepath);
+		}
+	}
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace vraus_VulkanEngine {
+	// Writes 8 bit RGBA pixels, rows from the top, as a PNG file. Throws when the file can't be written.
+	// The image data is stored uncompressed (deflate "stored" blocks), which every decoder reads and needs no zlib.
+	void writePng(const std::string& filepath, uint32_t width, uint32_t height, const std::vector<uint8_t>& rgba);
+}
@@ -0,0 +1,131 @@
+#include "quad_tree.hpp"
+
+#include <array>
+#include <cassert>
+
+namespace vraus_VulkanEngine {
+
+	void QuadTree::build(const float* x, const float* y, const float* mass, size_t count)
+	{
+		nodes.clear();
+		bodyX = x;
+		bodyY = y;
+		bodyMass = mass;
+		if (count == 0) return;
+
+		// The root is the smallest square containing every body
+		glm::vec2 minBound{ x[0], y[0] };
+		glm::vec2 maxBound{ x[0], y[0] };
+		for (size_t i = 1; i < count; i++) {
+			minBound = glm::min(minBound, glm::vec2{ x[i], y[i] });
+			maxBound = glm::max(maxBound, glm::vec2{ x[i], y[i] });
+		}
+
+		Node root{};
+		root.center = .5f * (minBound + maxBound);
+		// Slightly bigger than the bounds so that bodies sitting on the border still fall inside
+		root.halfSize = .5f * glm::max(maxBound.x - minBound.x, maxBound.y - minBound.y) * 1.001f + 1e-6f;
+		nodes.reserve(2 * count + 1);
+		nodes.push_back(root);
+
+		for (size_t i = 0; i < count; i++) {
+			insert(static_cast<int>(i), { x[i], y[i] }, mass[i]);
+		}
+
+		// Until now centerOfMass held the sum of mass * position, turn it into an actual position
+		for (auto& node : nodes) {
+			node.centerOfMass = node.mass > 0.f ? node.centerOfMass / node.mass : node.center;
+		}
+	}
+
+	glm::vec2 QuadTree::computeAcceleration(glm::vec2 position, float strength, float theta) const
+	{
+		glm::vec2 acceleration{};
+		if (nodes.empty()) return acceleration;
+
+		const float thetaSquared = theta * theta;
+
+		// Depth first traversal, a node pushes at most 4 children per level so this can never overflow
+		std::array<int, 4 * MAX_DEPTH + 4> stack;
+		int stackSize = 0;
+		stack[stackSize++] = 0;
+
+		while (stackSize > 0) {
+			const Node& node = nodes[stack[--stackSize]];
+			if (node.mass <= 0.f) continue;
+
+			glm::vec2 offset = node.centerOfMass - position;
+			float distanceSquared = glm::dot(offset, offset);
+
+			// Leaf, or far enough (s / d < theta) to treat the whole node as one body
+			float size = 2.f * node.halfSize;
+			if (node.firstChild == EMPTY || size * size < thetaSquared * distanceSquared) {
+				// Same rule as GravityPhysicsSystem::computeForce, which also skips the body itself
+				if (distanceSquared < 1e-10f) continue;
+				acceleration += strength * node.mass * offset / (distanceSquared * glm::sqrt(distanceSquared));
+				continue;
+			}
+
+			for (int i = 0; i < 4; i++) {
+				stack[stackSize++] = node.firstChild + i;
+			}
+		}
+		return acceleration;
+	}
+
+	void QuadTree::insert(int bodyIndex, glm::vec2 position, float bodyMassValue)
+	{
+		int nodeIndex = 0;
+		for (int depth = 0; ; depth++) {
+			// Every node on the way down contains the new body
+			nodes[nodeIndex].mass += bodyMassValue;
+			nodes[nodeIndex].centerOfMass += bodyMassValue * position;
+
+			if (nodes[nodeIndex].firstChild == EMPTY) {
+				if (nodes[nodeIndex].body == EMPTY) {
+					nodes[nodeIndex].body = bodyIndex;
+					return;
+				}
+				if (depth >= MAX_DEPTH) {
+					nodes[nodeIndex].body = AGGREGATE;
+					return;
+				}
+
+				// The leaf already holds a body, push it one level down before continuing with the new one.
+				// subdivide() may reallocate the vector, so nodes are always accessed by index here.
+				int existing = nodes[nodeIndex].body;
+				glm::vec2 existingPosition{ bodyX[existing], bodyY[existing] };
+				subdivide(nodeIndex);
+
+				Node& child = nodes[nodes[nodeIndex].firstChild + childFor(nodes[nodeIndex], existingPosition)];
+				child.body = existing;
+				child.mass = bodyMass[existing];
+				child.centerOfMass = bodyMass[existing] * existingPosition;
+				nodes[nodeIndex].body = EMPTY;
+			}
+
+			nodeIndex = nodes[nodeIndex].firstChild + childFor(nodes[nodeIndex], position);
+		}
+	}
+
+	void QuadTree::subdivide(int nodeIndex)
+	{
+		const glm::vec2 center = nodes[nodeIndex].center;
+		const float quarter = .5f * nodes[nodeIndex].halfSize;
+		const int firstChild = static_cast<int>(nodes.size());
+
+		// Child i covers the quadrant where (x >= center.x) == (i & 1) and (y >= center.y) == (i & 2)
+		for (int i = 0; i < 4; i++) {
+			Node child{};
+			child.center = center + glm::vec2{ (i & 1) ? quarter : -quarter, (i & 2) ? quarter : -quarter };
+			child.halfSize = quarter;
+			nodes.push_back(child);
+		}
+		nodes[nodeIndex].firstChild = firstChild;
+	}
+
+	int QuadTree::childFor(const Node& node, glm::vec2 position) const
+	{
+		return (position.x >= node.center.x ? 1 : 0) | (position.y >= node.center.y ? 2 : 0);
+	}
+}
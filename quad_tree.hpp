@@ -0,0 +1,52 @@
+#pragma once
+
+// libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <vector>
+
+namespace vraus_VulkanEngine {
+	/* Barnes-Hut quadtree. Every node stores the total mass and the center of mass of the bodies it contains,
+	so a far enough group of bodies can be approximated by a single body when computing gravitational attraction.
+	The tree is meant to be rebuilt from scratch every simulation step, nodes are kept in one flat vector to make that cheap.
+	*/
+	class QuadTree {
+	public:
+		// Past this depth bodies are merged into the same leaf (only happens when bodies are almost on top of each other)
+		static constexpr int MAX_DEPTH = 48;
+
+		void build(const float* x, const float* y, const float* mass, size_t count);
+
+		// Returns the gravitational acceleration felt by a body at the given position.
+		// theta is the opening angle: a node of width s at distance d is treated as a single body when s / d < theta.
+		// theta = 0 degenerates into the exact pairwise sum.
+		glm::vec2 computeAcceleration(glm::vec2 position, float strength, float theta) const;
+
+		size_t nodeCount() const { return nodes.size(); }
+
+	private:
+		static constexpr int EMPTY = -1;
+		static constexpr int AGGREGATE = -2; // Leaf at MAX_DEPTH holding more than one body
+
+		struct Node {
+			glm::vec2 center{};
+			float halfSize = 0.f;
+			float mass = 0.f;
+			glm::vec2 centerOfMass{}; // Holds the sum of mass * position while the tree is being built
+			int firstChild = EMPTY; // The 4 children are stored next to each other
+			int body = EMPTY;
+		};
+
+		void insert(int bodyIndex, glm::vec2 position, float bodyMassValue);
+		void subdivide(int nodeIndex);
+		int childFor(const Node& node, glm::vec2 position) const;
+
+		std::vector<Node> nodes;
+		const float* bodyX = nullptr;
+		const float* bodyY = nullptr;
+		const float* bodyMass = nullptr;
+	};
+}
@@ -0,0 +1,144 @@
+#include "render_queue.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <numeric>
+
+namespace vraus_VulkanEngine {
+
+	namespace {
+		// Hands out ids in first submission order, stopping at the largest id once they run out
+		template<typename Id, typename Object>
+		Id assignId(std::unordered_map<const Object*, Id>& ids, const Object* object) {
+			constexpr size_t ID_COUNT = size_t(std::numeric_limits<Id>::max()) + 1;
+			auto found = ids.find(object);
+			if (found != ids.end()) return found->second;
+			assert(ids.size() < ID_COUNT && "Too many distinct objects in one flush, ids are shared past this point");
+			return ids.emplace(object, static_cast<Id>(std::min(ids.size(), ID_COUNT - 1))).first->second;
+		}
+	}
+
+	void RenderQueue::KeySorter::sort(std::vector<uint64_t>& keys) {
+		const size_t count = keys.size();
+		order.resize(count);
+		scratchKeys.resize(count);
+		scratchOrder.resize(count);
+		std::iota(order.begin(), order.end(), 0u);
+
+		for (int shift = 0; shift < 64; shift += 8) {
+			size_t histogram[256]{};
+			for (size_t i = 0; i < count; i++) {
+				histogram[(keys[i] >> shift) & 0xFF]++;
+			}
+			if (count == 0 || histogram[(keys[0] >> shift) & 0xFF] == count) continue;
+
+			size_t offset = 0;
+			for (size_t& bucket : histogram) {
+				size_t bucketCount = bucket;
+				bucket = offset;
+				offset += bucketCount;
+			}
+			for (size_t i = 0; i < count; i++) {
+				size_t destination = histogram[(keys[i] >> shift) & 0xFF]++;
+				scratchKeys[destination] = keys[i];
+				scratchOrder[destination] = order[i];
+			}
+			keys.swap(scratchKeys);
+			order.swap(scratchOrder);
+		}
+	}
+
+	uint64_t RenderQueue::makeKey(uint8_t pipelineId, uint16_t modelId, uint16_t material, float depth) {
+		if (std::isnan(depth)) depth = 0.f; // Converting NaN to an integer is undefined
+		const uint64_t depthBits = static_cast<uint64_t>(std::clamp(depth, 0.f, 1.f) * 0xFFFFFF);
+		return (static_cast<uint64_t>(pipelineId) << 56) |
+			(static_cast<uint64_t>(modelId) << 40) |
+			(static_cast<uint64_t>(material) << 24) |
+			depthBits;
+	}
+
+	RenderQueue::DrawPacket& RenderQueue::submit(
+		Pipeline& pipeline, VkPipelineLayout pipelineLayout, Model& model, uint16_t material, float depth)
+	{
+		const uint8_t pipelineId = assignId(pipelineIds, static_cast<const Pipeline*>(&pipeline));
+		const uint16_t modelId = assignId(modelIds, static_cast<const Model*>(&model));
+
+		DrawPacket& packet = packets.emplace_back();
+		packet.key = makeKey(pipelineId, modelId, material, depth);
+		packet.pipeline = &pipeline;
+		packet.pipelineLayout = pipelineLayout;
+		packet.model = &model;
+		return packet;
+	}
+
+	void RenderQueue::setPushConstants(DrawPacket& packet, VkShaderStageFlags stages, const void* data, uint32_t size) {
+		assert(size <= MAX_PUSH_CONSTANT_SIZE && "Push constants too large for a draw packet");
+		packet.pushConstantStages = stages;
+		packet.pushConstantSize = size;
+		memcpy(packet.pushConstants.data(), data, size);
+	}
+
+	void RenderQueue::clear() {
+		packets.clear();
+		pipelineIds.clear();
+		modelIds.clear();
+	}
+
+	void RenderQueue::flush(VkCommandBuffer commandBuffer) {
+		// Pipeline binds without the queue: one whenever the pipeline changes in submission order
+		uint32_t submissionPipelineBinds = 0;
+		sortKeys.resize(packets.size());
+		for (size_t i = 0; i < packets.size(); i++) {
+			if (i == 0 || packets[i].pipeline != packets[i - 1].pipeline) submissionPipelineBinds++;
+			sortKeys[i] = packets[i].key;
+		}
+		sorter.sort(sortKeys);
+
+		uint32_t pipelineBinds = 0;
+		Pipeline* boundPipeline = nullptr;
+		Model* boundModel = nullptr;
+		for (uint32_t index : sorter.getOrder()) {
+			DrawPacket& packet = packets[index];
+
+			if (packet.pipeline != boundPipeline) {
+				packet.pipeline->bind(commandBuffer);
+				boundPipeline = packet.pipeline;
+				pipelineBinds++;
+			}
+
+			if (packet.model != boundModel) {
+				packet.model->bind(commandBuffer);
+				boundModel = packet.model;
+				stats.modelBinds++;
+			}
+			else {
+				stats.modelBindsSaved++;
+			}
+
+			if (packet.instanceBuffer != VK_NULL_HANDLE) {
+				vkCmdBindVertexBuffers(commandBuffer, packet.instanceBinding, 1, &packet.instanceBuffer, &packet.instanceOffset);
+			}
+			if (packet.pushConstantSize > 0) {
+				vkCmdPushConstants(
+					commandBuffer,
+					packet.pipelineLayout,
+					packet.pushConstantStages,
+					0,
+					packet.pushConstantSize,
+					packet.pushConstants.data());
+			}
+
+			packet.model->draw(commandBuffer, packet.instanceCount);
+			stats.drawCalls++;
+		}
+
+		stats.pipelineBinds += pipelineBinds;
+		// Shared ids can interleave pipelines and bind more often than the submission order did
+		if (submissionPipelineBinds > pipelineBinds) stats.pipelineBindsSaved += submissionPipelineBinds - pipelineBinds;
+		stats.packets += static_cast<uint32_t>(packets.size());
+		clear();
+	}
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "pipeline.hpp"
+#include "model.hpp"
+
+#include <array>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace vraus_VulkanEngine {
+	/* Collects the draws of a frame as packets, sorts them by a 64 bit key and records them while skipping
+	pipeline and vertex buffer binds that are already in place.
+	Key layout, most significant first: pipeline (8 bits) | model (16 bits) | material (16 bits) | depth (24 bits).
+	Pipelines and models get their id the first time they are submitted after a flush, so a flush holds at most 256
+	pipelines and 65536 models. Past that the ids stop at the maximum (and assert in debug): binds compare the actual
+	objects, so sharing an id only costs some extra binds.
+	The sort is stable, packets with equal keys are recorded in submission order.
+	*/
+	class RenderQueue {
+	public:
+		static constexpr uint32_t MAX_PUSH_CONSTANT_SIZE = 128; // Minimum maxPushConstantsSize guaranteed by Vulkan
+
+		struct DrawPacket {
+			uint64_t key = 0;
+			Pipeline* pipeline = nullptr;
+			VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+			Model* model = nullptr;
+			uint32_t instanceCount = 1;
+			// Optional per instance vertex buffer bound at instanceBinding
+			VkBuffer instanceBuffer = VK_NULL_HANDLE;
+			VkDeviceSize instanceOffset = 0;
+			uint32_t instanceBinding = 1;
+			VkShaderStageFlags pushConstantStages = 0;
+			uint32_t pushConstantSize = 0;
+			std::array<uint8_t, MAX_PUSH_CONSTANT_SIZE> pushConstants;
+		};
+
+		/* Stable LSD radix sort of 64 bit keys, one byte per pass. Passes where every key has the same byte are skipped,
+		with few pipelines and no depth most of the 8 passes are. Storage is kept between sorts.
+		*/
+		class KeySorter {
+		public:
+			// Sorts keys in place, getOrder()[i] is then the index keys[i] had before the sort
+			void sort(std::vector<uint64_t>& keys);
+			const std::vector<uint32_t>& getOrder() const { return order; }
+
+		private:
+			std::vector<uint32_t> order;
+			std::vector<uint64_t> scratchKeys;
+			std::vector<uint32_t> scratchOrder;
+		};
+
+		// Counted over every flush since the last resetStats(). Binds are saved against recording the packets in
+		// submission order, binding the pipeline when it changes and the model for every packet.
+		struct Stats {
+			uint32_t packets = 0;
+			uint32_t drawCalls = 0;
+			uint32_t pipelineBinds = 0;
+			uint32_t pipelineBindsSaved = 0;
+			uint32_t modelBinds = 0;
+			uint32_t modelBindsSaved = 0;
+
+			uint32_t bindsSaved() const { return pipelineBindsSaved + modelBindsSaved; }
+
+			Stats& operator+=(const Stats& other) {
+				packets += other.packets;
+				drawCalls += other.drawCalls;
+				pipelineBinds += other.pipelineBinds;
+				pipelineBindsSaved += other.pipelineBindsSaved;
+				modelBinds += other.modelBinds;
+				modelBindsSaved += other.modelBindsSaved;
+				return *this;
+			}
+		};
+
+		// depth in [0, 1], smaller is drawn first within the same pipeline, model and material. NaN sorts as 0.
+		static uint64_t makeKey(uint8_t pipelineId, uint16_t modelId, uint16_t material, float depth);
+
+		// Returns the packet so the caller can fill push constants or an instance buffer
+		DrawPacket& submit(Pipeline& pipeline, VkPipelineLayout pipelineLayout, Model& model, uint16_t material = 0, float depth = 0.f);
+		void setPushConstants(DrawPacket& packet, VkShaderStageFlags stages, const void* data, uint32_t size);
+
+		// Sorts and records every packet, then empties the queue
+		void flush(VkCommandBuffer commandBuffer);
+		void clear();
+
+		size_t size() const { return packets.size(); }
+		const Stats& getStats() const { return stats; }
+		void resetStats() { stats = {}; }
+		// Adds what other queues recorded, e.g. the per thread queues of a parallel recording
+		void addStats(const Stats& other) { stats += other; }
+
+	private:
+		std::vector<DrawPacket> packets;
+		std::unordered_map<const Pipeline*, uint8_t> pipelineIds;
+		std::unordered_map<const Model*, uint16_t> modelIds;
+		Stats stats{};
+
+		// Kept between frames
+		std::vector<uint64_t> sortKeys;
+		KeySorter sorter;
+	};
+}
@@ -1,22 +1,33 @@
 #include "renderer.hpp"
 
+#include "png_writer.hpp"
+
 #include <stdexcept>
 #include <array>
 
 namespace vraus_VulkanEngine {
 
-	Renderer::Renderer(Window& _window, Device& _device) : window{ _window }, device{ _device } {
+	Renderer::Renderer(Window& _window, Device& _device) : window{ &_window }, device{ _device }, frameRing{ _device } {
 		recreateSwapChain();
 		createCommandBuffers();
 	}
 
+	Renderer::Renderer(Device& _device, VkExtent2D extent) : window{ nullptr }, device{ _device }, frameRing{ _device } {
+		assert(device.isHeadless() && "A headless renderer needs a headless device");
+		offscreenTarget = std::make_unique<OffscreenTarget>(device, extent);
+		createCommandBuffers();
+	}
+
 	Renderer::~Renderer() { freeCommandBuffers(); } // It is possible that the renderer will be destroyed but not the application
 
 	VkCommandBuffer Renderer::beginFrame()
 	{
 		assert(!isFrameStarted && "Can't call beginFrame while already in progress.");
 
-		auto result = swapChain->acquireNextImage(&currentImageIndex);
+		// The offscreen target never goes out of date
+		auto result = isHeadless() ?
+			offscreenTarget->acquireNextImage(&currentImageIndex) :
+			swapChain->acquireNextImage(&currentImageIndex);
 
 		// VK_ERROR_OUT_OF_DATE_KHR: A surface has changed in such a way that is is no longer compatible with the swapchain,
 		// and further presentation requests using the swapchain will fail. Applications MUST query the new surface properties
@@ -31,6 +42,7 @@ namespace vraus_VulkanEngine {
 		}
 
 		isFrameStarted = true;
+		frameRing.beginFrame(currentFrameIndex); // acquireNextImage waited for this frame's fence
 
 		auto commandBuffer = getCurrentCommandBuffer();
 		VkCommandBufferBeginInfo beginInfo{};
@@ -55,33 +67,40 @@ namespace vraus_VulkanEngine {
 		// Submit the provided command buffer to the device graphics queue, while handling CPU & GPU synchronization
 		// The command buffer will then be executed
 		// The swap chain will present the associated color attachment image view to the display at the appropriate time, based on the present mode selected
-		auto result = swapChain->submitCommandBuffers(&commandBuffer, &currentImageIndex);
-		// VK_SUBOPTIMAL_KHR: A swapchain no longer matches the surface properties exactly
-		// but CAN still be used to present to the surface successfully.
-		if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || window.wasWindowResized()) {
-			window.resetWindowResizedFlag();
-			recreateSwapChain();
+		if (isHeadless()) {
+			offscreenTarget->submitCommandBuffers(&commandBuffer, &currentImageIndex);
 		}
-		else if (result != VK_SUCCESS) {
-			throw std::runtime_error("Failed to present swap chain image");
+		else {
+			auto result = swapChain->submitCommandBuffers(&commandBuffer, &currentImageIndex);
+			// VK_SUBOPTIMAL_KHR: A swapchain no longer matches the surface properties exactly
+			// but CAN still be used to present to the surface successfully.
+			if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || window->wasWindowResized()) {
+				window->resetWindowResizedFlag();
+				recreateSwapChain();
+			}
+			else if (result != VK_SUCCESS) {
+				throw std::runtime_error("Failed to present swap chain image");
+			}
 		}
 
+		lastImageIndex = currentImageIndex;
+		hasEndedFrame = true;
 		isFrameStarted = false;
 		currentFrameIndex = (currentFrameIndex + 1) % SwapChain::MAX_FRAMES_IN_FLIGHT;
 	}
 
-	void Renderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer)
+	void Renderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer, VkSubpassContents contents)
 	{
 		assert(isFrameStarted && "Cannot beginSwapChainRenderPass while frame is not in progress.");
 		assert(commandBuffer == getCurrentCommandBuffer() && "Can't beging render pass on a command buffer from a different frame.");
 	
 		VkRenderPassBeginInfo renderPassInfo{};
 		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-		renderPassInfo.renderPass = swapChain->getRenderPass();
-		renderPassInfo.framebuffer = swapChain->getFrameBuffer(currentImageIndex);
+		renderPassInfo.renderPass = getSwapChainRenderPass();
+		renderPassInfo.framebuffer = getCurrentFrameBuffer();
 
 		renderPassInfo.renderArea.offset = { 0, 0 }; // define the area where the shader loads and stores will take place
-		renderPassInfo.renderArea.extent = swapChain->getSwapChainExtent(); // For high density displays, the swap chain extent may be larger than our window's
+		renderPassInfo.renderArea.extent = getSwapChainExtent(); // For high density displays, the swap chain extent may be larger than our window's
 
 		std::array<VkClearValue, 2> clearValues{};
 		clearValues[0].color = { 0.01f, 0.01f, 0.01f, 1.0f };
@@ -90,16 +109,17 @@ namespace vraus_VulkanEngine {
 		renderPassInfo.pClearValues = clearValues.data();
 
 		// VK_SUBPASS_CONTENTS_INLINE : Signals that the subsequent render pass commands will be directly embeded in the primary command buffer itself, no secondary command buffer will be used
-		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, contents);
+		if (contents == VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS) return; // Dynamic state isn't inherited by secondaries
 
 		VkViewport viewport{};
 		viewport.x = 0.0f;
 		viewport.y = 0.0f;
-		viewport.width = static_cast<float>(swapChain->getSwapChainExtent().width);
-		viewport.height = static_cast<float>(swapChain->getSwapChainExtent().height);
+		viewport.width = static_cast<float>(getSwapChainExtent().width);
+		viewport.height = static_cast<float>(getSwapChainExtent().height);
 		viewport.minDepth = 0.0f;
 		viewport.maxDepth = 1.0f;
-		VkRect2D scissor{ {0, 0}, swapChain->getSwapChainExtent() };
+		VkRect2D scissor{ {0, 0}, getSwapChainExtent() };
 		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
 		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 	}
@@ -112,6 +132,18 @@ namespace vraus_VulkanEngine {
 		vkCmdEndRenderPass(commandBuffer);
 	}
 
+	void Renderer::saveLastFrame(const std::string& filepath)
+	{
+		assert(isHeadless() && "Only offscreen frames can be read back");
+		assert(!isFrameStarted && "Can't save a frame while one is in progress.");
+		assert(hasEndedFrame && "No frame was drawn yet");
+
+		std::vector<uint8_t> rgba{};
+		offscreenTarget->readback(lastImageIndex, rgba);
+		VkExtent2D extent = offscreenTarget->getExtent();
+		writePng(filepath, extent.width, extent.height, rgba);
+	}
+
 	void Renderer::createCommandBuffers()
 	{
 		// The max frames in flight constant is currently defined as 2
@@ -136,9 +168,9 @@ namespace vraus_VulkanEngine {
 
 	void Renderer::recreateSwapChain()
 	{
-		auto extent = window.getExtent();
+		auto extent = window->getExtent();
 		while (extent.width == 0 || extent.height == 0) {
-			extent = window.getExtent();
+			extent = window->getExtent();
 			glfwWaitEvents(); // While there is at least one dimmension with no size the programme will wait (i.e: minimization)
 		}
 
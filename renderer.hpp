@@ -4,53 +4,83 @@
 #include "swapChain.hpp"
 #include "device.hpp"
 #include "model.hpp"
+#include "frame_ring_buffer.hpp"
+#include "offscreen_target.hpp"
 
 #include <cassert>
 #include <memory>
+#include <string>
 #include <vector>
 
 namespace vraus_VulkanEngine {
 	class Renderer {
 	public:
 		Renderer(Window& window, Device& device);
+		// Headless: draws into an OffscreenTarget of the given extent instead of a swap chain, device must be headless too
+		Renderer(Device& device, VkExtent2D extent);
 		~Renderer();
 
 		Renderer(const Renderer&) = delete;
 		Renderer& operator=(const Renderer&) = delete;
 
-		VkRenderPass getSwapChainRenderPass() const { return swapChain->getRenderPass(); }
+		// The offscreen target's render pass and extent when headless
+		VkRenderPass getSwapChainRenderPass() const {
+			return isHeadless() ? offscreenTarget->getRenderPass() : swapChain->getRenderPass();
+		}
+		VkExtent2D getSwapChainExtent() const {
+			return isHeadless() ? offscreenTarget->getExtent() : swapChain->getSwapChainExtent();
+		}
 		bool isFrameInProgress() const { return isFrameStarted; }
+		bool isHeadless() const { return offscreenTarget != nullptr; }
 
 		VkCommandBuffer getCurrentCommandBuffer() const {
 			assert(isFrameStarted && "Cannot get command Buffer when frame not in progress");
 			return commandBuffers[currentImageIndex]; 
 		}
 
+		// Framebuffer of the image being drawn, secondary command buffers continuing the render pass inherit it
+		VkFramebuffer getCurrentFrameBuffer() const {
+			assert(isFrameStarted && "Cannot get frame buffer when frame not in progress");
+			return isHeadless() ? offscreenTarget->getFrameBuffer(currentImageIndex) : swapChain->getFrameBuffer(currentImageIndex);
+		}
+
 		int getFrameIndex() const {
 			assert(isFrameStarted && "Cannot get frame index when frame not in progress.");
 			return currentFrameIndex;
 		}
 
+		// Per frame data, what a frame allocates is reclaimed once its fence signaled
+		FrameRingBuffer& getFrameRing() { return frameRing; }
+
 		// We want the application to main control over every steps of drawing a frame
 		// so that down the line we can easily integrate multiple render passes
 		// Will be helpfull for things like reflections, shadows, raytracing, postprocessing effects
 
 		VkCommandBuffer beginFrame();
 		void endFrame();
-		void beginSwapChainRenderPass(VkCommandBuffer commandBuffer);
+		// With VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS the pass can only execute secondary command buffers,
+		// which set their own viewport and scissor (see ParallelCommandRecorder)
+		void beginSwapChainRenderPass(VkCommandBuffer commandBuffer, VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
 		void endSwapChainRenderPass(VkCommandBuffer commandBuffer);
 
+		// Headless only, between frames: waits for the last frame ended and writes its color image to a PNG file
+		void saveLastFrame(const std::string& filepath);
+
 	private:
 		void createCommandBuffers();
 		void freeCommandBuffers();
 		void recreateSwapChain();
 
-		Window& window;
+		Window* window; // Null when headless
 		Device& device;
 		std::unique_ptr<SwapChain> swapChain;
+		std::unique_ptr<OffscreenTarget> offscreenTarget; // Replaces the swap chain when headless
 		std::vector<VkCommandBuffer> commandBuffers;
+		FrameRingBuffer frameRing;
 
 		uint32_t currentImageIndex;
+		uint32_t lastImageIndex{ 0 }; // Image of the last frame ended
+		bool hasEndedFrame{ false };
 		int currentFrameIndex{ 0 }; // Keep track of a frameIndex : [0, Max_Frames_In_Flight] not tight to the image index.
 		bool isFrameStarted{ false };
 	};
@@ -0,0 +1,110 @@
+#include "shader_registry.hpp"
+
+#include "mapped_file.hpp"
+
+#include <cassert>
+#include <filesystem>
+#include <stdexcept>
+
+namespace vraus_VulkanEngine {
+
+	static constexpr uint32_t SPIRV_MAGIC = 0x07230203;
+
+	ShaderRegistry::ShaderRegistry(VkDevice device) : device{ device } {}
+
+	ShaderRegistry::~ShaderRegistry() {
+		assert(entries.empty() && "Shader modules still acquired when the registry is destroyed");
+		for (auto& entry : entries) {
+			vkDestroyShaderModule(device, entry.second.shaderModule, nullptr);
+		}
+	}
+
+	uint64_t ShaderRegistry::hash(const char* data, size_t size) {
+		uint64_t value = 14695981039346656037ull;
+		for (size_t i = 0; i < size; i++) {
+			value ^= static_cast<uint8_t>(data[i]);
+			value *= 1099511628211ull;
+		}
+		return value;
+	}
+
+	VkShaderModule ShaderRegistry::acquire(const std::string& filepath) {
+		// .spv files other than the baseline's are generated, not tracked
+		if (!std::filesystem::exists(filepath)) {
+			throw std::runtime_error("missing SPIR-V file: " + filepath + ", compile the shaders with compile.bat or compile.sh");
+		}
+		MappedFile file{ filepath };
+		const uint64_t key = hash(file.data(), file.size());
+
+		// Held while the module is created, a second thread acquiring the same shader waits and shares it
+		std::lock_guard<std::mutex> lock{ mutex };
+
+		auto candidates = entries.equal_range(key);
+		for (auto it = candidates.first; it != candidates.second; ++it) {
+			Entry& candidate = it->second;
+			if (candidate.codeSize == file.size()) {
+				candidate.referenceCount++;
+				stats.modulesShared++;
+				return candidate.shaderModule;
+			}
+		}
+
+		Entry entry{};
+		entry.shaderModule = createShaderModule(file.data(), file.size(), filepath);
+		entry.referenceCount = 1;
+		entry.codeSize = file.size();
+		VkShaderModule shaderModule = entry.shaderModule;
+		entries.emplace(key, std::move(entry));
+		moduleHashes.emplace(shaderModule, key);
+		stats.modulesCreated++;
+		stats.moduleCount++;
+		return shaderModule;
+	}
+
+	void ShaderRegistry::release(VkShaderModule shaderModule) {
+		std::lock_guard<std::mutex> lock{ mutex };
+		auto found = moduleHashes.find(shaderModule);
+		assert(found != moduleHashes.end() && "Releasing a shader module the registry didn't create");
+		if (found == moduleHashes.end()) return;
+
+		auto candidates = entries.equal_range(found->second);
+		auto owner = candidates.first;
+		while (owner != candidates.second && owner->second.shaderModule != shaderModule) ++owner;
+		assert(owner != candidates.second && "Shader module missing from its hash bucket");
+		if (owner == candidates.second) return;
+
+		if (--owner->second.referenceCount > 0) return;
+
+		vkDestroyShaderModule(device, shaderModule, nullptr);
+		entries.erase(owner);
+		moduleHashes.erase(found);
+		stats.moduleCount--;
+	}
+
+	ShaderRegistry::Stats ShaderRegistry::getStats() const {
+		std::lock_guard<std::mutex> lock{ mutex };
+		return stats;
+	}
+
+	VkShaderModule ShaderRegistry::createShaderModule(const char* code, size_t size, const std::string& filepath) {
+		// The mapping is page aligned so the code can be handed to the driver as uint32_t words without a copy
+		uint32_t magic = 0;
+		if (size >= sizeof(magic)) {
+			magic = *reinterpret_cast<const uint32_t*>(code);
+		}
+		if (size % sizeof(uint32_t) != 0 || magic != SPIRV_MAGIC) {
+			throw std::runtime_error("not a SPIR-V file: " + filepath);
+		}
+
+		VkShaderModuleCreateInfo createInfo{};
+		createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		createInfo.codeSize = size;
+		createInfo.pCode = reinterpret_cast<const uint32_t*>(code);
+
+		VkShaderModule shaderModule;
+		if (vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create shader module: " + filepath);
+		}
+		return shaderModule;
+	}
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace vraus_VulkanEngine {
+	/* Shares VkShaderModules between pipelines. SPIR-V files are memory mapped and hashed (FNV-1a 64),
+	files with the same contents get the same module whatever their path, and the driver only parses it once.
+	A module is reused when both the hash and the size match. Nothing else is kept to compare the bytes: a copy is what
+	the mapping avoids, and keeping the mapping would lock the files on Windows against compile.bat and hot reload.
+	With the few dozen shaders of a project, a 64 bit collision between two of them is around 1e-17 likely.
+	Modules are reference counted, the last release destroys them. Owned by Device. Thread safe, pipelines are
+	compiled on several threads by PipelineManager.
+	*/
+	class ShaderRegistry {
+	public:
+		struct Stats {
+			uint32_t moduleCount = 0; // Live modules
+			uint32_t modulesCreated = 0;
+			uint32_t modulesShared = 0; // Acquires that found their module already created
+		};
+
+		ShaderRegistry(VkDevice device);
+		~ShaderRegistry();
+
+		ShaderRegistry(const ShaderRegistry&) = delete;
+		ShaderRegistry& operator=(const ShaderRegistry&) = delete;
+
+		// Module for the SPIR-V file at filepath, every acquire must be matched by a release
+		VkShaderModule acquire(const std::string& filepath);
+		void release(VkShaderModule shaderModule);
+
+		Stats getStats() const;
+
+		static uint64_t hash(const char* data, size_t size);
+
+	private:
+		struct Entry {
+			VkShaderModule shaderModule = VK_NULL_HANDLE;
+			uint32_t referenceCount = 0;
+			size_t codeSize = 0;
+		};
+
+		VkShaderModule createShaderModule(const char* code, size_t size, const std::string& filepath);
+
+		VkDevice device;
+		mutable std::mutex mutex;
+		std::unordered_multimap<uint64_t, Entry> entries; // By content hash, files of different sizes get their own entry
+		std::unordered_map<VkShaderModule, uint64_t> moduleHashes;
+		Stats stats{};
+	};
+}
@@ -0,0 +1,170 @@
+#include "shader_watcher.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <set>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace vraus_VulkanEngine {
+
+	// Edits often come as several writes in a row, they are gathered for this long before compiling
+	static constexpr std::chrono::milliseconds SETTLE_TIME{ 50 };
+	static constexpr std::chrono::milliseconds POLL_INTERVAL{ 250 };
+
+	std::string ShaderWatcher::defaultCompilerPath() {
+		const char* sdk = std::getenv("VULKAN_SDK");
+		if (sdk == nullptr) return "glslc";
+#ifdef _WIN32
+		return (std::filesystem::path(sdk) / "Bin" / "glslc.exe").string();
+#else
+		return (std::filesystem::path(sdk) / "bin" / "glslc").string();
+#endif
+	}
+
+	ShaderWatcher::ShaderWatcher(const std::string& directory, const std::string& compilerPath)
+		: directory{ directory }, compilerPath{ compilerPath } {}
+
+	ShaderWatcher::~ShaderWatcher() {
+		stop();
+	}
+
+	void ShaderWatcher::start() {
+		if (thread.joinable()) return;
+#ifndef __linux__
+		pollChanges(); // Records the current write times, only what changes from now on is compiled
+#endif
+		stopping = false;
+		thread = std::thread(&ShaderWatcher::run, this);
+	}
+
+	void ShaderWatcher::stop() {
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			stopping = true;
+		}
+		stopCondition.notify_all();
+		if (thread.joinable()) {
+			thread.join();
+		}
+	}
+
+	std::vector<std::string> ShaderWatcher::takeCompiled() {
+		std::lock_guard<std::mutex> lock{ mutex };
+		std::vector<std::string> result;
+		result.swap(compiled);
+		return result;
+	}
+
+	bool ShaderWatcher::isShaderSource(const std::filesystem::path& path) {
+		const auto extension = path.extension();
+		return extension == ".vert" || extension == ".frag" || extension == ".comp";
+	}
+
+#ifdef __linux__
+	void ShaderWatcher::run() {
+		int inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (inotifyFd < 0 || inotify_add_watch(inotifyFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+			std::cerr << "shader watcher: failed to watch " << directory << std::endl;
+			if (inotifyFd >= 0) close(inotifyFd);
+			return;
+		}
+
+		alignas(inotify_event) char events[4096];
+		while (true) {
+			{
+				std::lock_guard<std::mutex> lock{ mutex };
+				if (stopping) break;
+			}
+
+			// Wakes up regularly to notice stop()
+			pollfd descriptor{ inotifyFd, POLLIN, 0 };
+			if (poll(&descriptor, 1, static_cast<int>(POLL_INTERVAL.count())) <= 0) continue;
+			std::this_thread::sleep_for(SETTLE_TIME);
+
+			std::set<std::string> changed;
+			ssize_t length;
+			while ((length = read(inotifyFd, events, sizeof(events))) > 0) {
+				for (char* cursor = events; cursor < events + length;) {
+					const inotify_event* event = reinterpret_cast<const inotify_event*>(cursor);
+					if (event->len > 0 && isShaderSource(event->name)) {
+						changed.insert(event->name);
+					}
+					cursor += sizeof(inotify_event) + event->len;
+				}
+			}
+			for (const std::string& sourceName : changed) {
+				compile(sourceName);
+			}
+		}
+		close(inotifyFd);
+	}
+#else
+	void ShaderWatcher::run() {
+		std::unique_lock<std::mutex> lock{ mutex };
+		while (!stopCondition.wait_for(lock, POLL_INTERVAL, [&] { return stopping; })) {
+			lock.unlock();
+			std::vector<std::string> changed = pollChanges();
+			if (!changed.empty()) {
+				std::this_thread::sleep_for(SETTLE_TIME);
+				for (const std::string& sourceName : changed) {
+					compile(sourceName);
+				}
+			}
+			lock.lock();
+		}
+	}
+
+	std::vector<std::string> ShaderWatcher::pollChanges() {
+		std::vector<std::string> changed;
+		std::error_code error;
+		for (const auto& file : std::filesystem::directory_iterator(directory, error)) {
+			if (!file.is_regular_file(error) || !isShaderSource(file.path())) continue;
+			const auto writeTime = file.last_write_time(error);
+			if (error) continue;
+
+			const std::string sourceName = file.path().filename().string();
+			auto inserted = writeTimes.emplace(sourceName, writeTime);
+			if (inserted.second || inserted.first->second != writeTime) {
+				inserted.first->second = writeTime;
+				changed.push_back(sourceName);
+			}
+		}
+		return changed;
+	}
+#endif
+
+	void ShaderWatcher::compile(const std::string& sourceName) {
+		const std::filesystem::path source = directory / sourceName;
+		const std::filesystem::path spirv = (directory / (sourceName + ".spv")).lexically_normal();
+		const std::filesystem::path temporary = spirv.string() + ".tmp";
+
+		std::string command = "\"" + compilerPath + "\" \"" + source.string() + "\" -o \"" + temporary.string() + "\"";
+#ifdef _WIN32
+		command = "\"" + command + "\""; // cmd strips the outer quotes of a command starting with one
+#endif
+		if (std::system(command.c_str()) != 0) {
+			std::cerr << "shader watcher: failed to compile " << source.string() << ", keeping the previous SPIR-V" << std::endl;
+			std::error_code error;
+			std::filesystem::remove(temporary, error);
+			return;
+		}
+
+		std::error_code error;
+		std::filesystem::rename(temporary, spirv, error);
+		if (error) {
+			std::cerr << "shader watcher: failed to replace " << spirv.string() << ": " << error.message() << std::endl;
+			return;
+		}
+
+		std::cout << "shader watcher: recompiled " << spirv.string() << std::endl;
+		std::lock_guard<std::mutex> lock{ mutex };
+		compiled.push_back(spirv.string());
+	}
+}
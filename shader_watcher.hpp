@@ -0,0 +1,57 @@
+#pragma once
+
+#include <condition_variable>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace vraus_VulkanEngine {
+	/* Watches a directory for edited GLSL sources (.vert, .frag, .comp) and recompiles them to SPIR-V with glslc on
+	its own thread, next to the source as compile.bat does. Changes come from inotify on Linux, elsewhere the write
+	times are polled. The .spv is written to a temporary file first and renamed over the old one, so a pipeline being
+	built never reads a half written file. Sources that fail to compile keep their previous .spv.
+	Only pipelines built by PipelineManager are reloaded, which covers every graphics pipeline. Compute pipelines
+	(ComputePipeline) are created directly by their systems, an edited .comp is compiled but used from the next launch.
+	*/
+	class ShaderWatcher {
+	public:
+		// glslc from the Vulkan SDK when VULKAN_SDK is set, from the PATH otherwise
+		static std::string defaultCompilerPath();
+
+		ShaderWatcher(const std::string& directory = ".", const std::string& compilerPath = defaultCompilerPath());
+		~ShaderWatcher();
+
+		ShaderWatcher(const ShaderWatcher&) = delete;
+		ShaderWatcher& operator=(const ShaderWatcher&) = delete;
+
+		void start();
+		void stop();
+		bool isRunning() const { return thread.joinable(); }
+
+		// SPIR-V files rewritten since the last call, to hand to PipelineManager::reload()
+		std::vector<std::string> takeCompiled();
+
+	private:
+		void run();
+		void compile(const std::string& sourceName);
+		static bool isShaderSource(const std::filesystem::path& path);
+
+#ifndef __linux__
+		// Sources whose write time changed since the last scan
+		std::vector<std::string> pollChanges();
+		std::unordered_map<std::string, std::filesystem::file_time_type> writeTimes;
+#endif
+
+		std::filesystem::path directory;
+		std::string compilerPath;
+		std::thread thread;
+
+		std::mutex mutex;
+		std::condition_variable stopCondition;
+		bool stopping = false;
+		std::vector<std::string> compiled;
+	};
+}
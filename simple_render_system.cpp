@@ -1,5 +1,7 @@
 #include "simple_render_system.hpp"
 
+#include "cull_compute_system.hpp"
+
 // libs
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -8,6 +10,8 @@
 
 #include <stdexcept>
 #include <array>
+#include <cassert>
+#include <unordered_map>
 
 namespace vraus_VulkanEngine {
 
@@ -17,13 +21,19 @@ namespace vraus_VulkanEngine {
 		alignas (16) glm::vec3 color;
 	};
 
-	SimpleRenderSystem::SimpleRenderSystem(Device& _device, VkRenderPass renderPass) : device{ _device } {
+	SimpleRenderSystem::SimpleRenderSystem(
+		Device& _device, VkRenderPass renderPass, FrameRingBuffer& frameRing, PipelineStateCache& pipelineStates)
+		: device{ _device }, frameRing{ frameRing }, pipelineStates{ pipelineStates } {
 		createPipelineLayout();
 		createPipeline(renderPass);
+		createInstancedPipelineLayout();
+		createInstancedPipeline(renderPass);
 	}
 
 	SimpleRenderSystem::~SimpleRenderSystem() {
+		pipelineStates.getPipelineManager().waitIdle(); // The layouts must outlive the compilation of our pipelines
 		vkDestroyPipelineLayout(device.device(), pipelineLayout, nullptr);
+		vkDestroyPipelineLayout(device.device(), instancedPipelineLayout, nullptr);
 	}
 
 	void SimpleRenderSystem::createPipelineLayout()
@@ -50,38 +60,217 @@ namespace vraus_VulkanEngine {
 	{
 		assert(pipelineLayout != nullptr && "Cannot create pipeline before pipeline layout");
 
-		PipelineConfigInfo pipelineConfig{};
-		Pipeline::defaultPipelineConfigInfo(pipelineConfig);
-		pipelineConfig.renderPass = renderPass; // Render pass describes the sctructure and format of our frame buffer object and their attachments
-		pipelineConfig.pipelineLayout = pipelineLayout;
-		pipeline = std::make_unique<Pipeline>(
-			device,
-			"simple_shader.vert.spv",
-			"simple_shader.frag.spv",
-			pipelineConfig);
+		auto pipelineState = PipelineStateKey::create("simple_shader.vert.spv", "simple_shader.frag.spv");
+		// Render pass describes the sctructure and format of our frame buffer object and their attachments
+		pipeline = pipelineStates.request(pipelineState, pipelineLayout, renderPass);
 	}
 
-	void SimpleRenderSystem::renderGameObjects(VkCommandBuffer commandBuffer, std::vector<GameObject>& gameObjects)
+	void SimpleRenderSystem::createInstancedPipelineLayout()
 	{
-		int i = 0;
-		for (auto& obj : gameObjects) {
-			i += 1;
-			obj.transform2d.rotation = glm::mod<float>(obj.transform2d.rotation + 0.0001f * i, 2.f * glm::pi<float>());
+		// Everything comes from the vertex buffers, no push constants
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = 0;
+		pipelineLayoutInfo.pSetLayouts = nullptr;
+		pipelineLayoutInfo.pushConstantRangeCount = 0;
+		pipelineLayoutInfo.pPushConstantRanges = nullptr;
+
+		if (vkCreatePipelineLayout(device.device(), &pipelineLayoutInfo, nullptr, &instancedPipelineLayout) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create instanced pipeline layout");
 		}
+	}
 
-		pipeline->bind(commandBuffer);
+	void SimpleRenderSystem::createInstancedPipeline(VkRenderPass renderPass)
+	{
+		assert(instancedPipelineLayout != nullptr && "Cannot create pipeline before pipeline layout");
 
-		for (auto& obj : gameObjects) {
+		auto pipelineState = PipelineStateKey::create("instanced_shader.vert.spv", "instanced_shader.frag.spv");
+		// Binding 0 stays the model vertices, binding 1 advances once per instance
+		pipelineState.addVertexLayout(InstanceData::getBindingDescriptions(), InstanceData::getAttributeDescriptions());
+		instancedPipeline = pipelineStates.request(pipelineState, instancedPipelineLayout, renderPass);
+	}
+
+	void SimpleRenderSystem::animate(std::vector<GameObject>& gameObjects, size_t begin, size_t end)
+	{
+		for (size_t i = begin + 1; i <= end; i++) {
+			auto& obj = gameObjects[i - 1];
+			obj.transform2d.rotation = glm::mod<float>(obj.transform2d.rotation + 0.0001f * i, 2.f * glm::pi<float>());
 			obj.transform2d.rotation = glm::mod(obj.transform2d.rotation + 0.001f, glm::two_pi<float>()); // This will rotate the triangle in a full circle
+		}
+	}
 
+	void SimpleRenderSystem::queueGameObjects(
+		RenderQueue& queue, Pipeline& objectPipeline, std::vector<GameObject>& gameObjects, size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++) {
+			auto& obj = gameObjects[i];
+			if (!obj.model->isReady()) continue; // Still uploading
 			SimplePushConstantData push{};
 			push.offset = obj.transform2d.translation;
 			push.color = obj.color;
 			push.transform = obj.transform2d.mat2();
 
-			vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(SimplePushConstantData), &push);
-			obj.model->bind(commandBuffer);
-			obj.model->draw(commandBuffer);
+			auto& packet = queue.submit(objectPipeline, pipelineLayout, *obj.model);
+			queue.setPushConstants(packet, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, &push, sizeof(SimplePushConstantData));
+		}
+	}
+
+	void SimpleRenderSystem::renderGameObjects(VkCommandBuffer commandBuffer, std::vector<GameObject>& gameObjects)
+	{
+		Pipeline* objectPipeline = pipelineStates.get(pipeline);
+		if (objectPipeline == nullptr) return; // Still compiling, nothing is drawn until it is ready
+
+		animate(gameObjects, 0, gameObjects.size());
+		queueGameObjects(renderQueue, *objectPipeline, gameObjects, 0, gameObjects.size());
+		renderQueue.flush(commandBuffer);
+	}
+
+	void SimpleRenderSystem::renderGameObjects(ParallelCommandRecorder& recorder, int frameIndex, std::vector<GameObject>& gameObjects)
+	{
+		beginFrame(frameIndex);
+		Pipeline* objectPipeline = pipelineStates.get(pipeline);
+		if (objectPipeline == nullptr) return;
+
+		threadQueues.resize(recorder.threadCount());
+		for (RenderQueue& queue : threadQueues) {
+			queue.resetStats();
+		}
+
+		// Objects and queues are only touched by the thread owning their range
+		recorder.record(gameObjects.size(), [&](VkCommandBuffer commandBuffer, size_t begin, size_t end, unsigned int threadIndex) {
+			animate(gameObjects, begin, end);
+			queueGameObjects(threadQueues[threadIndex], *objectPipeline, gameObjects, begin, end);
+			threadQueues[threadIndex].flush(commandBuffer);
+		});
+
+		for (const RenderQueue& queue : threadQueues) {
+			renderQueue.addStats(queue.getStats());
+		}
+	}
+
+	void SimpleRenderSystem::renderGameObjects(VkCommandBuffer commandBuffer, int frameIndex, std::vector<GameObject>& gameObjects)
+	{
+		beginFrame(frameIndex);
+		if (gameObjects.size() < instancingThreshold) {
+			renderGameObjects(commandBuffer, gameObjects);
+			return;
+		}
+		Pipeline* objectPipeline = pipelineStates.get(instancedPipeline);
+		if (objectPipeline == nullptr) return;
+
+		animate(gameObjects, 0, gameObjects.size());
+
+		// Count the objects of each model, in order of first appearance so the draw order stays close to the push constant path
+		std::unordered_map<Model*, size_t> groupIndices{};
+		groupModels.clear();
+		groupCounts.clear();
+		for (auto& obj : gameObjects) {
+			auto inserted = groupIndices.emplace(obj.model.get(), groupModels.size());
+			if (inserted.second) {
+				groupModels.push_back(obj.model.get());
+				groupCounts.push_back(0);
+			}
+			groupCounts[inserted.first->second]++;
+		}
+
+		// Then place every object in its model's range of the instance array
+		std::vector<size_t> groupCursors(groupCounts.size());
+		for (size_t group = 1; group < groupCounts.size(); group++) {
+			groupCursors[group] = groupCursors[group - 1] + groupCounts[group - 1];
+		}
+		instances.resize(gameObjects.size());
+		for (auto& obj : gameObjects) {
+			InstanceData& instance = instances[groupCursors[groupIndices[obj.model.get()]]++];
+			instance.transform = obj.transform2d.mat2();
+			instance.offset = obj.transform2d.translation;
+			instance.color = obj.color;
+		}
+
+		auto instanceRange = frameRing.push(instances.data(), instances.size() * sizeof(InstanceData));
+
+		VkDeviceSize groupByte = instanceRange.offset;
+		for (size_t group = 0; group < groupModels.size(); group++) {
+			if (groupModels[group]->isReady()) {
+				auto& packet = renderQueue.submit(*objectPipeline, instancedPipelineLayout, *groupModels[group]);
+				packet.instanceCount = static_cast<uint32_t>(groupCounts[group]);
+				packet.instanceBuffer = instanceRange.buffer;
+				packet.instanceOffset = groupByte;
+			}
+			groupByte += groupCounts[group] * sizeof(InstanceData);
+		}
+		renderQueue.flush(commandBuffer);
+	}
+
+	void SimpleRenderSystem::renderIndirect(VkCommandBuffer commandBuffer, int frameIndex, const CullComputeSystem& cullSystem)
+	{
+		beginFrame(frameIndex);
+		Pipeline* objectPipeline = pipelineStates.get(instancedPipeline);
+		if (cullSystem.getGroupCount() == 0 || objectPipeline == nullptr) return;
+
+		objectPipeline->bind(commandBuffer);
+		VkBuffer instanceBuffer = cullSystem.getInstanceBuffer(frameIndex);
+		VkBuffer commandBufferIndirect = cullSystem.getCommandBuffer(frameIndex);
+		VkBuffer countBuffer = cullSystem.getCountBuffer(frameIndex);
+		for (size_t group = 0; group < cullSystem.getGroupCount(); group++) {
+			Model& model = cullSystem.getGroupModel(group);
+			if (!model.isReady()) continue;
+			VkDeviceSize instanceOffset = cullSystem.getGroupInstanceOffset(group);
+			VkDeviceSize commandOffset = group * sizeof(VkDrawIndexedIndirectCommand);
+			// Commands are laid out as VkDrawIndexedIndirectCommand, non indexed draws read their first 4 members
+			const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+			const VkDeviceSize countOffset = group * sizeof(uint32_t);
+
+			model.bind(commandBuffer);
+			vkCmdBindVertexBuffers(commandBuffer, 1, 1, &instanceBuffer, &instanceOffset);
+			if (model.hasIndexBuffer()) {
+				if (device.supportsDrawIndirectCount()) {
+					device.cmdDrawIndexedIndirectCount(
+						commandBuffer, commandBufferIndirect, commandOffset, countBuffer, countOffset, 1, stride);
+				}
+				else {
+					vkCmdDrawIndexedIndirect(commandBuffer, commandBufferIndirect, commandOffset, 1, stride);
+				}
+			}
+			else {
+				if (device.supportsDrawIndirectCount()) {
+					device.cmdDrawIndirectCount(
+						commandBuffer, commandBufferIndirect, commandOffset, countBuffer, countOffset, 1, stride);
+				}
+				else {
+					vkCmdDrawIndirect(commandBuffer, commandBufferIndirect, commandOffset, 1, stride);
+				}
+			}
 		}
 	}
+
+	void SimpleRenderSystem::beginFrame(int frameIndex)
+	{
+		assert(frameIndex >= 0 && frameIndex < SwapChain::MAX_FRAMES_IN_FLIGHT && "Frame index out of range");
+		if (frameIndex == currentFrameIndex) return;
+
+		currentFrameIndex = frameIndex;
+		renderQueue.resetStats();
+	}
+
+	std::vector<VkVertexInputBindingDescription> SimpleRenderSystem::InstanceData::getBindingDescriptions()
+	{
+		std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
+
+		bindingDescriptions[0].binding = 1;
+		bindingDescriptions[0].stride = sizeof(InstanceData);
+		bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+		return bindingDescriptions;
+	}
+
+	std::vector<VkVertexInputAttributeDescription> SimpleRenderSystem::InstanceData::getAttributeDescriptions()
+	{
+		// A mat2 attribute takes one location per column
+		return {
+			{ 2, 1, VK_FORMAT_R32G32_SFLOAT, offsetof(InstanceData, transform) },
+			{ 3, 1, VK_FORMAT_R32G32_SFLOAT, static_cast<uint32_t>(offsetof(InstanceData, transform) + sizeof(glm::vec2)) },
+			{ 4, 1, VK_FORMAT_R32G32_SFLOAT, offsetof(InstanceData, offset) },
+			{ 5, 1, VK_FORMAT_R32G32B32_SFLOAT, offsetof(InstanceData, color) },
+		};
+	}
 }
\ No newline at end of file
@@ -4,28 +4,89 @@
 #include "device.hpp"
 #include "model.hpp"
 #include "game_object.hpp"
+#include "swapChain.hpp"
+#include "render_queue.hpp"
+#include "frame_ring_buffer.hpp"
+#include "parallel_command_recorder.hpp"
+#include "pipeline_state_cache.hpp"
 
 #include <memory>
 #include <vector>
 
 namespace vraus_VulkanEngine {
+	class CullComputeSystem;
+
 	class SimpleRenderSystem {
 	public:
-		SimpleRenderSystem(Device& device, VkRenderPass renderPass);
+		// Instance data is streamed through frameRing, usually the Renderer's. Pipelines come from pipelineStates,
+		// shared with any system using the same state, and are compiled in the background. Objects aren't drawn until they are ready.
+		SimpleRenderSystem(Device& device, VkRenderPass renderPass, FrameRingBuffer& frameRing, PipelineStateCache& pipelineStates);
 		~SimpleRenderSystem();
 
 		SimpleRenderSystem(const SimpleRenderSystem&) = delete;
 		SimpleRenderSystem& operator=(const SimpleRenderSystem&) = delete;
 
+		// Per instance vertex data of the instanced path, read by instanced_shader.vert
+		struct InstanceData {
+			glm::mat2 transform{ 1.f };
+			glm::vec2 offset{};
+			glm::vec3 color{};
+
+			static std::vector<VkVertexInputBindingDescription> getBindingDescriptions();
+			static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
+		};
+
+		// Below this many objects, the instanced overload of renderGameObjects falls back to one push constant draw per object
+		size_t instancingThreshold = 16;
+
+		// One push constant update and draw call per object, sorted by model so its vertex buffer is only bound once
 		void renderGameObjects(VkCommandBuffer commandBuffer, std::vector<GameObject>& gameObjects);
+		// Objects are written to the frame ring buffer and every object sharing a Model is drawn with a single instanced draw.
+		// Can be called several times per frame.
+		void renderGameObjects(VkCommandBuffer commandBuffer, int frameIndex, std::vector<GameObject>& gameObjects);
+
+		// Same draws as the push constant path, but the objects are split across recorder's threads and every thread
+		// animates and records its share into a secondary command buffer. Sorting happens within each share.
+		void renderGameObjects(ParallelCommandRecorder& recorder, int frameIndex, std::vector<GameObject>& gameObjects);
+
+		// Draws what cullSystem.cull() kept for this frame, one indirect draw per model whatever the object count.
+		// Uses vkCmdDrawIndirectCount when available so models with no visible instance are skipped by the GPU.
+		void renderIndirect(VkCommandBuffer commandBuffer, int frameIndex, const CullComputeSystem& cullSystem);
+
+		// Spins objects [begin, end) by one frame. The renderGameObjects overloads call it themselves,
+		// objects drawn some other way (renderIndirect) must be animated by the caller to look the same.
+		void animate(std::vector<GameObject>& gameObjects, size_t begin, size_t end);
+
+		// Draws, binds and binds saved by the calls made with the current frame index
+		const RenderQueue::Stats& getRenderStats() const { return renderQueue.getStats(); }
+		uint32_t getDrawCallCount() const { return renderQueue.getStats().drawCalls; }
 
 	private:
 		void createPipelineLayout();
 		void createPipeline(VkRenderPass renderPass); // The render pass is used specifically to create the pipeline
+		void createInstancedPipelineLayout();
+		void createInstancedPipeline(VkRenderPass renderPass);
+		void queueGameObjects(
+			RenderQueue& queue, Pipeline& objectPipeline, std::vector<GameObject>& gameObjects, size_t begin, size_t end);
+		void beginFrame(int frameIndex);
 
 		Device& device;
+		FrameRingBuffer& frameRing;
+		PipelineStateCache& pipelineStates;
 
-		std::unique_ptr<Pipeline> pipeline; // Smart pointer
+		PipelineManager::Handle pipeline;
 		VkPipelineLayout pipelineLayout;
+
+		PipelineManager::Handle instancedPipeline;
+		VkPipelineLayout instancedPipelineLayout = VK_NULL_HANDLE;
+
+		int currentFrameIndex = -1;
+
+		RenderQueue renderQueue;
+		std::vector<RenderQueue> threadQueues; // One per recording thread, their stats are merged into renderQueue's
+
+		std::vector<InstanceData> instances; // Staging for the objects of one call, sorted by model
+		std::vector<Model*> groupModels;
+		std::vector<size_t> groupCounts;
 	};
 }
\ No newline at end of file
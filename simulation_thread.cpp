@@ -0,0 +1,112 @@
+#include "simulation_thread.hpp"
+
+#include <algorithm>
+
+namespace vraus_VulkanEngine {
+
+	void SimulationThread::Snapshot::interpolate(float alpha, BodyStore& bodies) const {
+		const size_t count = x.size();
+		bodies.x.resize(count);
+		bodies.y.resize(count);
+		bodies.vx = vx;
+		bodies.vy = vy;
+		bodies.mass = mass;
+		for (size_t i = 0; i < count; i++) {
+			bodies.x[i] = previousX[i] + alpha * (x[i] - previousX[i]);
+			bodies.y[i] = previousY[i] + alpha * (y[i] - previousY[i]);
+		}
+	}
+
+	SimulationThread::SimulationThread(GravityPhysicsSystem& physicsSystem, BodyStore bodies, float fixedDelta, unsigned int substeps)
+		: physicsSystem{ physicsSystem }, bodies{ std::move(bodies) }, fixedDelta{ fixedDelta }, substeps{ substeps } {
+		// Nothing runs yet, so the initial state can be published and taken from this thread
+		publish(this->bodies.x, this->bodies.y);
+		snapshots.acquire();
+	}
+
+	SimulationThread::~SimulationThread() {
+		stop();
+	}
+
+	void SimulationThread::start() {
+		if (isRunning()) return;
+		running.store(true, std::memory_order_release);
+		thread = std::thread(&SimulationThread::run, this);
+	}
+
+	void SimulationThread::stop() {
+		running.store(false, std::memory_order_release);
+		if (thread.joinable()) {
+			thread.join();
+		}
+	}
+
+	bool SimulationThread::acquireLatest() {
+		if (failed.load(std::memory_order_acquire)) {
+			stop();
+			failed.store(false, std::memory_order_relaxed);
+			std::rethrow_exception(failure);
+		}
+		return snapshots.acquire();
+	}
+
+	float SimulationThread::interpolationFactor(Clock::time_point now) const {
+		std::chrono::duration<float> elapsed = now - latest().publishedAt;
+		return std::clamp(elapsed.count() / fixedDelta, 0.f, 1.f);
+	}
+
+	void SimulationThread::run() {
+		try {
+			std::vector<float> previousX = bodies.x;
+			std::vector<float> previousY = bodies.y;
+			auto previousTime = Clock::now();
+			double accumulator = 0.0;
+
+			while (running.load(std::memory_order_acquire)) {
+				auto now = Clock::now();
+				accumulator += std::chrono::duration<double>(now - previousTime).count();
+				previousTime = now;
+
+				unsigned int steps = 0;
+				while (accumulator >= fixedDelta && steps < maxStepsPerUpdate) {
+					previousX = bodies.x;
+					previousY = bodies.y;
+					physicsSystem.update(bodies, fixedDelta, substeps);
+					simulationTime += fixedDelta;
+					accumulator -= fixedDelta;
+					steps++;
+					stepCount.fetch_add(1, std::memory_order_relaxed);
+				}
+				if (steps == maxStepsPerUpdate) {
+					// Can't keep up: slow the simulation down rather than spiral into ever longer catch ups
+					accumulator = std::min<double>(accumulator, fixedDelta);
+				}
+				if (steps > 0) {
+					publish(previousX, previousY);
+				}
+
+				// Sleep until the next step is due
+				std::this_thread::sleep_for(std::chrono::duration<double>(fixedDelta - accumulator));
+			}
+		}
+		catch (...) {
+			failure = std::current_exception();
+			failed.store(true, std::memory_order_release);
+		}
+	}
+
+	void SimulationThread::publish(const std::vector<float>& previousX, const std::vector<float>& previousY) {
+		Snapshot& snapshot = snapshots.writeBuffer();
+		snapshot.previousX = previousX;
+		snapshot.previousY = previousY;
+		snapshot.x = bodies.x;
+		snapshot.y = bodies.y;
+		snapshot.vx = bodies.vx;
+		snapshot.vy = bodies.vy;
+		snapshot.mass = bodies.mass;
+		snapshot.step = stepCount.load(std::memory_order_relaxed);
+		snapshot.simulationTime = simulationTime;
+		snapshot.publishedAt = Clock::now();
+		snapshots.publish();
+	}
+}
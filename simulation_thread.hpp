@@ -0,0 +1,79 @@
+#pragma once
+
+#include "body_store.hpp"
+#include "gravity_physics_system.hpp"
+#include "triple_buffer.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <thread>
+#include <vector>
+
+namespace vraus_VulkanEngine {
+	/* Runs a GravityPhysicsSystem on its own thread at a fixed timestep, independent of the frame rate.
+	Wall clock time is accumulated and consumed in steps of fixedDelta, each state is published through a TripleBuffer
+	so the render loop never waits on physics and physics never waits on the render loop or vsync.
+	Once started, the physics system and its bodies belong to the simulation thread until stop().
+	*/
+	class SimulationThread {
+	public:
+		using Clock = std::chrono::steady_clock;
+
+		// State after a step, along with the state before it so the renderer can interpolate between the two
+		struct Snapshot {
+			std::vector<float> previousX;
+			std::vector<float> previousY;
+			std::vector<float> x;
+			std::vector<float> y;
+			std::vector<float> vx;
+			std::vector<float> vy;
+			std::vector<float> mass;
+			uint64_t step = 0;
+			double simulationTime = 0.0;
+			Clock::time_point publishedAt{};
+
+			// alpha 0 gives the state before the last step, 1 the latest one. Writes positions, velocities and masses.
+			void interpolate(float alpha, BodyStore& bodies) const;
+		};
+
+		SimulationThread(GravityPhysicsSystem& physicsSystem, BodyStore bodies, float fixedDelta = 1.f / 60, unsigned int substeps = 5);
+		~SimulationThread();
+
+		SimulationThread(const SimulationThread&) = delete;
+		SimulationThread& operator=(const SimulationThread&) = delete;
+
+		// After a stall, at most this many steps are run to catch up, the rest of the late time is dropped
+		unsigned int maxStepsPerUpdate = 8;
+
+		void start();
+		void stop();
+		bool isRunning() const { return thread.joinable(); }
+
+		// Render side: takes the newest published snapshot if there is one. Rethrows an exception raised by the simulation.
+		bool acquireLatest();
+		const Snapshot& latest() const { return snapshots.readBuffer(); }
+		// How far the wall clock is between latest().previous* and latest(), in [0, 1]. Renders one step behind the simulation.
+		float interpolationFactor(Clock::time_point now = Clock::now()) const;
+
+		uint64_t getStepCount() const { return stepCount.load(std::memory_order_relaxed); }
+		float getFixedDelta() const { return fixedDelta; }
+
+	private:
+		void run();
+		void publish(const std::vector<float>& previousX, const std::vector<float>& previousY);
+
+		GravityPhysicsSystem& physicsSystem;
+		BodyStore bodies;
+		const float fixedDelta;
+		const unsigned int substeps;
+		double simulationTime = 0.0;
+
+		TripleBuffer<Snapshot> snapshots;
+		std::thread thread;
+		std::atomic<bool> running{ false };
+		std::atomic<uint64_t> stepCount{ 0 };
+		std::atomic<bool> failed{ false };
+		std::exception_ptr failure;
+	};
+}
@@ -37,7 +37,7 @@ namespace vraus_VulkanEngine {
         for (int i = 0; i < depthImages.size(); i++) {
             vkDestroyImageView(device.device(), depthImageViews[i], nullptr);
             vkDestroyImage(device.device(), depthImages[i], nullptr);
-            vkFreeMemory(device.device(), depthImageMemorys[i], nullptr);
+            device.freeMemory(depthImageMemorys[i]);
         }
 
         for (auto framebuffer : swapChainFramebuffers) {
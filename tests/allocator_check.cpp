@@ -0,0 +1,338 @@
+/* Checks of MemoryAllocator without a GPU. The four Vulkan functions it calls (vkAllocateMemory, vkFreeMemory,
+vkMapMemory, vkUnmapMemory) are defined below on top of host memory, so it links without the Vulkan loader and runs
+anywhere. Prints one line per check, runs all of them and exits with a non-zero code if any failed.
+
+	allocatorCheck
+*/
+#include "memory_allocator.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+	// A VkDeviceMemory handed out by the functions below, its handle is the address of its bytes
+	struct FakeMemory {
+		std::unique_ptr<uint8_t[]> bytes;
+		VkDeviceSize size = 0;
+		uint32_t memoryTypeIndex = 0;
+		bool mapped = false;
+	};
+
+	struct FakeDevice {
+		std::map<VkDeviceMemory, FakeMemory> memories;
+		uint32_t allocateCount = 0; // vkAllocateMemory calls
+		uint32_t errorCount = 0; // Calls the spec forbids: unknown handles, mapping twice, freeing while mapped...
+	};
+
+	FakeDevice fakeDevice{};
+}
+
+extern "C" {
+	VKAPI_ATTR VkResult VKAPI_CALL vkAllocateMemory(
+		VkDevice, const VkMemoryAllocateInfo* allocateInfo, const VkAllocationCallbacks*, VkDeviceMemory* memory)
+	{
+		FakeMemory fake{};
+		fake.bytes = std::make_unique<uint8_t[]>(static_cast<size_t>(allocateInfo->allocationSize));
+		fake.size = allocateInfo->allocationSize;
+		fake.memoryTypeIndex = allocateInfo->memoryTypeIndex;
+		*memory = reinterpret_cast<VkDeviceMemory>(fake.bytes.get());
+		fakeDevice.memories.emplace(*memory, std::move(fake));
+		fakeDevice.allocateCount++;
+		return VK_SUCCESS;
+	}
+
+	VKAPI_ATTR void VKAPI_CALL vkFreeMemory(VkDevice, VkDeviceMemory memory, const VkAllocationCallbacks*) {
+		auto found = fakeDevice.memories.find(memory);
+		if (found == fakeDevice.memories.end() || found->second.mapped) {
+			fakeDevice.errorCount++;
+			return;
+		}
+		fakeDevice.memories.erase(found);
+	}
+
+	VKAPI_ATTR VkResult VKAPI_CALL vkMapMemory(
+		VkDevice, VkDeviceMemory memory, VkDeviceSize offset, VkDeviceSize size, VkMemoryMapFlags, void** data)
+	{
+		auto found = fakeDevice.memories.find(memory);
+		if (found == fakeDevice.memories.end() || found->second.mapped || offset != 0 || size != VK_WHOLE_SIZE) {
+			fakeDevice.errorCount++;
+			return VK_ERROR_MEMORY_MAP_FAILED;
+		}
+		found->second.mapped = true;
+		*data = found->second.bytes.get();
+		return VK_SUCCESS;
+	}
+
+	VKAPI_ATTR void VKAPI_CALL vkUnmapMemory(VkDevice, VkDeviceMemory memory) {
+		auto found = fakeDevice.memories.find(memory);
+		if (found == fakeDevice.memories.end() || !found->second.mapped) {
+			fakeDevice.errorCount++;
+			return;
+		}
+		found->second.mapped = false;
+	}
+}
+
+namespace vraus_VulkanEngine {
+
+	static constexpr VkDeviceSize BLOCK_SIZE = 1024 * 1024;
+	static constexpr VkDeviceSize NON_COHERENT_ATOM_SIZE = 256;
+
+	enum MemoryType : uint32_t { DEVICE_LOCAL, HOST_COHERENT, HOST_NON_COHERENT, MEMORY_TYPE_COUNT };
+
+	static bool report(const std::string& name, bool passed, const std::string& details) {
+		std::cout << (passed ? "[pass] " : "[FAIL] ") << name << ": " << details << std::endl;
+		return passed;
+	}
+
+	// A discrete GPU: device local memory, then host visible memory with and without the coherent bit
+	static VkPhysicalDeviceMemoryProperties memoryProperties() {
+		VkPhysicalDeviceMemoryProperties properties{};
+		properties.memoryHeapCount = 2;
+		properties.memoryHeaps[0].size = 1024 * BLOCK_SIZE;
+		properties.memoryHeaps[1].size = 1024 * BLOCK_SIZE;
+		properties.memoryTypeCount = MEMORY_TYPE_COUNT;
+		properties.memoryTypes[DEVICE_LOCAL] = { VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0 };
+		properties.memoryTypes[HOST_COHERENT] = { VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 1 };
+		properties.memoryTypes[HOST_NON_COHERENT] = { VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT, 1 };
+		return properties;
+	}
+
+	static VkPhysicalDeviceLimits limits(VkDeviceSize bufferImageGranularity) {
+		VkPhysicalDeviceLimits deviceLimits{};
+		deviceLimits.bufferImageGranularity = bufferImageGranularity;
+		deviceLimits.nonCoherentAtomSize = NON_COHERENT_ATOM_SIZE;
+		return deviceLimits;
+	}
+
+	static VkMemoryRequirements requirements(VkDeviceSize size, VkDeviceSize alignment) {
+		VkMemoryRequirements memoryRequirements{};
+		memoryRequirements.size = size;
+		memoryRequirements.alignment = alignment;
+		memoryRequirements.memoryTypeBits = (1u << MEMORY_TYPE_COUNT) - 1;
+		return memoryRequirements;
+	}
+
+	// Every allocation lies inside its VkDeviceMemory and no two of them overlap
+	static bool disjoint(std::vector<MemoryAllocation> allocations) {
+		std::sort(allocations.begin(), allocations.end(), [](const MemoryAllocation& a, const MemoryAllocation& b) {
+			return a.memory != b.memory ? std::less<VkDeviceMemory>{}(a.memory, b.memory) : a.offset < b.offset;
+		});
+		for (size_t i = 0; i < allocations.size(); i++) {
+			const MemoryAllocation& allocation = allocations[i];
+			auto found = fakeDevice.memories.find(allocation.memory);
+			if (found == fakeDevice.memories.end() || allocation.offset + allocation.size > found->second.size) return false;
+			if (i + 1 < allocations.size() && allocations[i + 1].memory == allocation.memory &&
+				allocation.offset + allocation.size > allocations[i + 1].offset) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Offsets honour the requested alignment, MemoryAllocator's 16 bytes minimum and, in non coherent memory, the atom
+	// size so flushes never touch a neighbour. Mapped pointers point at the allocation inside its mapped block.
+	static bool checkAlignment() {
+		const VkDeviceSize alignments[] = { 1, 4, 16, 64, 256, 1024, 4096 };
+		std::mt19937 random{ 1234 };
+		std::uniform_int_distribution<VkDeviceSize> size{ 1, 20000 };
+		std::uniform_int_distribution<size_t> alignmentIndex{ 0, std::size(alignments) - 1 };
+		bool passed = true;
+
+		MemoryAllocator allocator{ VK_NULL_HANDLE, memoryProperties(), limits(1), BLOCK_SIZE };
+		for (uint32_t type = 0; type < MEMORY_TYPE_COUNT; type++) {
+			std::vector<MemoryAllocation> allocations{};
+			bool aligned = true;
+			for (int i = 0; i < 500; i++) {
+				const VkMemoryRequirements request = requirements(size(random), alignments[alignmentIndex(random)]);
+				MemoryAllocation allocation = allocator.allocate(request, type, MemoryAllocator::ResourceKind::Linear);
+
+				VkDeviceSize required = std::max<VkDeviceSize>(request.alignment, 16);
+				if (type == HOST_NON_COHERENT) {
+					required = std::max(required, NON_COHERENT_ATOM_SIZE);
+					aligned &= allocation.size % NON_COHERENT_ATOM_SIZE == 0;
+				}
+				aligned &= allocation.offset % required == 0 && allocation.size >= request.size && !allocation.dedicated;
+				if (type == DEVICE_LOCAL) {
+					aligned &= allocation.mapped == nullptr;
+				}
+				else {
+					const uint8_t* base = reinterpret_cast<const uint8_t*>(allocation.memory);
+					aligned &= allocation.mapped == base + allocation.offset;
+				}
+				allocations.push_back(allocation);
+			}
+			const bool separate = disjoint(allocations);
+
+			std::shuffle(allocations.begin(), allocations.end(), random);
+			for (MemoryAllocation& allocation : allocations) {
+				allocator.free(allocation);
+			}
+			const MemoryAllocator::Stats stats = allocator.getStats();
+			passed &= report(
+				"alignment, memory type " + std::to_string(type),
+				aligned && separate && stats.allocationCount == 0 && stats.usedBytes == 0,
+				"500 allocations of 1 to 20000 bytes aligned to 1 to 4096 bytes");
+		}
+		return passed;
+	}
+
+	// With a bufferImageGranularity, buffers and optimal images never share a block. Without one they do.
+	static bool checkGranularity() {
+		bool passed = true;
+		for (VkDeviceSize granularity : { VkDeviceSize{ 1024 }, VkDeviceSize{ 1 } }) {
+			MemoryAllocator allocator{ VK_NULL_HANDLE, memoryProperties(), limits(granularity), BLOCK_SIZE };
+			std::vector<MemoryAllocation> allocations[2]{}; // [kind]
+			for (int i = 0; i < 200; i++) {
+				const auto kind = i % 2 == 0 ? MemoryAllocator::ResourceKind::Linear : MemoryAllocator::ResourceKind::Optimal;
+				allocations[i % 2].push_back(allocator.allocate(requirements(1000, 256), DEVICE_LOCAL, kind));
+			}
+
+			bool shared = false;
+			for (const MemoryAllocation& linear : allocations[0]) {
+				for (const MemoryAllocation& optimal : allocations[1]) {
+					shared |= linear.memory == optimal.memory;
+				}
+			}
+			const uint32_t blocks = allocator.getStats().deviceMemoryCount;
+			std::vector<MemoryAllocation> all = allocations[0];
+			all.insert(all.end(), allocations[1].begin(), allocations[1].end());
+			const bool separate = disjoint(all);
+			for (MemoryAllocation& allocation : all) {
+				allocator.free(allocation);
+			}
+
+			const bool expectShared = granularity == 1;
+			passed &= report(
+				"granularity " + std::to_string(granularity),
+				separate && shared == expectShared && blocks == (expectShared ? 1u : 2u),
+				std::string("buffers and images ") + (shared ? "share " : "never share ") + std::to_string(blocks) + " block(s)");
+		}
+		return passed;
+	}
+
+	// Freed neighbours merge back: once a full block is freed in any order, it holds two half block allocations again
+	static bool checkCoalescing() {
+		MemoryAllocator allocator{ VK_NULL_HANDLE, memoryProperties(), limits(1), BLOCK_SIZE };
+		std::vector<MemoryAllocation> allocations{};
+		for (int i = 0; i < 128; i++) {
+			allocations.push_back(allocator.allocate(requirements(BLOCK_SIZE / 128, 16), DEVICE_LOCAL, MemoryAllocator::ResourceKind::Linear));
+		}
+		const bool filledOneBlock = allocator.getStats().deviceMemoryCount == 1 && disjoint(allocations);
+
+		// Every other one first so no free range has a free neighbour, then the rest in a random order
+		std::mt19937 random{ 99 };
+		for (size_t i = 1; i < allocations.size(); i += 2) {
+			allocator.free(allocations[i]);
+		}
+		std::shuffle(allocations.begin(), allocations.end(), random);
+		for (MemoryAllocation& allocation : allocations) {
+			allocator.free(allocation); // Resets it, freeing the odd ones again does nothing
+		}
+
+		const uint32_t allocateCount = fakeDevice.allocateCount;
+		MemoryAllocation first = allocator.allocate(requirements(BLOCK_SIZE / 2, 16), DEVICE_LOCAL, MemoryAllocator::ResourceKind::Linear);
+		MemoryAllocation second = allocator.allocate(requirements(BLOCK_SIZE / 2, 16), DEVICE_LOCAL, MemoryAllocator::ResourceKind::Linear);
+		const bool merged = fakeDevice.allocateCount == allocateCount && first.memory == second.memory && !first.dedicated;
+		allocator.free(first);
+		allocator.free(second);
+
+		return report("coalescing", filledOneBlock && merged, "128 ranges freed out of order merge back into one block");
+	}
+
+	// Past half a block, requests get their own VkDeviceMemory of exactly their size, freed with them
+	static bool checkDedicatedThreshold() {
+		MemoryAllocator allocator{ VK_NULL_HANDLE, memoryProperties(), limits(1), BLOCK_SIZE };
+		MemoryAllocation largest = allocator.allocate(requirements(BLOCK_SIZE / 2, 16), HOST_COHERENT, MemoryAllocator::ResourceKind::Linear);
+		MemoryAllocation dedicated = allocator.allocate(requirements(BLOCK_SIZE / 2 + 1, 16), HOST_COHERENT, MemoryAllocator::ResourceKind::Linear);
+
+		const VkDeviceMemory dedicatedMemory = dedicated.memory;
+		auto found = fakeDevice.memories.find(dedicatedMemory);
+		bool passed = !largest.dedicated && dedicated.dedicated && dedicated.offset == 0 &&
+			found != fakeDevice.memories.end() && found->second.size == BLOCK_SIZE / 2 + 1 &&
+			dedicated.mapped == found->second.bytes.get() && dedicatedMemory != largest.memory;
+
+		const MemoryAllocator::Stats stats = allocator.getStats();
+		passed &= stats.dedicatedAllocationCount == 1 && stats.allocationCount == 2 && stats.deviceMemoryCount == 2;
+
+		allocator.free(dedicated);
+		passed &= fakeDevice.memories.count(dedicatedMemory) == 0 && allocator.getStats().dedicatedAllocationCount == 0;
+		allocator.free(largest);
+
+		return report("dedicated threshold", passed, "half a block is suballocated, one byte more is dedicated");
+	}
+
+	// One empty block is kept per pool so allocations around a block boundary don't allocate and free device memory
+	// every time, a second empty block is released
+	static bool checkEmptyBlockRetention() {
+		MemoryAllocator allocator{ VK_NULL_HANDLE, memoryProperties(), limits(1), BLOCK_SIZE };
+		auto allocateHalf = [&] {
+			return allocator.allocate(requirements(BLOCK_SIZE / 2, 16), HOST_COHERENT, MemoryAllocator::ResourceKind::Linear);
+		};
+		MemoryAllocation a = allocateHalf();
+		MemoryAllocation b = allocateHalf();
+		MemoryAllocation c = allocateHalf(); // Second block
+		bool passed = allocator.getStats().deviceMemoryCount == 2;
+
+		allocator.free(c); // First empty block, kept
+		passed &= allocator.getStats().deviceMemoryCount == 2;
+		allocator.free(a);
+		allocator.free(b); // Second empty block, released
+		MemoryAllocator::Stats stats = allocator.getStats();
+		passed &= stats.deviceMemoryCount == 1 && stats.reservedBytes == BLOCK_SIZE && stats.usedBytes == 0;
+
+		const uint32_t allocateCount = fakeDevice.allocateCount;
+		for (int i = 0; i < 10; i++) {
+			MemoryAllocation again = allocateHalf();
+			allocator.free(again);
+		}
+		passed &= fakeDevice.allocateCount == allocateCount && allocator.getStats().deviceMemoryCount == 1;
+
+		return report("empty block retention", passed, "one empty block kept and reused, the second one released");
+	}
+
+	// Each check destroyed its allocator, which must have given every VkDeviceMemory back unmapped
+	static bool checkDeviceMemoryReleased() {
+		return report(
+			"device memory released",
+			fakeDevice.memories.empty() && fakeDevice.errorCount == 0,
+			std::to_string(fakeDevice.allocateCount) + " vkAllocateMemory calls, " + std::to_string(fakeDevice.memories.size()) +
+			" left, " + std::to_string(fakeDevice.errorCount) + " invalid calls");
+	}
+
+	static bool runChecks() {
+		bool passed = true;
+		passed &= checkAlignment();
+		passed &= checkGranularity();
+		passed &= checkCoalescing();
+		passed &= checkDedicatedThreshold();
+		passed &= checkEmptyBlockRetention();
+		passed &= checkDeviceMemoryReleased();
+		return passed;
+	}
+}
+
+int main() {
+	try {
+		if (!vraus_VulkanEngine::runChecks()) {
+			std::cerr << "Allocator checks failed" << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,265 @@
+/* Checks of the engine code that runs on the CPU alone. Creates no Vulkan instance or device, so it runs anywhere,
+CI included. Prints one line per check, runs all of them and exits with a non-zero code if any failed.
+
+	cpuChecks
+*/
+#include "render_queue.hpp"
+#include "pipeline_state_key.hpp"
+#include "model.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace vraus_VulkanEngine {
+
+	static bool report(const std::string& name, bool passed, const std::string& details) {
+		std::cout << (passed ? "[pass] " : "[FAIL] ") << name << ": " << details << std::endl;
+		return passed;
+	}
+
+	// The radix sort must give the order of a stable comparison sort: ascending keys, equal keys in input order
+	static bool sortMatchesStableSort(RenderQueue::KeySorter& sorter, const std::vector<uint64_t>& keys) {
+		std::vector<uint32_t> expected(keys.size());
+		std::iota(expected.begin(), expected.end(), 0u);
+		std::stable_sort(expected.begin(), expected.end(), [&](uint32_t a, uint32_t b) { return keys[a] < keys[b]; });
+
+		std::vector<uint64_t> sorted = keys;
+		sorter.sort(sorted);
+		if (sorter.getOrder() != expected) return false;
+		for (size_t i = 0; i < sorted.size(); i++) {
+			if (sorted[i] != keys[expected[i]]) return false;
+		}
+		return true;
+	}
+
+	static bool checkKeySorter() {
+		RenderQueue::KeySorter sorter{}; // Reused throughout, storage left by a bigger sort must not leak into the next
+		std::mt19937_64 random{ 1234 };
+		bool passed = true;
+
+		std::vector<std::pair<std::string, std::vector<uint64_t>>> cases{};
+		cases.push_back({ "empty", {} });
+		cases.push_back({ "one key", { 42 } });
+		cases.push_back({ "all equal", std::vector<uint64_t>(1000, 0x0102030405060708ull) });
+
+		std::vector<uint64_t> full(10000);
+		for (uint64_t& key : full) key = random();
+		cases.push_back({ "random keys", full });
+
+		// Few distinct values, most byte passes are skipped and most keys are duplicates
+		std::vector<uint64_t> duplicates(10000);
+		for (uint64_t& key : duplicates) key = RenderQueue::makeKey(uint8_t(random() % 3), uint16_t(random() % 5), 0, 0.f);
+		cases.push_back({ "duplicate keys", duplicates });
+
+		// Only the top and bottom bytes differ, the passes in between are skipped
+		std::vector<uint64_t> outerBytes(5000);
+		for (uint64_t& key : outerBytes) key = ((random() & 0xFF) << 56) | (random() & 0xFF);
+		cases.push_back({ "outer bytes only", outerBytes });
+
+		std::vector<uint64_t> descending(5000);
+		for (size_t i = 0; i < descending.size(); i++) descending[i] = descending.size() - i;
+		cases.push_back({ "descending", descending });
+
+		cases.push_back({ "small after large", { 3, 1, 2, 1 } });
+
+		for (const auto& testCase : cases) {
+			passed &= report(
+				"radix sort, " + testCase.first,
+				sortMatchesStableSort(sorter, testCase.second),
+				std::to_string(testCase.second.size()) + " keys");
+		}
+		return passed;
+	}
+
+	static bool checkMakeKey() {
+		using Key = uint64_t;
+		auto key = [](uint8_t pipeline, uint16_t model, uint16_t material, float depth) {
+			return RenderQueue::makeKey(pipeline, model, material, depth);
+		};
+		bool passed = true;
+
+		// Fields decide the order most significant first
+		passed &= report("key field order",
+			key(0, 65535, 65535, 1.f) < key(1, 0, 0, 0.f) &&
+			key(0, 0, 65535, 1.f) < key(0, 1, 0, 0.f) &&
+			key(0, 0, 0, 1.f) < key(0, 0, 1, 0.f) &&
+			key(0, 0, 0, .25f) < key(0, 0, 0, .5f),
+			"pipeline, then model, then material, then depth");
+
+		// Depth is clamped to [0, 1] and NaN sorts as 0
+		const float nan = std::numeric_limits<float>::quiet_NaN();
+		const Key nearest = key(7, 7, 7, 0.f);
+		passed &= report("key depth range",
+			key(7, 7, 7, -5.f) == nearest &&
+			key(7, 7, 7, 5.f) == key(7, 7, 7, 1.f) &&
+			key(7, 7, 7, std::numeric_limits<float>::infinity()) == key(7, 7, 7, 1.f) &&
+			key(7, 7, 7, nan) == nearest &&
+			key(7, 7, 7, -nan) == nearest,
+			"out of range depths clamp, NaN maps to 0");
+		return passed;
+	}
+
+	// True when fn throws std::runtime_error
+	template<typename Fn>
+	static bool throws(Fn fn) {
+		try {
+			fn();
+		}
+		catch (const std::runtime_error&) {
+			return true;
+		}
+		return false;
+	}
+
+	// A key with every field away from its default, and an instance binding like SimpleRenderSystem's
+	static PipelineStateKey customKey() {
+		auto key = PipelineStateKey::create("instanced_shader.vert.spv", "instanced_shader.frag.spv");
+		key.addVertexLayout(
+			{ { 1, 32, VK_VERTEX_INPUT_RATE_INSTANCE } },
+			{ { 2, 1, VK_FORMAT_R32G32_SFLOAT, 0 }, { 3, 1, VK_FORMAT_R32G32B32_SFLOAT, 16 } });
+		key.topology = VK_PRIMITIVE_TOPOLOGY_LINE_LIST;
+		key.polygonMode = VK_POLYGON_MODE_LINE;
+		key.cullMode = VK_CULL_MODE_BACK_BIT;
+		key.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+		key.sampleCount = VK_SAMPLE_COUNT_4_BIT;
+		key.depthTest = false;
+		key.depthWrite = false;
+		key.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+		key.blendEnable = true;
+		key.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+		key.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+		key.colorBlendOp = VK_BLEND_OP_SUBTRACT;
+		key.srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+		key.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+		key.alphaBlendOp = VK_BLEND_OP_MAX;
+		key.colorWriteMask = VK_COLOR_COMPONENT_R_BIT;
+		key.subpass = 0x01020304;
+		return key;
+	}
+
+	static bool checkPipelineStateKey() {
+		bool passed = true;
+		const PipelineStateKey defaults = PipelineStateKey::create("simple_shader.vert.spv", "simple_shader.frag.spv");
+		const PipelineStateKey custom = customKey();
+
+		// Round trip: reading the bytes back gives an equal key that serializes to the same bytes
+		bool roundTrips = true;
+		for (const PipelineStateKey* key : { &defaults, &custom }) {
+			std::vector<uint8_t> bytes{};
+			key->serialize(bytes);
+			PipelineStateKey read{};
+			std::vector<uint8_t> rewritten{};
+			const size_t readSize = PipelineStateKey::deserialize(bytes.data(), bytes.size(), read);
+			read.serialize(rewritten);
+			roundTrips &= readSize == bytes.size() && read == *key && read.hash() == key->hash() && rewritten == bytes;
+		}
+		passed &= report("key round trip", roundTrips, "default and fully customized keys");
+
+		// Keys written back to back are read one at a time, each read stops at the end of its key
+		std::vector<uint8_t> both{};
+		defaults.serialize(both);
+		const size_t firstSize = both.size();
+		custom.serialize(both);
+		PipelineStateKey first{};
+		PipelineStateKey second{};
+		const size_t firstRead = PipelineStateKey::deserialize(both.data(), both.size(), first);
+		const size_t secondRead = PipelineStateKey::deserialize(both.data() + firstRead, both.size() - firstRead, second);
+		passed &= report("key concatenation",
+			firstRead == firstSize && firstRead + secondRead == both.size() && first == defaults && second == custom,
+			std::to_string(both.size()) + " bytes, 2 keys");
+
+		// Equal keys hash the same, whatever the unused layout slots hold. Every field changes both.
+		PipelineStateKey stale = custom;
+		stale.setVertexLayout(Model::Vertex::getBindingDescriptions(), Model::Vertex::getAttributeDescriptions());
+		stale.bindings[3].stride = 1234; // Unused slot
+		stale.attributes[7].format = VK_FORMAT_R32G32_SFLOAT;
+		PipelineStateKey clean = custom;
+		clean.setVertexLayout(Model::Vertex::getBindingDescriptions(), Model::Vertex::getAttributeDescriptions());
+		bool consistent = stale == clean && stale.hash() == clean.hash() && PipelineStateKeyHash{}(stale) == PipelineStateKeyHash{}(clean);
+
+		std::vector<PipelineStateKey> variants(12, custom);
+		variants[0].vertFilepath = "other.vert.spv";
+		variants[1].fragFilepath = "other.frag.spv";
+		variants[2].bindings[1].stride = 48;
+		variants[3].attributes[3].offset = 20;
+		variants[4].attributeCount--;
+		variants[5].topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+		variants[6].depthTest = true;
+		variants[7].blendEnable = false;
+		variants[8].colorWriteMask = VK_COLOR_COMPONENT_G_BIT;
+		variants[9].subpass = 0;
+		variants[10].sampleCount = VK_SAMPLE_COUNT_1_BIT;
+		variants[11].alphaBlendOp = VK_BLEND_OP_ADD;
+		for (const PipelineStateKey& variant : variants) {
+			consistent &= variant != custom && variant.hash() != custom.hash();
+		}
+		passed &= report("key equality and hash", consistent, "unused slots ignored, " + std::to_string(variants.size()) + " single field changes detected");
+
+		// Every prefix of a valid key is rejected instead of read past its end
+		std::vector<uint8_t> bytes{};
+		custom.serialize(bytes);
+		bool truncatedRejected = true;
+		for (size_t size = 0; size < bytes.size(); size++) {
+			std::vector<uint8_t> prefix(bytes.begin(), bytes.begin() + size); // Own allocation, sanitizers catch overreads
+			PipelineStateKey read{};
+			truncatedRejected &= throws([&] { PipelineStateKey::deserialize(prefix.data(), prefix.size(), read); });
+		}
+		passed &= report("key truncated input", truncatedRejected, "all " + std::to_string(bytes.size()) + " prefixes rejected");
+
+		// Layouts, fields and strings the key can't hold are rejected, on write and on read
+		std::vector<uint8_t> tooManyBindings = bytes;
+		tooManyBindings[1 + 2 + custom.vertFilepath.size() + 2 + custom.fragFilepath.size()] = PipelineStateKey::MAX_VERTEX_BINDINGS + 1;
+		std::vector<uint8_t> badVersion = bytes;
+		badVersion[0] = 0xFF;
+		PipelineStateKey read{};
+		PipelineStateKey full = defaults;
+		const PipelineStateKey before = full;
+		const std::vector<VkVertexInputBindingDescription> fiveBindings(PipelineStateKey::MAX_VERTEX_BINDINGS + 1);
+		const std::vector<VkVertexInputAttributeDescription> nineAttributes(PipelineStateKey::MAX_VERTEX_ATTRIBUTES + 1);
+		bool oversizedRejected =
+			throws([&] { PipelineStateKey::deserialize(tooManyBindings.data(), tooManyBindings.size(), read); }) &&
+			throws([&] { PipelineStateKey::deserialize(badVersion.data(), badVersion.size(), read); }) &&
+			throws([&] { full.setVertexLayout(fiveBindings, {}); }) &&
+			throws([&] { full.setVertexLayout({}, nineAttributes); }) &&
+			throws([&] { full.addVertexLayout({ { 1, 1u << 16, VK_VERTEX_INPUT_RATE_INSTANCE } }, {}); }) &&
+			throws([&] { full.addVertexLayout({}, { { 256, 0, VK_FORMAT_R32G32_SFLOAT, 0 } }); });
+		oversizedRejected &= full == before; // A rejected layout leaves the key as it was
+		PipelineStateKey longPath = defaults;
+		longPath.vertFilepath.assign(size_t(UINT16_MAX) + 1, 'a');
+		std::vector<uint8_t> unused{};
+		oversizedRejected &= throws([&] { longPath.serialize(unused); });
+		passed &= report("key oversized input", oversizedRejected, "too many bindings or attributes, out of range fields, long paths, unknown version");
+		return passed;
+	}
+
+	static bool runChecks() {
+		bool passed = true;
+		passed &= checkKeySorter();
+		passed &= checkMakeKey();
+		passed &= checkPipelineStateKey();
+		return passed;
+	}
+}
+
+int main() {
+	try {
+		if (!vraus_VulkanEngine::runChecks()) {
+			std::cerr << "CPU checks failed" << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
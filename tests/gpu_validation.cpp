@@ -0,0 +1,201 @@
+/* Headless checks of the compute passes against their CPU references, on any Vulkan device including lavapipe / llvmpipe.
+Needs no window or display. Run it from the repository root, where compile.bat writes the .spv files.
+Runs every check and prints one line per check, then exits with a non-zero code if any of them failed, so CI can run it as is.
+
+	gpuValidation
+*/
+#include "device.hpp"
+#include "model.hpp"
+#include "game_object.hpp"
+#include "cull_compute_system.hpp"
+#include "gravity_compute_system.hpp"
+#include "gravity_physics_system.hpp"
+#include "vec2_field_compute_system.hpp"
+#include "vec2_field_system.hpp"
+#include "body_store.hpp"
+
+// libs
+#include <glm/gtc/constants.hpp>
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace vraus_VulkanEngine {
+
+	static std::vector<Model::Vertex> squareVertices(float halfSize) {
+		const glm::vec3 white{ 1.f };
+		return {
+			{ { -halfSize, -halfSize }, white }, { { halfSize, halfSize }, white }, { { -halfSize, halfSize }, white },
+			{ { -halfSize, -halfSize }, white }, { { halfSize, -halfSize }, white }, { { halfSize, halfSize }, white },
+		};
+	}
+
+	static bool report(const std::string& name, bool passed, const std::string& details) {
+		std::cout << (passed ? "[pass] " : "[FAIL] ") << name << ": " << details << std::endl;
+		return passed;
+	}
+
+	static bool checkCull(CullComputeSystem& cullSystem, const std::string& name) {
+		const CullComputeSystem::ValidationReport cull = cullSystem.validate();
+		return report(
+			name,
+			cull.matches(),
+			std::to_string(cull.objects) + " objects, " + std::to_string(cull.cpuVisible) + " visible on the CPU, " +
+			std::to_string(cull.gpuVisible) + " drawn by the GPU, " + std::to_string(cull.missing) + " missing, " +
+			std::to_string(cull.extra) + " extra");
+	}
+
+	// Objects spread over twice the view so a good share is culled, many of them straddling its edges
+	static bool validateCull(Device& device) {
+		std::shared_ptr<Model> square = std::make_shared<Model>(device, squareVertices(.5f));
+		std::shared_ptr<Model> growing = std::make_shared<Model>(device, squareVertices(.5f), Model::Usage::Dynamic);
+
+		std::mt19937 random{ 1234 }; // Fixed seed, every run checks the same objects
+		std::uniform_real_distribution<float> position{ -2.f, 2.f };
+		std::uniform_real_distribution<float> scale{ .01f, .2f };
+		std::uniform_real_distribution<float> angle{ 0.f, glm::two_pi<float>() };
+
+		std::vector<GameObject> objects{};
+		for (int i = 0; i < 10000; i++) {
+			auto obj = GameObject::createGameObject();
+			obj.transform2d.translation = { position(random), position(random) };
+			obj.transform2d.scale = glm::vec2{ scale(random) };
+			obj.transform2d.rotation = angle(random);
+			obj.color = { 1.f, 1.f, 1.f };
+			obj.model = i % 3 == 0 ? growing : square;
+			objects.push_back(std::move(obj));
+		}
+
+		CullComputeSystem cullSystem{ device };
+		cullSystem.setObjects(objects);
+		bool passed = checkCull(cullSystem, "cull");
+
+		// Only the transforms are streamed again, what was uploaded by setObjects must still be used as is
+		for (auto& obj : objects) {
+			obj.transform2d.translation = { position(random), position(random) };
+			obj.transform2d.rotation = angle(random);
+		}
+		cullSystem.updateTransforms(objects);
+		passed &= checkCull(cullSystem, "cull after updateTransforms");
+
+		// A dynamic model growing must widen the bounding circle of every object using it
+		growing->updateVertices(squareVertices(2.f));
+		cullSystem.updateTransforms(objects);
+		passed &= checkCull(cullSystem, "cull after updateVertices");
+		return passed;
+	}
+
+	// The GPU sums the same pairs in another order, so both sides only agree up to rounding. The run is kept short
+	// and the bodies softened enough that close encounters don't amplify that rounding past the tolerances.
+	static bool validateGravity(Device& device) {
+		constexpr float POSITION_TOLERANCE = 1e-3f;
+		constexpr float VELOCITY_TOLERANCE = 1e-2f;
+
+		std::mt19937 random{ 5678 };
+		std::uniform_real_distribution<float> position{ -.8f, .8f };
+		std::uniform_real_distribution<float> velocity{ -.1f, .1f };
+		std::uniform_real_distribution<float> mass{ .01f, .02f };
+
+		BodyStore bodies{};
+		for (int i = 0; i < 256; i++) {
+			bodies.add({ position(random), position(random) }, { velocity(random), velocity(random) }, mass(random));
+		}
+
+		GravityPhysicsSystem cpuSystem{ .81f };
+		cpuSystem.solver = GravitySolver::Pairwise;
+		cpuSystem.forceKernel = ForceKernel::Scalar;
+		cpuSystem.setSoftening(.05f);
+		cpuSystem.setThreadCount(1);
+
+		GravityComputeSystem gravityComputeSystem{ device, cpuSystem.strengthGravity };
+		const GravityComputeSystem::ParityReport parity = gravityComputeSystem.compareWithCpu(cpuSystem, bodies, 60, 1.f / 60, 5);
+		return report(
+			"gravity",
+			parity.maxPositionError <= POSITION_TOLERANCE && parity.maxVelocityError <= VELOCITY_TOLERANCE,
+			std::to_string(bodies.size()) + " bodies, " + std::to_string(parity.steps) + " steps, max position error " +
+			std::to_string(parity.maxPositionError) + " (tolerance " + std::to_string(POSITION_TOLERANCE) + "), max velocity error " +
+			std::to_string(parity.maxVelocityError) + " (tolerance " + std::to_string(VELOCITY_TOLERANCE) + ")");
+	}
+
+	// Lines are compared as vectors of their length above the minimum along their rotation: where the field is close to 0
+	// its direction is meaningless on both sides, but so is that vector's length
+	static bool validateField(Device& device) {
+		constexpr float LINE_TOLERANCE = 1e-4f; // Lines are between .005 and .05 long
+		constexpr float MIN_LENGTH = .005f; // Must match Vec2FieldSystem and vector_field.comp
+
+		// More bodies than a workgroup loads at once, so the shader goes through several tiles
+		std::mt19937 random{ 9012 };
+		std::uniform_real_distribution<float> position{ -1.f, 1.f };
+		std::uniform_real_distribution<float> mass{ .5f, 1.5f };
+		BodyStore bodies{};
+		for (int i = 0; i < 100; i++) {
+			bodies.add({ position(random), position(random) }, {}, mass(random));
+		}
+
+		FieldStore field{};
+		const int gridCount = 40; // Same grid as FirstApp
+		for (int i = 0; i < gridCount; i++) {
+			for (int j = 0; j < gridCount; j++) {
+				field.add({ -1.f + (i + .5f) * 2.f / gridCount, -1.f + (j + .5f) * 2.f / gridCount });
+			}
+		}
+
+		GravityPhysicsSystem physicsSystem{ .81f };
+		Vec2FieldSystem{}.update(physicsSystem, bodies, field);
+
+		Vec2FieldComputeSystem fieldComputeSystem{ device, field };
+		VkCommandBuffer commandBuffer = device.beginSingleTimeCommands();
+		fieldComputeSystem.compute(commandBuffer, 0, physicsSystem, bodies);
+		device.endSingleTimeCommands(commandBuffer);
+		const std::vector<glm::vec4> lines = fieldComputeSystem.readLines(0);
+
+		float maxLineError = 0.f;
+		size_t misplaced = 0;
+		for (size_t i = 0; i < field.size(); i++) {
+			const glm::vec4& line = lines[i];
+			if (line.x != field.x[i] || line.y != field.y[i]) misplaced++;
+
+			glm::vec2 gpuLine = (line.w - MIN_LENGTH) * glm::vec2{ std::cos(line.z), std::sin(line.z) };
+			glm::vec2 cpuLine = (field.scale[i] - MIN_LENGTH) * glm::vec2{ std::cos(field.rotation[i]), std::sin(field.rotation[i]) };
+			float lineError = glm::length(gpuLine - cpuLine);
+			// NaN never compares greater, it is made to fail explicitly
+			maxLineError = std::isnan(lineError) ? INFINITY : std::max(maxLineError, lineError);
+		}
+		return report(
+			"vector field",
+			misplaced == 0 && maxLineError <= LINE_TOLERANCE,
+			std::to_string(field.size()) + " points, " + std::to_string(bodies.size()) + " bodies, " + std::to_string(misplaced) +
+			" misplaced, max line error " + std::to_string(maxLineError) + " (tolerance " + std::to_string(LINE_TOLERANCE) + ")");
+	}
+
+	static bool runValidation() {
+		Device device{};
+		bool passed = true;
+		passed &= validateCull(device);
+		passed &= validateGravity(device);
+		passed &= validateField(device);
+		vkDeviceWaitIdle(device.device());
+		return passed;
+	}
+}
+
+int main() {
+	try {
+		if (!vraus_VulkanEngine::runValidation()) {
+			std::cerr << "GPU validation failed" << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
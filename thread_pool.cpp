@@ -0,0 +1,89 @@
+#include "thread_pool.hpp"
+
+namespace vraus_VulkanEngine {
+
+	ThreadPool::ThreadPool(unsigned int workerCount) {
+		workers.reserve(workerCount);
+		for (unsigned int i = 0; i < workerCount; i++) {
+			workers.emplace_back([this, i] { workerLoop(i + 1); });
+		}
+	}
+
+	ThreadPool::~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			stopping = true;
+		}
+		wakeCondition.notify_all();
+		for (auto& worker : workers) {
+			worker.join();
+		}
+	}
+
+	void ThreadPool::run(const std::function<void(unsigned int threadIndex)>& task) {
+		if (workers.empty()) {
+			task(0);
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			currentTask = &task;
+			pendingWorkers = static_cast<unsigned int>(workers.size());
+			firstException = nullptr;
+			generation++;
+		}
+		wakeCondition.notify_all();
+
+		execute(0);
+
+		std::unique_lock<std::mutex> lock{ mutex };
+		doneCondition.wait(lock, [this] { return pendingWorkers == 0; });
+		currentTask = nullptr;
+		if (firstException) {
+			std::rethrow_exception(firstException);
+		}
+	}
+
+	void ThreadPool::parallelFor(size_t count, const std::function<void(size_t begin, size_t end, unsigned int threadIndex)>& task) {
+		const size_t threads = threadCount();
+		run([&](unsigned int threadIndex) {
+			size_t begin = count * threadIndex / threads;
+			size_t end = count * (threadIndex + 1) / threads;
+			if (begin < end) {
+				task(begin, end, threadIndex);
+			}
+		});
+	}
+
+	void ThreadPool::workerLoop(unsigned int threadIndex) {
+		size_t lastGeneration = 0;
+		while (true) {
+			{
+				std::unique_lock<std::mutex> lock{ mutex };
+				wakeCondition.wait(lock, [&] { return stopping || generation != lastGeneration; });
+				if (stopping) return;
+				lastGeneration = generation;
+			}
+
+			execute(threadIndex);
+
+			std::lock_guard<std::mutex> lock{ mutex };
+			if (--pendingWorkers == 0) {
+				doneCondition.notify_one();
+			}
+		}
+	}
+
+	void ThreadPool::execute(unsigned int threadIndex) {
+		try {
+			(*currentTask)(threadIndex);
+		}
+		catch (...) {
+			std::lock_guard<std::mutex> lock{ mutex };
+			if (!firstException) {
+				firstException = std::current_exception();
+			}
+		}
+	}
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace vraus_VulkanEngine {
+	/* Fixed set of worker threads for data parallel loops.
+	The calling thread takes part in the work as thread 0, so a pool with N workers runs jobs on N + 1 threads.
+	Work is always split the same way for a given thread count, which keeps results reproducible.
+	A pool must only be driven from one thread at a time.
+	*/
+	class ThreadPool {
+	public:
+		ThreadPool(unsigned int workerCount);
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		unsigned int threadCount() const { return static_cast<unsigned int>(workers.size()) + 1; }
+
+		// Runs task(threadIndex) once on every thread and waits for all of them to finish.
+		// The first exception thrown by a task is rethrown here.
+		void run(const std::function<void(unsigned int threadIndex)>& task);
+
+		// Splits [0, count) into threadCount() contiguous ranges, range t is always handled by thread t.
+		void parallelFor(size_t count, const std::function<void(size_t begin, size_t end, unsigned int threadIndex)>& task);
+
+	private:
+		void workerLoop(unsigned int threadIndex);
+		void execute(unsigned int threadIndex);
+
+		std::vector<std::thread> workers;
+
+		std::mutex mutex;
+		std::condition_variable wakeCondition;
+		std::condition_variable doneCondition;
+		const std::function<void(unsigned int)>* currentTask = nullptr;
+		size_t generation = 0; // Incremented for every job so workers know there is something new to run
+		unsigned int pendingWorkers = 0;
+		bool stopping = false;
+		std::exception_ptr firstException;
+	};
+}
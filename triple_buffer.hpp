@@ -0,0 +1,50 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace vraus_VulkanEngine {
+	/* Lock-free single producer / single consumer exchange of the latest value.
+	The producer always owns one slot and the consumer another, the third one is in the middle: publish() swaps the producer's
+	slot with it, acquire() swaps the consumer's slot with it when something new was published. Neither side ever waits,
+	the producer may publish several times between two reads, the consumer then only sees the newest value.
+	Slots are reused, so a T holding vectors stops allocating once they reached their size.
+	*/
+	template <typename T>
+	class TripleBuffer {
+	public:
+		TripleBuffer() = default;
+
+		TripleBuffer(const TripleBuffer&) = delete;
+		TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+		// Producer side: fill writeBuffer(), then publish() it
+		T& writeBuffer() { return slots[backIndex]; }
+
+		void publish() {
+			uint8_t previous = middle.exchange(static_cast<uint8_t>(backIndex | DIRTY_BIT), std::memory_order_acq_rel);
+			backIndex = previous & INDEX_MASK;
+		}
+
+		// Consumer side: returns true when readBuffer() changed to a newer value
+		bool acquire() {
+			if ((middle.load(std::memory_order_relaxed) & DIRTY_BIT) == 0) return false;
+			// Only the consumer clears the bit, so the middle slot is still new, possibly even newer than what was just loaded
+			uint8_t previous = middle.exchange(frontIndex, std::memory_order_acq_rel);
+			frontIndex = previous & INDEX_MASK;
+			return true;
+		}
+
+		const T& readBuffer() const { return slots[frontIndex]; }
+
+	private:
+		static constexpr uint8_t INDEX_MASK = 0x3;
+		static constexpr uint8_t DIRTY_BIT = 0x4; // Set when the middle slot holds a value the consumer has not taken yet
+
+		T slots[3]{};
+		// Each side's index on its own cache line, the middle one being the only shared state
+		alignas(64) uint8_t backIndex = 0;
+		alignas(64) std::atomic<uint8_t> middle{ 1 };
+		alignas(64) uint8_t frontIndex = 2;
+	};
+}
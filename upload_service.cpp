@@ -0,0 +1,229 @@
+#include "upload_service.hpp"
+
+#include <stdexcept>
+
+namespace vraus_VulkanEngine {
+
+	UploadService::UploadService(Device& device) : device{ device } {
+		createCommandPool();
+	}
+
+	UploadService::~UploadService() {
+		// Resources may still be the destination of a copy, let every batch finish before releasing anything
+		flush();
+		for (Batch& batch : batches) {
+			vkWaitForFences(device.device(), 1, &batch.fence, VK_TRUE, UINT64_MAX);
+			recycle(batch);
+		}
+		batches.clear();
+
+		for (Batch& batch : freeBatches) {
+			vkDestroyFence(device.device(), batch.fence, nullptr);
+		}
+		vkDestroyCommandPool(device.device(), commandPool, nullptr); // Frees the command buffers
+	}
+
+	void UploadService::createCommandPool() {
+		VkCommandPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.queueFamilyIndex = device.transferQueueFamily();
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+		if (vkCreateCommandPool(device.device(), &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create upload command pool!");
+		}
+	}
+
+	UploadService::Handle UploadService::uploadToBuffer(
+		const void* data,
+		VkDeviceSize size,
+		VkBuffer dstBuffer,
+		VkDeviceSize dstOffset,
+		VkPipelineStageFlags dstStages,
+		VkAccessFlags dstAccess)
+	{
+		PendingCopy copy{};
+		copy.staging = std::make_unique<Buffer>(
+			device,
+			size,
+			1,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		copy.staging->map();
+		copy.staging->writeToBuffer(data, size);
+		copy.dstBuffer = dstBuffer;
+		copy.dstOffset = dstOffset;
+		copy.size = size;
+		copy.dstStages = dstStages;
+		copy.dstAccess = dstAccess;
+		queued.push_back(std::move(copy));
+		return nextSerial;
+	}
+
+	void UploadService::flush() {
+		if (queued.empty()) return;
+
+		Batch batch = acquireBatch();
+		batch.serial = nextSerial++;
+		batch.copies = std::move(queued);
+		queued.clear();
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		if (vkBeginCommandBuffer(batch.commandBuffer, &beginInfo) != VK_SUCCESS) {
+			throw std::runtime_error("failed to begin recording upload command buffer!");
+		}
+
+		for (const PendingCopy& copy : batch.copies) {
+			VkBufferCopy copyRegion{};
+			copyRegion.srcOffset = 0;
+			copyRegion.dstOffset = copy.dstOffset;
+			copyRegion.size = copy.size;
+			vkCmdCopyBuffer(batch.commandBuffer, copy.staging->getBuffer(), copy.dstBuffer, 1, &copyRegion);
+		}
+
+		// Release half of the queue family ownership transfer, update() records the acquire on the graphics queue
+		if (device.hasDedicatedTransferQueue()) {
+			std::vector<VkBufferMemoryBarrier> releases(batch.copies.size());
+			for (size_t i = 0; i < batch.copies.size(); i++) {
+				releases[i].sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+				releases[i].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+				releases[i].dstAccessMask = 0;
+				releases[i].srcQueueFamilyIndex = device.transferQueueFamily();
+				releases[i].dstQueueFamilyIndex = device.graphicsQueueFamily();
+				releases[i].buffer = batch.copies[i].dstBuffer;
+				releases[i].offset = batch.copies[i].dstOffset;
+				releases[i].size = batch.copies[i].size;
+			}
+			vkCmdPipelineBarrier(
+				batch.commandBuffer,
+				VK_PIPELINE_STAGE_TRANSFER_BIT,
+				VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+				0,
+				0, nullptr,
+				static_cast<uint32_t>(releases.size()), releases.data(),
+				0, nullptr);
+		}
+
+		if (vkEndCommandBuffer(batch.commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to record upload command buffer!");
+		}
+
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &batch.commandBuffer;
+		if (vkQueueSubmit(device.transferQueue(), 1, &submitInfo, batch.fence) != VK_SUCCESS) {
+			throw std::runtime_error("failed to submit upload command buffer!");
+		}
+		batches.push_back(std::move(batch));
+	}
+
+	void UploadService::update(VkCommandBuffer graphicsCommandBuffer) {
+		flush();
+		if (pollFences()) {
+			recordAcquireBarriers(graphicsCommandBuffer);
+		}
+	}
+
+	void UploadService::wait(Handle handle) {
+		if (isReady(handle)) return;
+		if (handle >= nextSerial) flush();
+
+		for (Batch& batch : batches) {
+			if (batch.serial > handle) break;
+			vkWaitForFences(device.device(), 1, &batch.fence, VK_TRUE, UINT64_MAX);
+			batch.transferred = true;
+		}
+
+		VkCommandBuffer commandBuffer = device.beginSingleTimeCommands();
+		recordAcquireBarriers(commandBuffer);
+		device.endSingleTimeCommands(commandBuffer);
+	}
+
+	UploadService::Batch UploadService::acquireBatch() {
+		if (!freeBatches.empty()) {
+			Batch batch = std::move(freeBatches.back());
+			freeBatches.pop_back();
+			vkResetFences(device.device(), 1, &batch.fence);
+			return batch;
+		}
+
+		Batch batch{};
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandPool = commandPool;
+		allocInfo.commandBufferCount = 1;
+		if (vkAllocateCommandBuffers(device.device(), &allocInfo, &batch.commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate upload command buffer!");
+		}
+
+		VkFenceCreateInfo fenceInfo{};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		if (vkCreateFence(device.device(), &fenceInfo, nullptr, &batch.fence) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create upload fence!");
+		}
+		return batch;
+	}
+
+	bool UploadService::pollFences() {
+		bool anyTransferred = false;
+		for (Batch& batch : batches) {
+			// Batches complete in submission order on a single queue, the first one still running ends the search
+			if (!batch.transferred && vkGetFenceStatus(device.device(), batch.fence) != VK_SUCCESS) break;
+			batch.transferred = true;
+			anyTransferred = true;
+		}
+		return anyTransferred;
+	}
+
+	void UploadService::recordAcquireBarriers(VkCommandBuffer graphicsCommandBuffer) {
+		const bool ownershipTransfer = device.hasDedicatedTransferQueue();
+		std::vector<VkBufferMemoryBarrier> acquires{};
+		VkPipelineStageFlags dstStages = 0;
+		Handle lastSerial = readySerial;
+
+		for (const Batch& batch : batches) {
+			if (!batch.transferred) break;
+			for (const PendingCopy& copy : batch.copies) {
+				VkBufferMemoryBarrier& acquire = acquires.emplace_back();
+				acquire.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+				// The release already made the writes available, an acquire only has a destination
+				acquire.srcAccessMask = ownershipTransfer ? 0 : VK_ACCESS_TRANSFER_WRITE_BIT;
+				acquire.dstAccessMask = copy.dstAccess;
+				acquire.srcQueueFamilyIndex = ownershipTransfer ? device.transferQueueFamily() : VK_QUEUE_FAMILY_IGNORED;
+				acquire.dstQueueFamilyIndex = ownershipTransfer ? device.graphicsQueueFamily() : VK_QUEUE_FAMILY_IGNORED;
+				acquire.buffer = copy.dstBuffer;
+				acquire.offset = copy.dstOffset;
+				acquire.size = copy.size;
+				dstStages |= copy.dstStages;
+			}
+			lastSerial = batch.serial;
+		}
+		if (acquires.empty()) return;
+
+		vkCmdPipelineBarrier(
+			graphicsCommandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			dstStages,
+			0,
+			0, nullptr,
+			static_cast<uint32_t>(acquires.size()), acquires.data(),
+			0, nullptr);
+
+		// Staging buffers are no longer read, the copies finished
+		while (!batches.empty() && batches.front().serial <= lastSerial) {
+			recycle(batches.front());
+			batches.pop_front();
+		}
+		readySerial = lastSerial;
+	}
+
+	void UploadService::recycle(Batch& batch) {
+		batch.copies.clear();
+		batch.transferred = false;
+		freeBatches.push_back(std::move(batch));
+	}
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "device.hpp"
+#include "buffer.hpp"
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+
+namespace vraus_VulkanEngine {
+	/* Uploads data into device local buffers without stalling the graphics queue.
+	Data is copied into a staging buffer right away and the copy is queued. Every queued copy goes out in one
+	submission on the dedicated transfer queue when the device has one (the graphics queue otherwise), with a fence
+	the service polls instead of waiting on.
+	With a dedicated transfer queue the buffers change queue family: the transfer submission releases them and
+	update() records the matching acquire into the graphics command buffer once the fence signaled, so no semaphore
+	has to be threaded into the frame's submit. On a shared queue update() records a plain barrier instead.
+	An upload is ready once its acquire was recorded, buffers must not be used by the graphics queue before.
+	Not thread safe, use it from the thread recording the frames.
+	*/
+	class UploadService {
+	public:
+		// Identifies the batch an upload went in, batches finish in order
+		using Handle = uint64_t;
+
+		UploadService(Device& device);
+		~UploadService();
+
+		UploadService(const UploadService&) = delete;
+		UploadService& operator=(const UploadService&) = delete;
+
+		// Copies size bytes of data into dstBuffer at dstOffset. dstStages and dstAccess describe the first use of the
+		// data on the graphics queue, e.g. VK_PIPELINE_STAGE_VERTEX_INPUT_BIT and VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT.
+		Handle uploadToBuffer(
+			const void* data,
+			VkDeviceSize size,
+			VkBuffer dstBuffer,
+			VkDeviceSize dstOffset,
+			VkPipelineStageFlags dstStages,
+			VkAccessFlags dstAccess);
+
+		// Submits every queued copy in one batch. Called by update(), only needed to start the copies earlier.
+		void flush();
+		// Once per frame, outside of a render pass: flushes, polls the fences and records the acquire barriers of
+		// the finished batches into the graphics command buffer. Their uploads are ready from then on.
+		void update(VkCommandBuffer graphicsCommandBuffer);
+
+		bool isReady(Handle handle) const { return handle <= readySerial; }
+		// Blocks until the upload is ready, acquiring it with a one-off graphics submission. For loading screens and teardown.
+		void wait(Handle handle);
+
+		size_t getPendingCount() const { return batches.size(); }
+
+	private:
+		struct PendingCopy {
+			std::unique_ptr<Buffer> staging;
+			VkBuffer dstBuffer;
+			VkDeviceSize dstOffset;
+			VkDeviceSize size;
+			VkPipelineStageFlags dstStages;
+			VkAccessFlags dstAccess;
+		};
+
+		struct Batch {
+			Handle serial = 0;
+			VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+			VkFence fence = VK_NULL_HANDLE;
+			std::vector<PendingCopy> copies{};
+			bool transferred = false; // Fence signaled, waiting for its acquire
+		};
+
+		void createCommandPool();
+		Batch acquireBatch();
+		// Marks the batches whose fence signaled, returns whether any is waiting for its acquire
+		bool pollFences();
+		void recordAcquireBarriers(VkCommandBuffer graphicsCommandBuffer);
+		void recycle(Batch& batch);
+
+		Device& device;
+		VkCommandPool commandPool = VK_NULL_HANDLE;
+
+		std::vector<PendingCopy> queued;
+		std::deque<Batch> batches; // Submitted, in submission order
+		std::vector<Batch> freeBatches; // Command buffer and fence kept for reuse
+		Handle nextSerial = 1; // Serial of the batch the next upload goes in
+		Handle readySerial = 0;
+	};
+}
@@ -0,0 +1,315 @@
+#include "vec2_field_compute_system.hpp"
+
+#include "swapChain.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+
+namespace vraus_VulkanEngine {
+
+	struct FieldComputePushConstantData {
+		uint32_t bodyCount;
+		uint32_t pointCount;
+		float strength;
+	};
+
+	struct FieldRenderPushConstantData {
+		glm::vec3 color;
+		float width;
+	};
+
+	Vec2FieldComputeSystem::Vec2FieldComputeSystem(Device& _device, const FieldStore& vectorField)
+		: device{ _device }, pointCount{ static_cast<uint32_t>(vectorField.size()) } {
+		assert(pointCount > 0 && "Vector field needs at least one point");
+		createDescriptors();
+		createPipelineLayouts();
+		createPipelines();
+		createBuffers(vectorField);
+	}
+
+	Vec2FieldComputeSystem::Vec2FieldComputeSystem(
+		Device& _device, const FieldStore& vectorField, VkRenderPass renderPass, PipelineStateCache& _pipelineStates)
+		: Vec2FieldComputeSystem{ _device, vectorField } {
+		pipelineStates = &_pipelineStates;
+		createRenderPipeline(renderPass);
+	}
+
+	Vec2FieldComputeSystem::~Vec2FieldComputeSystem() {
+		if (pipelineStates) {
+			pipelineStates->getPipelineManager().waitIdle(); // The render layout must outlive the compilation of our pipeline
+		}
+		vkDestroyPipelineLayout(device.device(), computePipelineLayout, nullptr);
+		vkDestroyPipelineLayout(device.device(), renderPipelineLayout, nullptr);
+	}
+
+	void Vec2FieldComputeSystem::createDescriptors()
+	{
+		descriptorPool = DescriptorPool::Builder(device)
+			.setMaxSets(2 * SwapChain::MAX_FRAMES_IN_FLIGHT)
+			.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4 * SwapChain::MAX_FRAMES_IN_FLIGHT)
+			.build();
+
+		computeSetLayout = DescriptorSetLayout::Builder(device)
+			.addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // bodies
+			.addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // points
+			.addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // lines
+			.build();
+
+		renderSetLayout = DescriptorSetLayout::Builder(device)
+			.addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT) // lines
+			.build();
+	}
+
+	void Vec2FieldComputeSystem::createPipelineLayouts()
+	{
+		VkPushConstantRange computePushRange{};
+		computePushRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		computePushRange.offset = 0;
+		computePushRange.size = sizeof(FieldComputePushConstantData);
+
+		VkDescriptorSetLayout computeLayouts[] = { computeSetLayout->getDescriptorSetLayout() };
+		VkPipelineLayoutCreateInfo computeLayoutInfo{};
+		computeLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		computeLayoutInfo.setLayoutCount = 1;
+		computeLayoutInfo.pSetLayouts = computeLayouts;
+		computeLayoutInfo.pushConstantRangeCount = 1;
+		computeLayoutInfo.pPushConstantRanges = &computePushRange;
+
+		if (vkCreatePipelineLayout(device.device(), &computeLayoutInfo, nullptr, &computePipelineLayout) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create compute pipeline layout");
+		}
+
+		VkPushConstantRange renderPushRange{};
+		renderPushRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+		renderPushRange.offset = 0;
+		renderPushRange.size = sizeof(FieldRenderPushConstantData);
+
+		VkDescriptorSetLayout renderLayouts[] = { renderSetLayout->getDescriptorSetLayout() };
+		VkPipelineLayoutCreateInfo renderLayoutInfo{};
+		renderLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		renderLayoutInfo.setLayoutCount = 1;
+		renderLayoutInfo.pSetLayouts = renderLayouts;
+		renderLayoutInfo.pushConstantRangeCount = 1;
+		renderLayoutInfo.pPushConstantRanges = &renderPushRange;
+
+		if (vkCreatePipelineLayout(device.device(), &renderLayoutInfo, nullptr, &renderPipelineLayout) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create pipeline layout");
+		}
+	}
+
+	void Vec2FieldComputeSystem::createPipelines()
+	{
+		computePipeline = std::make_unique<ComputePipeline>(device, "vector_field.comp.spv", computePipelineLayout);
+	}
+
+	void Vec2FieldComputeSystem::createRenderPipeline(VkRenderPass renderPass)
+	{
+		// Lines are instances of a Model, the default vertex layout. Their transforms come from the line buffers.
+		auto pipelineState = PipelineStateKey::create("vector_field.vert.spv", "vector_field.frag.spv");
+		renderPipeline = pipelineStates->request(pipelineState, renderPipelineLayout, renderPass);
+	}
+
+	void Vec2FieldComputeSystem::createBuffers(const FieldStore& vectorField)
+	{
+		std::vector<glm::vec2> points(pointCount);
+		for (uint32_t i = 0; i < pointCount; i++) {
+			points[i] = { vectorField.x[i], vectorField.y[i] };
+		}
+		pointBuffer = std::make_unique<Buffer>(
+			device,
+			sizeof(glm::vec2),
+			pointCount,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		pointBuffer->map();
+		pointBuffer->writeToBuffer(points.data());
+		pointBuffer->unmap();
+
+		bodyBuffers.resize(SwapChain::MAX_FRAMES_IN_FLIGHT);
+		lineBuffers.resize(SwapChain::MAX_FRAMES_IN_FLIGHT);
+		computeSets.resize(SwapChain::MAX_FRAMES_IN_FLIGHT);
+		boundBodies.resize(SwapChain::MAX_FRAMES_IN_FLIGHT);
+		renderSets.resize(SwapChain::MAX_FRAMES_IN_FLIGHT);
+		for (int i = 0; i < SwapChain::MAX_FRAMES_IN_FLIGHT; i++) {
+			// Only the GPU touches the lines, except when they are read back for checking
+			lineBuffers[i] = std::make_unique<Buffer>(
+				device,
+				sizeof(glm::vec4),
+				pointCount,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			reserveBodies(i, 1);
+
+			if (!descriptorPool->allocateDescriptor(computeSetLayout->getDescriptorSetLayout(), computeSets[i])) {
+				throw std::runtime_error("Failed to allocate vector field descriptor set");
+			}
+			writeDescriptorSets(i, bodyBuffers[i]->descriptorInfo());
+
+			auto renderLines = lineBuffers[i]->descriptorInfo();
+			if (!DescriptorWriter(*renderSetLayout, *descriptorPool)
+				.writeBuffer(0, &renderLines)
+				.build(renderSets[i])) {
+				throw std::runtime_error("Failed to allocate vector field descriptor set");
+			}
+		}
+	}
+
+	// Grows the body buffer of a frame. Only called once that frame's previous submission is complete,
+	// so its buffer can be replaced right away, compute() then points the descriptor set to the new one.
+	void Vec2FieldComputeSystem::reserveBodies(int frameIndex, size_t count)
+	{
+		auto& bodyBuffer = bodyBuffers[frameIndex];
+		if (bodyBuffer && bodyBuffer->getInstanceCount() >= count) return;
+
+		uint32_t capacity = bodyBuffer ? bodyBuffer->getInstanceCount() : 0;
+		capacity = static_cast<uint32_t>(std::max<size_t>({ count, 2 * static_cast<size_t>(capacity), 64 }));
+
+		bodyBuffer = std::make_unique<Buffer>(
+			device,
+			sizeof(glm::vec4),
+			capacity,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		bodyBuffer->map();
+	}
+
+	void Vec2FieldComputeSystem::writeDescriptorSets(int frameIndex, const VkDescriptorBufferInfo& bodyBuffer)
+	{
+		auto bodies = bodyBuffer;
+		auto points = pointBuffer->descriptorInfo();
+		auto lines = lineBuffers[frameIndex]->descriptorInfo();
+		DescriptorWriter(*computeSetLayout, *descriptorPool)
+			.writeBuffer(0, &bodies)
+			.writeBuffer(1, &points)
+			.writeBuffer(2, &lines)
+			.overwrite(computeSets[frameIndex]);
+		boundBodies[frameIndex] = bodyBuffer;
+	}
+
+	void Vec2FieldComputeSystem::compute(
+		VkCommandBuffer commandBuffer,
+		int frameIndex,
+		const GravityPhysicsSystem& physicsSystem,
+		const BodyStore& bodies
+	) {
+		reserveBodies(frameIndex, bodies.size());
+
+		// Host coherent memory, the queue submission makes these writes visible to the GPU
+		auto* bodyData = static_cast<glm::vec4*>(bodyBuffers[frameIndex]->getMappedMemory());
+		for (size_t i = 0; i < bodies.size(); i++) {
+			bodyData[i] = { bodies.x[i], bodies.y[i], bodies.mass[i], 0.f };
+		}
+
+		compute(
+			commandBuffer,
+			frameIndex,
+			physicsSystem.strengthGravity,
+			bodyBuffers[frameIndex]->descriptorInfo(),
+			static_cast<uint32_t>(bodies.size()));
+	}
+
+	void Vec2FieldComputeSystem::compute(
+		VkCommandBuffer commandBuffer,
+		int frameIndex,
+		float strength,
+		const VkDescriptorBufferInfo& bodyBuffer,
+		uint32_t bodyCount
+	) {
+		// The frame's previous submission is complete, its descriptor set can be updated
+		const auto& bound = boundBodies[frameIndex];
+		if (bound.buffer != bodyBuffer.buffer || bound.offset != bodyBuffer.offset || bound.range != bodyBuffer.range) {
+			writeDescriptorSets(frameIndex, bodyBuffer);
+		}
+
+		FieldComputePushConstantData push{};
+		push.bodyCount = bodyCount;
+		push.pointCount = pointCount;
+		push.strength = strength;
+
+		computePipeline->bind(commandBuffer);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipelineLayout, 0, 1, &computeSets[frameIndex], 0, nullptr);
+		vkCmdPushConstants(commandBuffer, computePipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(FieldComputePushConstantData), &push);
+		vkCmdDispatch(commandBuffer, ComputePipeline::groupCount(pointCount, LOCAL_SIZE), 1, 1);
+
+		// The vertex shader of this frame's field draw must wait for the lines to be written
+		VkBufferMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.buffer = lineBuffers[frameIndex]->getBuffer();
+		barrier.offset = 0;
+		barrier.size = VK_WHOLE_SIZE;
+		vkCmdPipelineBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+			0,
+			0, nullptr,
+			1, &barrier,
+			0, nullptr);
+	}
+
+	void Vec2FieldComputeSystem::render(VkCommandBuffer commandBuffer, int frameIndex, Model& lineModel)
+	{
+		assert(pipelineStates && "Vector field compute system was created without a render pass");
+		Pipeline* pipeline = pipelineStates->get(renderPipeline);
+		if (pipeline == nullptr || !lineModel.isReady()) return; // Still compiling or uploading
+
+		FieldRenderPushConstantData push{};
+		push.color = color;
+		push.width = lineWidth;
+
+		pipeline->bind(commandBuffer);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, renderPipelineLayout, 0, 1, &renderSets[frameIndex], 0, nullptr);
+		vkCmdPushConstants(commandBuffer, renderPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(FieldRenderPushConstantData), &push);
+		lineModel.bind(commandBuffer);
+		lineModel.draw(commandBuffer, pointCount);
+	}
+
+	std::vector<glm::vec4> Vec2FieldComputeSystem::readLines(int frameIndex)
+	{
+		Buffer stagingBuffer{
+			device,
+			sizeof(glm::vec4),
+			pointCount,
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT };
+
+		VkCommandBuffer commandBuffer = device.beginSingleTimeCommands();
+
+		// Covers the dispatches of earlier submissions on the same queue
+		VkBufferMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.buffer = lineBuffers[frameIndex]->getBuffer();
+		barrier.offset = 0;
+		barrier.size = VK_WHOLE_SIZE;
+		vkCmdPipelineBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			0,
+			0, nullptr,
+			1, &barrier,
+			0, nullptr);
+
+		VkBufferCopy copyRegion{};
+		copyRegion.size = lineBuffers[frameIndex]->getBufferSize();
+		vkCmdCopyBuffer(commandBuffer, lineBuffers[frameIndex]->getBuffer(), stagingBuffer.getBuffer(), 1, &copyRegion);
+
+		device.endSingleTimeCommands(commandBuffer);
+
+		std::vector<glm::vec4> lines(pointCount);
+		stagingBuffer.map();
+		memcpy(lines.data(), stagingBuffer.getMappedMemory(), sizeof(glm::vec4) * pointCount);
+		stagingBuffer.unmap();
+		return lines;
+	}
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "device.hpp"
+#include "buffer.hpp"
+#include "descriptors.hpp"
+#include "compute_pipeline.hpp"
+#include "pipeline.hpp"
+#include "pipeline_state_cache.hpp"
+#include "model.hpp"
+#include "body_store.hpp"
+#include "gravity_physics_system.hpp"
+
+#include <memory>
+#include <vector>
+
+namespace vraus_VulkanEngine {
+	/* GPU version of Vec2FieldSystem. A compute shader evaluates the field at every point from a buffer of bodies
+	and writes each line (position, rotation, length) into a storage buffer. The field draw reads that buffer directly,
+	one instance per line, so the field never comes back to the CPU and needs a single draw call.
+	Buffers are duplicated per frame in flight so a frame can be computed while the previous one is still drawn.
+	*/
+	class Vec2FieldComputeSystem {
+	public:
+		static constexpr uint32_t LOCAL_SIZE = 64; // Must match vector_field.comp
+
+		// Compute side only, works without a swap chain
+		Vec2FieldComputeSystem(Device& device, const FieldStore& vectorField);
+		// Also draws the field, the render pipeline compiles in the background through pipelineStates
+		Vec2FieldComputeSystem(
+			Device& device, const FieldStore& vectorField, VkRenderPass renderPass, PipelineStateCache& pipelineStates);
+		~Vec2FieldComputeSystem();
+
+		Vec2FieldComputeSystem(const Vec2FieldComputeSystem&) = delete;
+		Vec2FieldComputeSystem& operator=(const Vec2FieldComputeSystem&) = delete;
+
+		glm::vec3 color{ 1.f };
+		float lineWidth = .005f;
+
+		// Uploads the bodies and records the field evaluation. Must be recorded outside of a render pass.
+		void compute(
+			VkCommandBuffer commandBuffer,
+			int frameIndex,
+			const GravityPhysicsSystem& physicsSystem,
+			const BodyStore& bodies
+		);
+
+		// Same, reading bodies that already live on the GPU, laid out as vec4(x, y, mass, unused) per body
+		void compute(
+			VkCommandBuffer commandBuffer,
+			int frameIndex,
+			float strength,
+			const VkDescriptorBufferInfo& bodyBuffer,
+			uint32_t bodyCount
+		);
+
+		// Draws lineModel once per field point, as computed for this frame. Draws nothing until the render pipeline is compiled.
+		void render(VkCommandBuffer commandBuffer, int frameIndex, Model& lineModel);
+
+		// Copies the lines of a frame back to the host (x, y, rotation, length), to check the GPU path against Vec2FieldSystem
+		std::vector<glm::vec4> readLines(int frameIndex);
+
+		uint32_t getPointCount() const { return pointCount; }
+
+	private:
+		void createDescriptors();
+		void createPipelineLayouts();
+		void createPipelines();
+		void createRenderPipeline(VkRenderPass renderPass);
+		void createBuffers(const FieldStore& vectorField);
+		void reserveBodies(int frameIndex, size_t count);
+		void writeDescriptorSets(int frameIndex, const VkDescriptorBufferInfo& bodyBuffer);
+
+		Device& device;
+		PipelineStateCache* pipelineStates = nullptr; // Null when compute only
+		uint32_t pointCount;
+
+		std::unique_ptr<DescriptorPool> descriptorPool;
+		std::unique_ptr<DescriptorSetLayout> computeSetLayout;
+		std::unique_ptr<DescriptorSetLayout> renderSetLayout;
+		VkPipelineLayout computePipelineLayout = VK_NULL_HANDLE;
+		VkPipelineLayout renderPipelineLayout = VK_NULL_HANDLE;
+		std::unique_ptr<ComputePipeline> computePipeline;
+		PipelineManager::Handle renderPipeline = PipelineManager::INVALID_HANDLE;
+
+		std::unique_ptr<Buffer> pointBuffer; // Field points never move, shared by every frame
+		std::vector<std::unique_ptr<Buffer>> bodyBuffers; // Per frame, persistently mapped
+		std::vector<std::unique_ptr<Buffer>> lineBuffers; // Per frame, written by the compute shader
+		std::vector<VkDescriptorSet> computeSets;
+		std::vector<VkDescriptorBufferInfo> boundBodies; // Body range each compute set currently points to
+		std::vector<VkDescriptorSet> renderSets;
+	};
+}
@@ -0,0 +1,89 @@
+#include "vec2_field_system.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace vraus_VulkanEngine {
+
+	void Vec2FieldSystem::update(
+		const GravityPhysicsSystem& physicsSystem,
+		const BodyStore& bodies,
+		FieldStore& vectorField
+	) {
+		const bool approximate = openingAngle > 0.f;
+		if (approximate) {
+			quadTree.build(bodies.x.data(), bodies.y.data(), bodies.mass.data(), bodies.size());
+		}
+
+		// For each field line we calculate the net gravitation force for that point in space.
+		// Field points have a unit mass, so this is also the acceleration a body would feel there.
+		for (size_t i = 0; i < vectorField.size(); i++) {
+			const glm::vec2 position{ vectorField.x[i], vectorField.y[i] };
+			glm::vec2 direction = approximate
+				? quadTree.computeAcceleration(position, physicsSystem.strengthGravity, openingAngle)
+				: exactAcceleration(physicsSystem.strengthGravity, bodies, position);
+
+			// This scales the length of the field line based on the log of the length.
+			vectorField.scale[i] =
+				0.005f + 0.045f * glm::clamp(glm::log(glm::length(direction) + 1) / 3.f, 0.f, 1.f);
+			vectorField.rotation[i] = atan2(direction.y, direction.x);
+		}
+	}
+
+	GravityPhysicsSystem::ForceErrorReport Vec2FieldSystem::compareWithExact(
+		const GravityPhysicsSystem& physicsSystem,
+		const BodyStore& bodies,
+		const FieldStore& vectorField,
+		size_t maxSamples) const
+	{
+		GravityPhysicsSystem::ForceErrorReport report{};
+		if (vectorField.size() == 0 || maxSamples == 0) return report;
+
+		QuadTree tree;
+		tree.build(bodies.x.data(), bodies.y.data(), bodies.mass.data(), bodies.size());
+
+		const size_t stride = std::max<size_t>(1, vectorField.size() / maxSamples);
+		double sumError = 0.0;
+		double sumSquaredError = 0.0;
+		for (size_t i = 0; i < vectorField.size(); i += stride) {
+			const glm::vec2 position{ vectorField.x[i], vectorField.y[i] };
+			glm::vec2 exact = exactAcceleration(physicsSystem.strengthGravity, bodies, position);
+			glm::vec2 approx = tree.computeAcceleration(position, physicsSystem.strengthGravity, openingAngle);
+
+			float exactLength = glm::length(exact);
+			if (exactLength <= 0.f) continue; // Relative error is meaningless for a point with no net force
+
+			float error = glm::length(approx - exact) / exactLength;
+			report.maxRelativeError = std::max(report.maxRelativeError, error);
+			sumError += error;
+			sumSquaredError += static_cast<double>(error) * error;
+			report.sampledBodies++;
+		}
+
+		if (report.sampledBodies > 0) {
+			report.meanRelativeError = static_cast<float>(sumError / report.sampledBodies);
+			report.rmsRelativeError = static_cast<float>(std::sqrt(sumSquaredError / report.sampledBodies));
+		}
+		return report;
+	}
+
+	glm::vec2 Vec2FieldSystem::exactAcceleration(float strength, const BodyStore& bodies, glm::vec2 position) {
+		const size_t bodyCount = bodies.size();
+		const float* bx = bodies.x.data();
+		const float* by = bodies.y.data();
+		const float* mass = bodies.mass.data();
+
+		glm::vec2 acceleration{};
+		for (size_t j = 0; j < bodyCount; j++) {
+			float dx = bx[j] - position.x;
+			float dy = by[j] - position.y;
+			float distanceSquared = dx * dx + dy * dy;
+			if (distanceSquared < 1e-10f) continue;
+
+			float force = strength * mass[j] / (distanceSquared * std::sqrt(distanceSquared));
+			acceleration.x += force * dx;
+			acceleration.y += force * dy;
+		}
+		return acceleration;
+	}
+}
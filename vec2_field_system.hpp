@@ -0,0 +1,36 @@
+#pragma once
+
+#include "body_store.hpp"
+#include "gravity_physics_system.hpp"
+#include "quad_tree.hpp"
+
+namespace vraus_VulkanEngine {
+	class Vec2FieldSystem {
+	public:
+		// Barnes-Hut opening angle used for the field points, see QuadTree::computeAcceleration.
+		// 0 sums every body for every point, points * bodies. Above 0 a quadtree of the bodies is built once per update
+		// and every point walks it, about points * log(bodies), at the cost of a bounded error (see compareWithExact).
+		float openingAngle = 0.f;
+
+		void update(
+			const GravityPhysicsSystem& physicsSystem,
+			const BodyStore& bodies,
+			FieldStore& vectorField
+		);
+
+		// Compares the accelerations openingAngle gives at the field points against the exact sum, for the current bodies.
+		// At most maxSamples evenly spread points are checked, sampledBodies then counts field points.
+		GravityPhysicsSystem::ForceErrorReport compareWithExact(
+			const GravityPhysicsSystem& physicsSystem,
+			const BodyStore& bodies,
+			const FieldStore& vectorField,
+			size_t maxSamples = 1000
+		) const;
+
+	private:
+		static glm::vec2 exactAcceleration(float strength, const BodyStore& bodies, glm::vec2 position);
+
+		// Rebuilt every update when openingAngle is above 0, kept as a member so its node storage is reused
+		QuadTree quadTree;
+	};
+}
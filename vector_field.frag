@@ -0,0 +1,12 @@
+#version 450
+
+layout (location = 0) out vec4 outColor;
+
+layout(push_constant) uniform Push{
+	vec3 color;
+	float width;
+}push;
+
+void main() {
+	outColor = vec4(push.color, 1.0);
+}
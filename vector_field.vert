@@ -0,0 +1,22 @@
+#version 450
+
+layout (location = 0) in vec2 position;
+layout (location = 1) in vec3 color;
+
+// Written by vector_field.comp, one line per instance
+layout (std430, set = 0, binding = 0) readonly buffer Lines {
+	vec4 lines[];
+};
+
+layout(push_constant) uniform Push{
+	vec3 color;
+	float width;
+}push;
+
+void main() {
+	vec4 line = lines[gl_InstanceIndex];
+	float s = sin(line.z);
+	float c = cos(line.z);
+	mat2 rotation = mat2(c, s, -s, c);
+	gl_Position = vec4(rotation * (position * vec2(line.w, push.width)) + line.xy, 0.0, 1.0);
+}